@@ -49,6 +49,7 @@ app_main (ml_session session)
   ml_dbh_factory dbf;
   const char *conninfo, *rootdir, *filename, *canonical_path;
   cgi args;
+  int i;
 
   canonical_path = ml_session_canonical_path (session);
 
@@ -75,7 +76,18 @@ app_main (ml_session session)
   /* Get the database connection name. */
   conninfo = ml_cfg_get_string (session, "msp database", 0);
   if (conninfo != 0)
-    dbf = new_ml_dbh_factory (session, conninfo);
+    {
+      dbf = new_ml_dbh_factory (session, conninfo);
+
+      /* Read replicas are listed as "msp database replica 1", etc. */
+      for (i = 1;
+	   (conninfo =
+	    ml_cfg_get_string (session,
+			       psprintf (pool, "msp database replica %d", i),
+			       0)) != 0;
+	   ++i)
+	ml_dbh_factory_add_replica (dbf, conninfo);
+    }
   else
     dbf = 0;			/* This is OK, but better not use it! */
 
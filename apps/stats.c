@@ -59,12 +59,15 @@
 #include <pthr_dbi.h>
 
 #include "monolith.h"
+#include "ml_query_cache.h"
+#include "ml_output.h"
 #include "ml_window.h"
 #include "ml_widget.h"
 #include "ml_form_layout.h"
 #include "ml_table_layout.h"
 #include "ml_multicol_layout.h"
 #include "ml_flow_layout.h"
+#include "ml_vertical_layout.h"
 #include "ml_form.h"
 #include "ml_form_select.h"
 #include "ml_form_submit.h"
@@ -107,7 +110,9 @@ struct show_session_args
 };
 
 static void list_dbfs (ml_session session, struct data *data);
+static void show_query_cache (ml_session session, struct data *data);
 static void show_reactor (ml_session session, struct data *data);
+static void show_responses (ml_session session, struct data *data);
 static void list_sessions (ml_session session, struct data *data);
 static void show_session (ml_session session, void *vargs);
 static void list_threads (ml_session session, struct data *data);
@@ -121,10 +126,12 @@ static struct {
   void (*fn) (ml_session, struct data *data);
   int is_default;
 } choices[] = {
-  { "Database handle factories", list_dbfs,     0 },
-  { "Reactor",                   show_reactor,  0 },
-  { "Sessions",                  list_sessions, 1 },
-  { "Threads",                   list_threads,  0 },
+  { "Database handle factories", list_dbfs,        0 },
+  { "Query cache",               show_query_cache, 0 },
+  { "Reactor",                   show_reactor,     0 },
+  { "Responses",                 show_responses,   0 },
+  { "Sessions",                  list_sessions,    1 },
+  { "Threads",                   list_threads,     0 },
 };
 
 #define nr_choices (sizeof choices / sizeof choices[0])
@@ -220,19 +227,90 @@ disguise_sessionid (pool pool, const char *sessionid)
     }
 }
 
+/* Add a row describing a database handle factory (or a replica). */
+static void
+pack_dbf_row (pool pool, ml_multicol_layout tbl, ml_dbh_factory dbf,
+	      const char *name, int is_primary)
+{
+  ml_text_label lbl;
+  ml_button b;
+  int total, in_use, free_hs, max_hs;
+
+  b = new_ml_button (pool, name);
+  ml_widget_set_property (b, "button.style", "link");
+  ml_multicol_layout_pack (tbl, b);
+
+  total = _ml_dbh_factory_get_nr_allocated_handles (dbf);
+  lbl = new_ml_text_label (pool, pitoa (pool, total));
+  ml_multicol_layout_pack (tbl, lbl);
+
+  free_hs = _ml_dbh_factory_get_nr_free_handles (dbf);
+  in_use = total - free_hs;
+  lbl = new_ml_text_label (pool,
+			   psprintf (pool, "%d/%d", in_use, free_hs));
+  ml_multicol_layout_pack (tbl, lbl);
+
+  max_hs = _ml_dbh_factory_get_max_handles (dbf);
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d/%s",
+	       _ml_dbh_factory_get_min_handles (dbf),
+	       max_hs > 0 ? pitoa (pool, max_hs) : "unlimited"));
+  ml_multicol_layout_pack (tbl, lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d/%d/%d",
+	       _ml_dbh_factory_get_nr_waiters (dbf),
+	       _ml_dbh_factory_get_nr_reaped (dbf),
+	       _ml_dbh_factory_get_nr_dead (dbf)));
+  ml_multicol_layout_pack (tbl, lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d/%d",
+	       _ml_dbh_factory_get_nr_rollbacks (dbf),
+	       _ml_dbh_factory_get_nr_rollbacks_skipped (dbf)));
+  ml_multicol_layout_pack (tbl, lbl);
+
+  if (is_primary)
+    lbl = new_ml_text_label
+      (pool,
+       psprintf (pool, "%d/%d",
+		 _ml_dbh_factory_get_nr_replica_reads (dbf),
+		 _ml_dbh_factory_get_nr_replica_failures (dbf)));
+  else
+    lbl = new_ml_text_label (pool, "-");
+  ml_multicol_layout_pack (tbl, lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d/%d/%d/%d/%d/%d",
+	       _ml_dbh_factory_get_nr_waits (dbf, 0),
+	       _ml_dbh_factory_get_nr_waits (dbf, 1),
+	       _ml_dbh_factory_get_nr_waits (dbf, 2),
+	       _ml_dbh_factory_get_nr_waits (dbf, 3),
+	       _ml_dbh_factory_get_nr_waits (dbf, 4),
+	       _ml_dbh_factory_get_nr_waits (dbf, 5)));
+  ml_multicol_layout_pack (tbl, lbl);
+}
+
 static void
 list_dbfs (ml_session session, struct data *data)
 {
   pool pool = data->pool;
-  vector dbfs;
-  ml_multicol_layout tbl;
+  vector dbfs, stmts;
+  ml_vertical_layout vl;
+  ml_multicol_layout tbl, stbl;
   ml_text_label lbl;
-  int i;
+  int i, j;
 
   /* Pull out the list of conninfos. */
   dbfs = _ml_get_dbh_factories (pool);
 
-  tbl = new_ml_multicol_layout (pool, 3);
+  vl = new_ml_vertical_layout (pool);
+
+  tbl = new_ml_multicol_layout (pool, 8);
   ml_widget_set_property (tbl, "class", "ml_stats_table");
 
   /* Table headers. */
@@ -245,36 +323,150 @@ list_dbfs (ml_session session, struct data *data)
   lbl = new_ml_text_label (pool, "in use/free");
   ml_multicol_layout_set_header (tbl, 1);
   ml_multicol_layout_pack (tbl, lbl);
+  lbl = new_ml_text_label (pool, "min/max");
+  ml_multicol_layout_set_header (tbl, 1);
+  ml_multicol_layout_pack (tbl, lbl);
+  lbl = new_ml_text_label (pool, "waiting/reaped/dead");
+  ml_multicol_layout_set_header (tbl, 1);
+  ml_multicol_layout_pack (tbl, lbl);
+  lbl = new_ml_text_label (pool, "rollbacks done/skipped");
+  ml_multicol_layout_set_header (tbl, 1);
+  ml_multicol_layout_pack (tbl, lbl);
+  lbl = new_ml_text_label (pool, "replica reads/failures");
+  ml_multicol_layout_set_header (tbl, 1);
+  ml_multicol_layout_pack (tbl, lbl);
+  lbl = new_ml_text_label (pool,
+			   "waits: none/<10ms/<100ms/<1s/<10s/longer");
+  ml_multicol_layout_set_header (tbl, 1);
+  ml_multicol_layout_pack (tbl, lbl);
 
   /* The database handles themselves. */
   for (i = 0; i < vector_size (dbfs); ++i)
     {
       const char *conninfo;
-      ml_dbh_factory dbf;
-      int total, in_use, free_hs;
-      ml_button b;
+      ml_dbh_factory dbf, replica;
+      vector replicas;
 
       vector_get (dbfs, i, conninfo);
       dbf = _ml_get_dbh_factory (conninfo);
 
-      if (strlen (conninfo) > 0)
-	b = new_ml_button (pool, conninfo);
-      else
-	b = new_ml_button (pool, "(empty string)");
-      ml_widget_set_property (b, "button.style", "link");
-      ml_multicol_layout_pack (tbl, b);
+      pack_dbf_row (pool, tbl, dbf,
+		    strlen (conninfo) > 0 ? conninfo : "(empty string)", 1);
+
+      replicas = _ml_dbh_factory_get_replicas (dbf, pool);
+      for (j = 0; j < vector_size (replicas); ++j)
+	{
+	  vector_get (replicas, j, replica);
+	  pack_dbf_row (pool, tbl, replica,
+			psprintf (pool, "replica: %s%s",
+				  _ml_dbh_factory_get_conninfo (replica),
+				  _ml_dbh_factory_is_down (replica)
+				  ? " (down)" : ""),
+			0);
+	}
+    }
 
-      total = _ml_dbh_factory_get_nr_allocated_handles (dbf);
-      lbl = new_ml_text_label (pool, pitoa (pool, total));
-      ml_multicol_layout_pack (tbl, lbl);
+  ml_vertical_layout_pack (vl, tbl);
 
-      free_hs = _ml_dbh_factory_get_nr_free_handles (dbf);
-      in_use = total - free_hs;
-      lbl = new_ml_text_label (pool,
-			       psprintf (pool, "%d/%d", in_use, free_hs));
-      ml_multicol_layout_pack (tbl, lbl);
+  /* Statements registered with each factory. */
+  stbl = new_ml_multicol_layout (pool, 4);
+  ml_widget_set_property (stbl, "class", "ml_stats_table");
+
+  lbl = new_ml_text_label (pool, "conninfo");
+  ml_multicol_layout_set_header (stbl, 1);
+  ml_multicol_layout_pack (stbl, lbl);
+  lbl = new_ml_text_label (pool, "statement");
+  ml_multicol_layout_set_header (stbl, 1);
+  ml_multicol_layout_pack (stbl, lbl);
+  lbl = new_ml_text_label (pool, "prepared");
+  ml_multicol_layout_set_header (stbl, 1);
+  ml_multicol_layout_pack (stbl, lbl);
+  lbl = new_ml_text_label (pool, "used");
+  ml_multicol_layout_set_header (stbl, 1);
+  ml_multicol_layout_pack (stbl, lbl);
+
+  for (i = 0; i < vector_size (dbfs); ++i)
+    {
+      const char *conninfo;
+      ml_dbh_factory dbf;
+      ml_statement stmt;
+
+      vector_get (dbfs, i, conninfo);
+      dbf = _ml_get_dbh_factory (conninfo);
+      stmts = _ml_dbh_factory_get_statements (dbf, pool);
+
+      for (j = 0; j < vector_size (stmts); ++j)
+	{
+	  vector_get (stmts, j, stmt);
+
+	  lbl = new_ml_text_label (pool, conninfo);
+	  ml_multicol_layout_pack (stbl, lbl);
+	  lbl = new_ml_text_label (pool, _ml_statement_get_query (stmt));
+	  ml_multicol_layout_pack (stbl, lbl);
+	  lbl = new_ml_text_label
+	    (pool, pitoa (pool, _ml_statement_get_nr_prepares (stmt)));
+	  ml_multicol_layout_pack (stbl, lbl);
+	  lbl = new_ml_text_label
+	    (pool, pitoa (pool, _ml_statement_get_nr_executes (stmt)));
+	  ml_multicol_layout_pack (stbl, lbl);
+	}
     }
 
+  ml_vertical_layout_pack (vl, stbl);
+
+  pack (data, vl);
+}
+
+static void
+show_query_cache (ml_session session, struct data *data)
+{
+  pool pool = data->pool;
+  ml_form_layout tbl;
+  ml_text_label lbl;
+  int hits, stale_hits, misses, total;
+  long long budget;
+
+  hits = _ml_query_cache_get_nr_hits ();
+  stale_hits = _ml_query_cache_get_nr_stale_hits ();
+  misses = _ml_query_cache_get_nr_misses ();
+  total = hits + stale_hits + misses;
+  budget = _ml_query_cache_get_budget ();
+
+  tbl = new_ml_form_layout (pool);
+  ml_widget_set_property (tbl, "class", "ml_stats_table");
+
+  lbl = new_ml_text_label (pool,
+			   pitoa (pool, _ml_query_cache_get_nr_entries ()));
+  ml_form_layout_pack (tbl, "Cached results:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%lld bytes (budget: %s)",
+	       _ml_query_cache_get_size (),
+	       budget > 0 ? psprintf (pool, "%lld", budget) : "none"));
+  ml_form_layout_pack (tbl, "Memory used:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d fresh, %d stale, %d misses (hit rate %d%%)",
+	       hits, stale_hits, misses,
+	       total > 0 ? (hits + stale_hits) * 100 / total : 0));
+  ml_form_layout_pack (tbl, "Lookups:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d evicted, %d invalidated",
+	       _ml_query_cache_get_nr_evictions (),
+	       _ml_query_cache_get_nr_invalidations ()));
+  ml_form_layout_pack (tbl, "Discarded:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d batches, %d queries fetched in batches",
+	       _ml_query_cache_get_nr_batches (),
+	       _ml_query_cache_get_nr_batch_fills ()));
+  ml_form_layout_pack (tbl, "Batches:", lbl);
+
   pack (data, tbl);
 }
 
@@ -284,18 +476,172 @@ show_reactor (ml_session session, struct data *data)
   /* XXX not impl. */
 }
 
+static void
+show_responses (ml_session session, struct data *data)
+{
+  pool pool = data->pool;
+  ml_form_layout tbl;
+  ml_text_label lbl;
+  int pages, syscalls, compressed;
+  long long sent, copied, before, after;
+  vector types;
+  const struct ml_widget_operations *ops;
+  int i, hits, misses, uncached, total;
+
+  pages = _ml_output_get_nr_pages ();
+  syscalls = _ml_output_get_nr_syscalls ();
+  sent = _ml_output_get_bytes_sent ();
+  copied = _ml_output_get_bytes_copied ();
+  compressed = _ml_output_get_nr_compressed ();
+  before = _ml_output_get_bytes_before_compression ();
+  after = _ml_output_get_bytes_after_compression ();
+
+  tbl = new_ml_form_layout (pool);
+  ml_widget_set_property (tbl, "class", "ml_stats_table");
+
+  lbl = new_ml_text_label (pool, pitoa (pool, pages));
+  ml_form_layout_pack (tbl, "Pages sent:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%lld bytes (%lld per page)",
+	       sent, pages > 0 ? sent / pages : 0));
+  ml_form_layout_pack (tbl, "Body sent:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d (%d.%02d per page)",
+	       syscalls,
+	       pages > 0 ? syscalls / pages : 0,
+	       pages > 0 ? syscalls * 100 / pages % 100 : 0));
+  ml_form_layout_pack (tbl, "Write system calls:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%lld bytes (%lld per page)",
+	       copied, pages > 0 ? copied / pages : 0));
+  ml_form_layout_pack (tbl, "Copied into buffers:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d pages, %lld bytes saved (%lld%%), %lld ms CPU",
+	       compressed, before - after,
+	       before > 0 ? (before - after) * 100 / before : 0,
+	       _ml_output_get_compression_usecs () / 1000));
+  ml_form_layout_pack (tbl, "Compression:", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d pages, %lld bytes not sent",
+	       _ml_get_nr_not_modified (),
+	       _ml_get_bytes_not_modified ()));
+  ml_form_layout_pack (tbl, "Not modified (304):", lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool, "%d widgets, %lld bytes",
+	       _ml_widget_get_nr_cached (),
+	       _ml_widget_get_cache_size ()));
+  ml_form_layout_pack (tbl, "Widget cache:", lbl);
+
+  /* Hit ratio for each type of cacheable widget. */
+  types = _ml_widget_get_cache_types (pool);
+  for (i = 0; i < vector_size (types); ++i)
+    {
+      vector_get (types, i, ops);
+
+      hits = _ml_widget_get_nr_cache_hits (ops);
+      misses = _ml_widget_get_nr_cache_misses (ops);
+      uncached = _ml_widget_get_nr_cache_uncached (ops);
+      total = hits + misses + uncached;
+
+      lbl = new_ml_text_label
+	(pool,
+	 psprintf (pool, "%d%% (%d hits, %d misses, %d not cacheable)",
+		   total > 0 ? hits * 100 / total : 0,
+		   hits, misses, uncached));
+      ml_form_layout_pack (tbl,
+			   psprintf (pool, "%s:",
+				     ops->name ? ops->name : "(unnamed)"),
+			   lbl);
+    }
+
+  pack (data, tbl);
+}
+
 static void
 list_sessions (ml_session session, struct data *data)
 {
   pool pool = data->pool;
   vector sessionids;
+  ml_vertical_layout vl;
   ml_multicol_layout tbl;
   ml_text_label lbl;
-  int i;
+  long long budget;
+  int i, max_size;
 
   /* Pull out the list of session IDs and turn them into session objects. */
   sessionids = _ml_get_sessions (pool);
 
+  vl = new_ml_vertical_layout (pool);
+
+  /* Summary of memory used by sessions. */
+  budget = _ml_get_sessions_memory_budget ();
+  max_size = _ml_get_session_max_size ();
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool,
+	       "%d sessions using %lld bytes (budget: %s, per session: %s). "
+	       "Evicted: %d under memory pressure, %d over quota. "
+	       "Duplicate requests coalesced: %d (%d sent the first "
+	       "request's page), "
+	       "duplicate form submissions: %d. "
+	       "Requests abandoned: %d at the deadline, "
+	       "%d after the browser went away "
+	       "(%d queries cancelled on the server).",
+	       vector_size (sessionids),
+	       _ml_get_sessions_total_size (),
+	       budget > 0 ? psprintf (pool, "%lld", budget) : "none",
+	       max_size > 0 ? pitoa (pool, max_size) : "none",
+	       _ml_get_nr_sessions_evicted (),
+	       _ml_get_nr_sessions_over_quota (),
+	       _ml_get_nr_requests_coalesced (),
+	       _ml_get_nr_pages_shared (),
+	       _ml_get_nr_duplicate_submits (),
+	       _ml_get_nr_deadline_cancels (),
+	       _ml_get_nr_disconnect_cancels (),
+	       _ml_get_nr_queries_cancelled ()));
+  ml_vertical_layout_pack (vl, lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool,
+	       "Idle transient windows discarded: %d, freeing %lld bytes.",
+	       _ml_get_nr_windows_retired (),
+	       _ml_get_windows_retired_size ()));
+  ml_vertical_layout_pack (vl, lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool,
+	       "User database writes: %d users queued, "
+	       "%d transactions written, %d failed "
+	       "(login counts lost: %d).",
+	       _ml_get_nr_auth_writes_queued (),
+	       _ml_get_nr_auth_writes (),
+	       _ml_get_nr_auth_write_failures (),
+	       _ml_get_nr_auth_accounting_failures ()));
+  ml_vertical_layout_pack (vl, lbl);
+
+  lbl = new_ml_text_label
+    (pool,
+     psprintf (pool,
+	       "Login cookie cache: %d cookies, %d hits, %d misses.",
+	       _ml_get_auth_cache_size (),
+	       _ml_get_nr_auth_cache_hits (),
+	       _ml_get_nr_auth_cache_misses ()));
+  ml_vertical_layout_pack (vl, lbl);
+
   tbl = new_ml_multicol_layout (pool, 5);
   ml_widget_set_property (tbl, "class", "ml_stats_table");
 
@@ -364,7 +710,8 @@ list_sessions (ml_session session, struct data *data)
       ml_multicol_layout_pack (tbl, lbl);
     }
 
-  pack (data, tbl);
+  ml_vertical_layout_pack (vl, tbl);
+  pack (data, vl);
 }
 
 static void
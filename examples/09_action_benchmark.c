@@ -0,0 +1,188 @@
+/* Benchmark of action registration and lookup, built on example 03.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#include <string.h>
+#include <sys/time.h>
+
+#include <pool.h>
+#include <vector.h>
+#include <pstring.h>
+#include <pthr_cgi.h>
+
+#include "monolith.h"
+#include "ml_window.h"
+#include "ml_table_layout.h"
+#include "ml_flow_layout.h"
+#include "ml_label.h"
+#include "ml_button.h"
+
+#include "toy_calculator.h"
+
+/* Main entry point to the app. */
+static void app_main (ml_session);
+
+int
+handle_request (rws_request rq)
+{
+  return ml_entry_point (rq, app_main);
+}
+
+/* Each toy calculator registers an action for each of its buttons, so
+ * a session with many calculators has a large action table, like a
+ * real application. Each run then re-registers the callbacks of a row
+ * of buttons many times (as widgets do when their state changes) and
+ * looks up every action in the session many times (as dispatching an
+ * action does), and reports the time taken and how much the session
+ * grew.
+ */
+#define NR_CALCS_ACROSS 8
+#define NR_CALCS_DOWN 8
+#define NR_BUTTONS 16
+#define NR_ROUNDS 1000
+
+struct data
+{
+  ml_label lb;			/* Results. */
+  ml_button buttons[NR_BUTTONS]; /* Buttons which are re-registered. */
+  int runs;			/* Number of runs so far. */
+};
+
+static void run (ml_session, void *);
+static void nothing (ml_session, void *);
+
+static void
+app_main (ml_session session)
+{
+  pool pool = ml_session_pool (session);
+  struct data *data;
+  ml_window w;
+  ml_flow_layout lay, row;
+  ml_table_layout tbl;
+  ml_button b;
+  int i, j;
+
+  data = pmalloc (pool, sizeof *data);
+  data->runs = 0;
+
+  /* Create the top-level window. */
+  w = new_ml_window (session, pool);
+  lay = new_ml_flow_layout (pool);
+
+  /* Results and the button which runs the benchmark. */
+  data->lb = new_ml_label (pool, "Not run yet.<br>");
+  ml_flow_layout_pack (lay, data->lb);
+
+  b = new_ml_button (pool, "Run benchmark");
+  ml_button_set_callback (b, run, session, data);
+  ml_flow_layout_pack (lay, b);
+
+  /* The buttons which are re-registered. */
+  row = new_ml_flow_layout (pool);
+  for (i = 0; i < NR_BUTTONS; ++i)
+    {
+      data->buttons[i] = new_ml_button (pool, pitoa (pool, i));
+      ml_button_set_callback (data->buttons[i], nothing, session, data);
+      ml_flow_layout_pack (row, data->buttons[i]);
+    }
+  ml_flow_layout_pack (lay, row);
+
+  /* Create the calculators and pack them into a table layout. */
+  tbl = new_ml_table_layout (pool, NR_CALCS_DOWN, NR_CALCS_ACROSS);
+  for (i = 0; i < NR_CALCS_DOWN; ++i)
+    for (j = 0; j < NR_CALCS_ACROSS; ++j)
+      ml_table_layout_pack (tbl, new_toy_calculator (pool, session), i, j);
+  ml_flow_layout_pack (lay, tbl);
+
+  ml_window_pack (w, lay);
+}
+
+static double
+elapsed (const struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday (&now, 0);
+  return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_usec - start->tv_usec);
+}
+
+static int
+session_pool_size (ml_session session)
+{
+  struct pool_stats pool_stats;
+
+  pool_get_stats (ml_session_pool (session), &pool_stats,
+		  sizeof (pool_stats));
+  return pool_stats.struct_size;
+}
+
+static void
+run (ml_session session, void *vp)
+{
+  struct data *data = (struct data *) vp;
+  pool thread_pool = pth_get_pool (current_pth);
+  struct timeval start;
+  double register_usecs, lookup_usecs;
+  int i, r, size_before, size_after, nr_lookups = 0;
+  vector actionids;
+  const char *actionid;
+  void *fn, *fn_data;
+
+  size_before = session_pool_size (session);
+
+  /* Re-register the callbacks of the row of buttons. */
+  gettimeofday (&start, 0);
+  for (r = 0; r < NR_ROUNDS; ++r)
+    for (i = 0; i < NR_BUTTONS; ++i)
+      ml_button_set_callback (data->buttons[i], nothing, session, data);
+  register_usecs = elapsed (&start);
+
+  size_after = session_pool_size (session);
+
+  /* Look up every action in the session. */
+  actionids = _ml_session_get_actions (session, thread_pool);
+  gettimeofday (&start, 0);
+  for (r = 0; r < NR_ROUNDS; ++r)
+    for (i = 0; i < vector_size (actionids); ++i)
+      {
+	vector_get (actionids, i, actionid);
+	nr_lookups += _ml_session_get_action (session, actionid,
+					      &fn, &fn_data);
+      }
+  lookup_usecs = elapsed (&start);
+
+  data->runs++;
+  ml_widget_set_property
+    (data->lb, "text",
+     psprintf (ml_session_pool (session),
+	       "Run %d: %d actions registered.<br>"
+	       "%d re-registrations: %.3f us each, "
+	       "session grew by %d bytes.<br>"
+	       "%d lookups: %.3f us each.<br>",
+	       data->runs, vector_size (actionids),
+	       NR_ROUNDS * NR_BUTTONS,
+	       register_usecs / (NR_ROUNDS * NR_BUTTONS),
+	       size_after - size_before,
+	       nr_lookups, nr_lookups ? lookup_usecs / nr_lookups : 0.));
+}
+
+static void
+nothing (ml_session session, void *vp)
+{
+}
@@ -34,7 +34,7 @@
 
 #include "toy_calculator.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations toy_calculator_ops =
   {
@@ -423,7 +423,7 @@ press_button_AC (ml_session session, void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   toy_calculator w = (toy_calculator) vw;
 
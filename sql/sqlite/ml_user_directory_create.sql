@@ -0,0 +1,41 @@
+-- Create schema for monolith user directory (SQLite version).
+-- - by Richard W.M. Jones <rich@annexia.org>
+--
+-- This library is free software; you can redistribute it and/or
+-- modify it under the terms of the GNU Library General Public
+-- License as published by the Free Software Foundation; either
+-- version 2 of the License, or (at your option) any later version.
+--
+-- This library is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+-- Library General Public License for more details.
+--
+-- You should have received a copy of the GNU Library General Public
+-- License along with this library; if not, write to the Free
+-- Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+--
+-- $Id$
+--
+-- Depends: monolith_core, monolith_users
+
+-- The user directory is strictly "opt-in". If a user is not listed in
+-- this table, then they do not want to appear in the directory. We
+-- need to refine this in the future so that the ML_USERS table contains
+-- more information about what details people want to be revealed to
+-- others.
+
+begin transaction;
+
+create table ml_userdir_prefs
+(
+	userid int4		-- User ID
+		constraint ml_userdir_prefs_userid_pk
+		primary key
+		references ml_users (userid)
+		on delete cascade
+);
+
+-- SQLite has no users, so there is nothing to grant.
+
+commit transaction;
\ No newline at end of file
@@ -26,7 +26,7 @@
 #include "monolith.h"
 #include "ml_box.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations box_ops =
   {
@@ -59,14 +59,14 @@ ml_box_pack (ml_box w, ml_widget _w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_box w = (ml_box) vw;
 
-  io_fprintf (io, "<span class=\"ml_box\">");
+  ml_output_puts_static (io, "<span class=\"ml_box\">");
 
   if (w->w)
     ml_widget_repaint (w->w, session, windowid, io);
 
-  io_fprintf (io, "</span>");
+  ml_output_puts_static (io, "</span>");
 }
@@ -33,13 +33,14 @@
 #include "ml_smarttext.h"
 #include "ml_button.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations button_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_button",
   };
 
 struct ml_button
@@ -92,6 +93,8 @@ new_ml_button (pool pool, const char *text)
   w->target = 0;
   w->popup_w = w->popup_h = 0;
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -100,23 +103,27 @@ ml_button_set_callback (ml_button w,
 			void (*fn)(ml_session, void *),
 			ml_session session, void *data)
 {
+  ml_widget_invalidate (w);
+
   if (w->action_id)
     ml_unregister_action (session, w->action_id);
   w->action_id = 0;
 
   if (fn)
-    w->action_id = ml_register_action (session, fn, data);
+    w->action_id = ml_register_action_in_pool (session, w->pool, fn, data);
 }
 
 void
 ml_button_set_popup (ml_button w, const char *name)
 {
+  ml_widget_invalidate (w);
   w->target = name;
 }
 
 void
 ml_button_set_popup_size (ml_button w, int width, int height)
 {
+  ml_widget_invalidate (w);
   w->popup_w = width;
   w->popup_h = height;
 }
@@ -142,7 +149,7 @@ get_class (ml_button w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_button w = (ml_button) vw;
 
@@ -152,49 +159,45 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
 
       if (w->action_id)
 	{
-	  pool tmp = new_subpool (w->pool);
-
 	  /* XXX Link should not contain ml_window parameter if w->target
 	   * is set.
 	   */
 	  const char *link =
-	    psprintf (tmp, "%s?ml_action=%s&ml_window=%s",
-		      ml_session_script_name (session),
-		      w->action_id,
-		      windowid);
+	    ml_scratch_sprintf (session, "%s?ml_action=%s&ml_window=%s",
+				ml_session_script_name (session),
+				w->action_id,
+				windowid);
 
-	  io_fprintf (io, "<a class=\"%s\" href=\"%s\"", clazz, link);
+	  ml_output_printf (io, "<a class=\"%s\" href=\"%s\"", clazz, link);
 
 	  if (w->title)
 	    {
-	      io_fputs (" title=\"", io);
+	      ml_output_puts_static (io, " title=\"");
 	      ml_plaintext_print (io, w->title);
-	      io_fputc ('"', io);
+	      ml_output_putc (io, '"');
 	    }
 
 	  if (w->colour)
-	    io_fprintf (io, " style=\"color: %s\"", w->colour);
+	    ml_output_printf (io, " style=\"color: %s\"", w->colour);
 
 	  if (w->target)
 	    {
-	      io_fprintf (io, " target=\"%s\"", w->target);
+	      ml_output_printf (io, " target=\"%s\"", w->target);
 	      if (w->popup_w != 0 && w->popup_h != 0)
 		{
-		  io_fprintf (io, " onclick=\"open ('%s', '%s', "
-			      "'width=%d,height=%d,scrollbars=1'); "
-			      "return false;\"",
-			      link, w->target, w->popup_w, w->popup_h);
+		  ml_output_printf (io, " onclick=\"open ('%s', '%s', "
+				    "'width=%d,height=%d,scrollbars=1'); "
+				    "return false;\"",
+				    link, w->target, w->popup_w, w->popup_h);
 		}
 	    }
 
 	  if (!w->style || strcmp (w->style, "compact") != 0)
-	    io_fprintf (io, ">%s</a>", w->text);
+	    ml_output_printf (io, ">%s</a>", w->text);
 	  else
-	    io_fprintf (io, ">[%s]</a>", w->text);
-
-	  delete_pool (tmp);
+	    ml_output_printf (io, ">[%s]</a>", w->text);
 	}
       else
-	io_fprintf (io, "<span class=\"%s\">%s</span>", clazz, w->text);
+	ml_output_printf (io, "<span class=\"%s\">%s</span>", clazz, w->text);
     }
 }
@@ -28,7 +28,7 @@
 #include "ml_widget.h"
 #include "ml_close_button.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations close_button_ops =
@@ -70,7 +70,7 @@ new_ml_close_button (pool pool, const char *text)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_close_button w = (ml_close_button) vw;
 
@@ -83,8 +83,8 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
       else
 	js = "window.opener.location.reload(); top.close()";
 
-      io_fprintf (io,
-		  "<a class=\"ml_button\" href=\"javascript:%s\">%s</a>",
-		  js, w->text);
+      ml_output_printf (io,
+			"<a class=\"ml_button\" href=\"javascript:%s\">%s</a>",
+			js, w->text);
     }
 }
@@ -33,7 +33,7 @@
 #include "ml_close_button.h"
 #include "ml_dialog.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations dialog_ops =
   {
@@ -173,7 +173,8 @@ ml_ok_window (pool pool, ml_session session, const char *text, int flags)
   ml_dialog dlg;
   const char *title = "That operation was carried out successfully";
 
-  win = new_ml_window (session, pool);
+  win = new_ml_transient_window (session, pool);
+  pool = ml_window_pool (win);
   dlg = new_ml_dialog (pool);
 
   ml_window_set_title (win, title);
@@ -196,7 +197,8 @@ ml_error_window (pool pool, ml_session session, const char *text, int flags)
   ml_dialog dlg;
   const char *title = "There was an error";
 
-  win = new_ml_window (session, pool);
+  win = new_ml_transient_window (session, pool);
+  pool = ml_window_pool (win);
   dlg = new_ml_dialog (pool);
 
   ml_window_set_title (win, title);
@@ -213,7 +215,7 @@ ml_error_window (pool pool, ml_session session, const char *text, int flags)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_dialog w = (ml_dialog) vw;
 
@@ -103,8 +103,10 @@ extern void ml_dialog_add_close_button (ml_dialog w, const char *text, int close
  *
  * @code{ml_ok_window} and @code{ml_error_window} are handy helper
  * functions which display either a confirmation of success, or error
- * window. They are just convenient wrappers around @code{new_ml_window}
- * and @code{new_ml_dialog}.
+ * window. They are just convenient wrappers around
+ * @code{new_ml_transient_window} and @code{new_ml_dialog}. The dialog
+ * is allocated in the window's own pool, so the session frees it when
+ * the window has been idle for a while.
  *
  * @code{ml_ok_window} is a window which displays a confirmation of
  * success. The @code{session} argument is the current session. The
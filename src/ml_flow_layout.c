@@ -26,11 +26,12 @@
 #include "monolith.h"
 #include "ml_flow_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations flow_layout_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_flow_layout"
   };
 
 struct ml_flow_layout
@@ -49,18 +50,22 @@ new_ml_flow_layout (pool pool)
   w->pool = pool;
   w->v = new_vector (pool, ml_widget);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_flow_layout_push_back (ml_flow_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->v, _w);
 }
 
 void
 ml_flow_layout_pack (ml_flow_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->v, _w);
 }
 
@@ -69,6 +74,7 @@ ml_flow_layout_pop_back (ml_flow_layout w)
 {
   ml_widget _w;
 
+  ml_widget_invalidate (w);
   vector_pop_back (w->v, _w);
   return _w;
 }
@@ -76,6 +82,7 @@ ml_flow_layout_pop_back (ml_flow_layout w)
 void
 ml_flow_layout_push_front (ml_flow_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_front (w->v, _w);
 }
 
@@ -84,6 +91,7 @@ ml_flow_layout_pop_front (ml_flow_layout w)
 {
   ml_widget _w;
 
+  ml_widget_invalidate (w);
   vector_pop_front (w->v, _w);
   return _w;
 }
@@ -100,24 +108,28 @@ ml_flow_layout_get (ml_flow_layout w, int i)
 void
 ml_flow_layout_insert (ml_flow_layout w, int i, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_insert (w->v, i, _w);
 }
 
 void
 ml_flow_layout_replace (ml_flow_layout w, int i, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_replace (w->v, i, _w);
 }
 
 void
 ml_flow_layout_erase (ml_flow_layout w, int i)
 {
+  ml_widget_invalidate (w);
   vector_erase (w->v, i);
 }
 
 void
 ml_flow_layout_clear (ml_flow_layout w)
 {
+  ml_widget_invalidate (w);
   vector_clear (w->v);
 }
 
@@ -128,7 +140,7 @@ ml_flow_layout_size (ml_flow_layout w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_flow_layout w = (ml_flow_layout) vw;
   int i;
@@ -28,6 +28,7 @@
 #include <hash.h>
 #include <pstring.h>
 
+#include <pthr_pseudothread.h>
 #include <pthr_iolib.h>
 #include <pthr_cgi.h>
 
@@ -35,8 +36,9 @@
 #include "ml_widget.h"
 #include "ml_form_input.h"
 #include "ml_form.h"
+#include "ml_random.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations form_ops =
@@ -53,6 +55,7 @@ struct ml_form
   const char *action_id;	/* Form's callback action. */
   const char *method;		/* Either "GET" or "POST". */
   const char *name;		/* Unique name of the form. */
+  int once;			/* If set, suppress duplicate submissions. */
 
   /* This is the user's real callback function. */
   void (*submit_fn) (ml_session, void *);
@@ -70,6 +73,9 @@ static struct ml_widget_property properties[] =
       offset: ml_offsetof (struct ml_form, name),
       type: ML_PROP_STRING,
       flags: ML_PROP_READ_ONLY },
+    { name: "form.once",
+      offset: ml_offsetof (struct ml_form, once),
+      type: ML_PROP_BOOL },
     { 0 },
   };
 
@@ -93,6 +99,7 @@ new_ml_form (pool pool)
   w->action_id = 0;
   w->method = "POST";
   w->name = psprintf (pool, "ml_form%d", ++unique);
+  w->once = 0;
   w->submit_fn = 0;
   w->submit_data = 0;
   w->inputs = new_vector (pool, struct form_input);
@@ -112,7 +119,8 @@ ml_form_set_callback (ml_form w, void (*callback_fn) (ml_session, void *),
 
   if (callback_fn)
     {
-      w->action_id = ml_register_action (session, form_callback, w);
+      w->action_id =
+	ml_register_action_in_pool (session, w->pool, form_callback, w);
       w->submit_fn = callback_fn;
       w->submit_data = data;
     }
@@ -182,26 +190,39 @@ _ml_form_register_widget (ml_form f, ml_form_input w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form w = (ml_form) vw;
 
   if (w->w)
     {
       if (w->action_id)
-	io_fprintf (io,
-		    "<form method=\"%s\" action=\"%s\" name=\"%s\">"
-		    "<input type=\"hidden\" name=\"ml_window\" value=\"%s\" />"
-		    "<input type=\"hidden\" name=\"ml_action\" value=\"%s\" />"
-		    ,
-		    w->method,
-		    ml_session_script_name (session),
-		    w->name,
-		    windowid,
-		    w->action_id);
+	{
+	  ml_output_printf
+	    (io,
+	     "<form method=\"%s\" action=\"%s\" name=\"%s\">"
+	     "<input type=\"hidden\" name=\"ml_window\" value=\"%s\" />"
+	     "<input type=\"hidden\" name=\"ml_action\" value=\"%s\" />"
+	     ,
+	     w->method,
+	     ml_session_script_name (session),
+	     w->name,
+	     windowid,
+	     w->action_id);
+	  if (w->once)
+	    {
+	      char *token = ml_scratch_alloc (session, 33);
+
+	      ml_random_token_r (token);
+	      ml_output_printf
+		(io,
+		 "<input type=\"hidden\" name=\"ml_token\" value=\"%s\" />",
+		 token);
+	    }
+	}
       else
-	io_fputs ("<form>", io);
+	ml_output_puts_static (io, "<form>");
       ml_widget_repaint (w->w, session, windowid, io);
-      io_fputs ("</form>", io);
+      ml_output_puts_static (io, "</form>");
     }
 }
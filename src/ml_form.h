@@ -79,6 +79,12 @@ typedef struct ml_form *ml_form;
  * @code{form.name}: A read-only property containing the name of
  * the form. It is unlikely that you will ever need to know this.
  *
+ * @code{form.once}: If set to true, then each time the form is
+ * displayed it carries a fresh single-use token, and if the same
+ * copy of the form is submitted more than once (eg. the user clicks
+ * the submit button twice, or goes back and resubmits), the callback
+ * function is only called the first time. Default: false.
+ *
  * See also: @ref{new_ml_form_input(3)}, @ref{new_ml_form_textarea(3)},
  * @ref{new_ml_form_submit(3)}.
  */
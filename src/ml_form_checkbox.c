@@ -31,14 +31,15 @@
 #include "ml_form_input.h"
 #include "ml_form_checkbox.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static void clear_value (void *);
 static void set_value (void *, const char *value);
 static const char *get_value (void *);
 
 struct ml_widget_operations form_checkbox_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_form_checkbox"
   };
 
 struct ml_form_input_operations form_checkbox_input_ops =
@@ -70,6 +71,8 @@ new_ml_form_checkbox (pool pool, ml_form form)
   /* Register ourselves with the form. */
   w->name = _ml_form_register_widget (form, w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -99,12 +102,12 @@ get_value (void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_checkbox w = (ml_form_checkbox) vw;
 
-  io_fprintf (io, "<input class=\"ml_form_checkbox\" type=\"checkbox\" "
-	      "name=\"%s\" value=\"1\""
-	      "%s />",
-	      w->name, w->value ? " checked=\"1\"" : "");
+  ml_output_printf (io, "<input class=\"ml_form_checkbox\" type=\"checkbox\" "
+		    "name=\"%s\" value=\"1\""
+		    "%s />",
+		    w->name, w->value ? " checked=\"1\"" : "");
 }
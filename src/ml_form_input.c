@@ -37,6 +37,7 @@ ml_form_input_set_value (void *vw, const char *value)
   struct form_input *w = (struct form_input *) vw;
 
   w->fops->set_value (vw, value);
+  ml_widget_invalidate (vw);
 }
 
 const char *
@@ -53,4 +54,5 @@ ml_form_input_clear_value (void *vw)
   struct form_input *w = (struct form_input *) vw;
 
   w->fops->clear_value (vw);
+  ml_widget_invalidate (vw);
 }
@@ -28,13 +28,14 @@
 #include "ml_multicol_layout.h"
 #include "ml_form_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations form_layout_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_form_layout",
   };
 
 struct ml_form_layout
@@ -67,6 +68,8 @@ new_ml_form_layout (pool pool)
   w->clazz = "ml_form_layout";
   update_table_class (w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -113,7 +116,7 @@ ml_form_layout_pack_help (ml_form_layout w, const char *help_text)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_layout w = (ml_form_layout) vw;
 
@@ -31,12 +31,13 @@
 #include "ml_form_input.h"
 #include "ml_form_radio.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static const char *get_value (void *);
 
 struct ml_widget_operations form_radio_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_form_radio"
   };
 
 struct ml_form_input_operations form_radio_input_ops =
@@ -72,12 +73,15 @@ new_ml_form_radio (pool pool, ml_form_radio_group group, const char *value)
   /* Register ourselves with the radio button group widget. */
   w->name = _ml_form_radio_group_register (group, w, value);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_form_radio_set_checked (ml_form_radio w, int checked)
 {
+  ml_widget_invalidate (w);
   w->is_checked = checked;
 }
 
@@ -96,13 +100,13 @@ get_value (void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_radio w = (ml_form_radio) vw;
 
-  io_fprintf (io, "<input class=\"ml_form_radio\" type=\"radio\" "
-	      "name=\"%s\" value=\"%s\""
-	      "%s />",
-	      w->name, w->value,
-	      w->is_checked ? " checked=\"1\"" : "");
+  ml_output_printf (io, "<input class=\"ml_form_radio\" type=\"radio\" "
+		    "name=\"%s\" value=\"%s\""
+		    "%s />",
+		    w->name, w->value,
+		    w->is_checked ? " checked=\"1\"" : "");
 }
@@ -36,14 +36,15 @@
 #include "ml_form_radio.h"
 #include "ml_form_radio_group.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static void clear_value (void *);
 static void set_value (void *, const char *value);
 static const char *get_value (void *);
 
 struct ml_widget_operations form_radio_group_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_form_radio_group"
   };
 
 struct ml_form_input_operations form_radio_group_input_ops =
@@ -79,6 +80,8 @@ new_ml_form_radio_group (pool pool, ml_form form)
   /* Register ourselves with the form. */
   w->name = _ml_form_register_widget (form, w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -93,6 +96,7 @@ _ml_form_radio_group_register (ml_form_radio_group w, ml_form_radio r,
 void
 ml_form_radio_group_pack (ml_form_radio_group w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   w->w = _w;
 }
 
@@ -135,7 +139,7 @@ get_value (void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_radio_group w = (ml_form_radio_group) vw;
 
@@ -27,7 +27,7 @@
 #include "ml_form_input.h"
 #include "ml_form_select.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 static void set_value (void *, const char *value);
 static void clear_value (void *);
@@ -36,6 +36,7 @@ struct ml_widget_operations form_select_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_form_select",
   };
 
 struct ml_form_input_operations form_select_input_ops =
@@ -86,12 +87,15 @@ new_ml_form_select (pool pool, ml_form form)
   /* Register ourselves with the form. */
   w->name = _ml_form_register_widget (form, w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_form_select_push_back (ml_form_select w, const char *option)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->options, option);
 }
 
@@ -100,6 +104,7 @@ ml_form_select_pop_back (ml_form_select w)
 {
   const char *option;
 
+  ml_widget_invalidate (w);
   vector_pop_back (w->options, option);
   return option;
 }
@@ -107,6 +112,7 @@ ml_form_select_pop_back (ml_form_select w)
 void
 ml_form_select_push_front (ml_form_select w, const char *option)
 {
+  ml_widget_invalidate (w);
   vector_push_front (w->options, option);
 }
 
@@ -115,6 +121,7 @@ ml_form_select_pop_front (ml_form_select w)
 {
   const char *option;
 
+  ml_widget_invalidate (w);
   vector_pop_front (w->options, option);
   return option;
 }
@@ -131,24 +138,28 @@ ml_form_select_get (ml_form_select w, int option_index)
 void
 ml_form_select_insert (ml_form_select w, int option_index, const char *option)
 {
+  ml_widget_invalidate (w);
   vector_insert (w->options, option_index, option);
 }
 
 void
 ml_form_select_replace (ml_form_select w, int option_index, const char *option)
 {
+  ml_widget_invalidate (w);
   vector_replace (w->options, option_index, option);
 }
 
 void
 ml_form_select_erase (ml_form_select w, int option_index)
 {
+  ml_widget_invalidate (w);
   vector_erase (w->options, option_index);
 }
 
 void
 ml_form_select_clear (ml_form_select w)
 {
+  ml_widget_invalidate (w);
   vector_clear (w->options);
 }
 
@@ -161,6 +172,8 @@ ml_form_select_size (ml_form_select w)
 void
 ml_form_select_set_selection (ml_form_select w, int option_index)
 {
+  ml_widget_invalidate (w);
+
   if (!w->multiple)
     w->selected = option_index;
   else
@@ -170,6 +183,8 @@ ml_form_select_set_selection (ml_form_select w, int option_index)
 void
 ml_form_select_set_selections (ml_form_select w, vector selected)
 {
+  ml_widget_invalidate (w);
+
   if (w->multiple)
     w->selections = selected;
   else
@@ -248,26 +263,27 @@ is_selected (ml_form_select w, int index)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_select w = (ml_form_select) vw;
   int i;
   const char *option;
 
-  io_fprintf (io, "<select class=\"ml_form_select\" name=\"%s\"", w->name);
-  if (w->size) io_fprintf (io, " size=\"%d\"", w->size);
-  if (w->multiple) io_fprintf (io, " multiple=\"1\"");
-  io_fprintf (io, ">");
+  ml_output_printf (io, "<select class=\"ml_form_select\" name=\"%s\"",
+		    w->name);
+  if (w->size) ml_output_printf (io, " size=\"%d\"", w->size);
+  if (w->multiple) ml_output_puts_static (io, " multiple=\"1\"");
+  ml_output_puts_static (io, ">");
 
   for (i = 0; i < vector_size (w->options); ++i)
     {
       vector_get (w->options, i, option);
 
-      io_fprintf (io, "<option value=\"%d\"", i);
+      ml_output_printf (io, "<option value=\"%d\"", i);
       if (is_selected (w, i))
-	io_fprintf (io, " selected=\"1\"");
-      io_fprintf (io, ">%s</option>\n", option);
+	ml_output_puts_static (io, " selected=\"1\"");
+      ml_output_printf (io, ">%s</option>\n", option);
     }
 
-  io_fprintf (io, "</select>");
+  ml_output_puts_static (io, "</select>");
 }
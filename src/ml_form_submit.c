@@ -27,14 +27,15 @@
 #include "ml_smarttext.h"
 #include "ml_form_submit.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static void clear_value (void *);
 static void set_value (void *, const char *value);
 static const char *get_value (void *);
 
 struct ml_widget_operations form_submit_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_form_submit"
   };
 
 struct ml_form_input_operations form_submit_input_ops =
@@ -66,6 +67,8 @@ new_ml_form_submit (pool pool, ml_form form, const char *value)
   /* Register ourselves with the form. */
   w->name = _ml_form_register_widget (form, w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -94,13 +97,13 @@ get_value (void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_submit w = (ml_form_submit) vw;
 
-  io_fprintf (io, "<input class=\"ml_form_submit\" "
-	      "type=\"submit\" name=\"%s\" value=\"",
-	      w->name);
+  ml_output_printf (io, "<input class=\"ml_form_submit\" "
+		    "type=\"submit\" name=\"%s\" value=\"",
+		    w->name);
   if (w->value) ml_plaintext_print (io, w->value);
-  io_fputs ("\" />", io);
+  ml_output_puts_static (io, "\" />");
 }
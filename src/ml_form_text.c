@@ -32,7 +32,7 @@
 #include "ml_form_input.h"
 #include "ml_form_text.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 static void clear_value (void *);
 static void set_value (void *, const char *value);
@@ -42,6 +42,7 @@ struct ml_widget_operations form_text_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_form_text",
   };
 
 struct ml_form_input_operations form_text_input_ops =
@@ -91,12 +92,15 @@ new_ml_form_text (pool pool, ml_form form)
   /* Register ourselves with the form. */
   w->name = _ml_form_register_widget (form, w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_form_text_focus (ml_form_text w)
 {
+  ml_widget_invalidate (w);
   w->focus = 1;
 }
 
@@ -126,19 +130,19 @@ get_value (void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_text w = (ml_form_text) vw;
 
-  io_fprintf (io, "<input class=\"ml_form_text\" name=\"%s\" value=\"",
-	      w->name);
+  ml_output_printf (io, "<input class=\"ml_form_text\" name=\"%s\" value=\"",
+		    w->name);
   if (w->value) ml_plaintext_print (io, w->value);
-  io_fputc ('"', io);
+  ml_output_putc (io, '"');
   if (w->size >= 0)
-    io_fprintf (io, " size=\"%d\"", w->size);
+    ml_output_printf (io, " size=\"%d\"", w->size);
   if (w->maxlength >= 0)
-    io_fprintf (io, " maxlength=\"%d\"", w->maxlength);
-  io_fputs (" />", io);
+    ml_output_printf (io, " maxlength=\"%d\"", w->maxlength);
+  ml_output_puts_static (io, " />");
 
   /* XXX It is quite likely this won't work. It looks like we need to
    * provide an onLoad function in the window to do this reliably.
@@ -149,9 +153,9 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
 
       ml_widget_get_property (w->form, "form.name", form_name);
 
-      io_fprintf (io, "<script language=\"javascript\"><!--\n"
-		  "  document.%s.%s.focus ();\n"
-		  "//--></script>\n",
-		  form_name, w->name);
+      ml_output_printf (io, "<script language=\"javascript\"><!--\n"
+			"  document.%s.%s.focus ();\n"
+			"//--></script>\n",
+			form_name, w->name);
     }
 }
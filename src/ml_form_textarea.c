@@ -31,14 +31,15 @@
 #include "ml_smarttext.h"
 #include "ml_form_textarea.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static void clear_value (void *);
 static void set_value (void *, const char *value);
 static const char *get_value (void *);
 
 struct ml_widget_operations form_textarea_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_form_textarea"
   };
 
 struct ml_form_input_operations form_textarea_input_ops =
@@ -73,6 +74,8 @@ new_ml_form_textarea (pool pool, ml_form form, int rows, int cols)
   /* Register ourselves with the form. */
   w->name = _ml_form_register_widget (form, w);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -102,13 +105,13 @@ get_value (void *vw)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_form_textarea w = (ml_form_textarea) vw;
 
-  io_fprintf (io, "<textarea class=\"ml_form_textarea\" "
-	      "rows=\"%d\" cols=\"%d\" name=\"%s\">",
-	      w->rows, w->cols, w->name);
+  ml_output_printf (io, "<textarea class=\"ml_form_textarea\" "
+		    "rows=\"%d\" cols=\"%d\" name=\"%s\">",
+		    w->rows, w->cols, w->name);
   if (w->value) ml_plaintext_print (io, w->value); /* XXX Correct? */
-  io_fputs ("</textarea>", io);
+  ml_output_puts_static (io, "</textarea>");
 }
@@ -31,13 +31,14 @@
 #include "ml_smarttext.h"
 #include "ml_heading.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations heading_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_heading",
   };
 
 struct ml_heading
@@ -69,18 +70,20 @@ new_ml_heading (pool pool, int level, const char *text)
   w->level = level;
   w->text = text;
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_heading w = (ml_heading) vw;
 
   if (w->text)
     {
-      io_fprintf (io, "<h%d class=\"ml_heading\">", w->level);
+      ml_output_printf (io, "<h%d class=\"ml_heading\">", w->level);
       ml_plaintext_print (io, w->text);
-      io_fprintf (io, "</h%d>", w->level);
+      ml_output_printf (io, "</h%d>", w->level);
     }
 }
@@ -26,11 +26,12 @@
 #include "monolith.h"
 #include "ml_horizontal_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations horizontal_layout_ops =
   {
-    repaint: repaint
+    repaint: repaint,
+    name: "ml_horizontal_layout"
   };
 
 struct ml_horizontal_layout
@@ -49,18 +50,22 @@ new_ml_horizontal_layout (pool pool)
   w->pool = pool;
   w->v = new_vector (pool, ml_widget);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_horizontal_layout_push_back (ml_horizontal_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->v, _w);
 }
 
 void
 ml_horizontal_layout_pack (ml_horizontal_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->v, _w);
 }
 
@@ -69,6 +74,7 @@ ml_horizontal_layout_pop_back (ml_horizontal_layout w)
 {
   ml_widget _w;
 
+  ml_widget_invalidate (w);
   vector_pop_back (w->v, _w);
   return _w;
 }
@@ -76,6 +82,7 @@ ml_horizontal_layout_pop_back (ml_horizontal_layout w)
 void
 ml_horizontal_layout_push_front (ml_horizontal_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_front (w->v, _w);
 }
 
@@ -84,6 +91,7 @@ ml_horizontal_layout_pop_front (ml_horizontal_layout w)
 {
   ml_widget _w;
 
+  ml_widget_invalidate (w);
   vector_pop_front (w->v, _w);
   return _w;
 }
@@ -100,24 +108,28 @@ ml_horizontal_layout_get (ml_horizontal_layout w, int i)
 void
 ml_horizontal_layout_insert (ml_horizontal_layout w, int i, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_insert (w->v, i, _w);
 }
 
 void
 ml_horizontal_layout_replace (ml_horizontal_layout w, int i, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_replace (w->v, i, _w);
 }
 
 void
 ml_horizontal_layout_erase (ml_horizontal_layout w, int i)
 {
+  ml_widget_invalidate (w);
   vector_erase (w->v, i);
 }
 
 void
 ml_horizontal_layout_clear (ml_horizontal_layout w)
 {
+  ml_widget_invalidate (w);
   vector_clear (w->v);
 }
 
@@ -128,22 +140,22 @@ ml_horizontal_layout_size (ml_horizontal_layout w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_horizontal_layout w = (ml_horizontal_layout) vw;
   int i;
 
-  io_fputs ("<table><tr>", io);
+  ml_output_puts_static (io, "<table><tr>");
 
   for (i = 0; i < vector_size (w->v); ++i)
     {
       ml_widget _w;
 
       vector_get (w->v, i, _w);
-      io_fputs ("<td valign=\"top\">", io);
+      ml_output_puts_static (io, "<td valign=\"top\">");
       ml_widget_repaint (_w, session, windowid, io);
-      io_fputs ("</td>\n", io);
+      ml_output_puts_static (io, "</td>\n");
     }
 
-  io_fputs ("</tr></table>", io);
+  ml_output_puts_static (io, "</tr></table>");
 }
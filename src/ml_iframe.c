@@ -28,7 +28,7 @@
 #include "ml_widget.h"
 #include "ml_iframe.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations iframe_ops =
@@ -80,33 +80,33 @@ new_ml_iframe (pool pool, void (*fn) (ml_session, void *),
   w->non_frame_widget = non_frame_widget;
 
   /* Register the callback. */
-  w->action_id = ml_register_action (session, fn, data);
+  w->action_id = ml_register_action_in_pool (session, pool, fn, data);
 
   return w;
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_iframe w = (ml_iframe) vw;
 
-  io_fprintf (io, "<iframe src=\"%s?ml_action=%s&ml_window=%s\"",
-	      ml_session_script_name (session), w->action_id, windowid);
+  ml_output_printf (io, "<iframe src=\"%s?ml_action=%s&ml_window=%s\"",
+		    ml_session_script_name (session), w->action_id, windowid);
 
   if (w->clazz)
-    io_fprintf (io, " class=\"%s\"", w->clazz);
+    ml_output_printf (io, " class=\"%s\"", w->clazz);
   if (w->width)
-    io_fprintf (io, " width=\"%d\"", w->width);
+    ml_output_printf (io, " width=\"%d\"", w->width);
   if (w->height)
-    io_fprintf (io, " height=\"%d\"", w->height);
+    ml_output_printf (io, " height=\"%d\"", w->height);
   if (w->scrolling)
-    io_fprintf (io, " scrolling=\"%s\"", w->scrolling);
-  io_fputs (">", io);
+    ml_output_printf (io, " scrolling=\"%s\"", w->scrolling);
+  ml_output_puts_static (io, ">");
 
   if (w->non_frame_widget)
     ml_widget_repaint (w->non_frame_widget, session, windowid, io);
   else
-    io_fputs ("Your browser does not support frames.", io);
+    ml_output_puts_static (io, "Your browser does not support frames.");
 
-  io_fputs ("</iframe>", io);
+  ml_output_puts_static (io, "</iframe>");
 }
@@ -26,13 +26,14 @@
 #include "ml_widget.h"
 #include "ml_image.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations image_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_image",
   };
 
 struct ml_image
@@ -59,16 +60,18 @@ new_ml_image (pool pool, const char *src)
   w->pool = pool;
   w->src = src;
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_image w = (ml_image) vw;
 
   if (w->src)
     {
-      io_fprintf (io, "<img src=\"%s\" />", w->src);
+      ml_output_printf (io, "<img src=\"%s\" />", w->src);
     }
 }
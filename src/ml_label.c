@@ -26,13 +26,14 @@
 #include "monolith.h"
 #include "ml_label.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations label_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_label",
   };
 
 struct ml_label
@@ -59,13 +60,15 @@ new_ml_label (pool pool, const char *text)
   w->pool = pool;
   w->text = text;
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_label w = (ml_label) vw;
 
-  if (w->text) io_fputs (w->text, io);
+  if (w->text) ml_output_puts (io, w->text);
 }
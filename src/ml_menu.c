@@ -33,7 +33,7 @@
 #include "ml_smarttext.h"
 #include "ml_menu.h"
 
-static void menubar_repaint (void *, ml_session, const char *, io_handle);
+static void menubar_repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property menubar_properties[];
 
 struct ml_widget_operations menubar_ops =
@@ -61,7 +61,7 @@ struct menu
   ml_menu menu;
 };
 
-static void menu_repaint (void *, ml_session, const char *, io_handle);
+static void menu_repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property menu_properties[];
 
 struct ml_widget_operations menu_ops =
@@ -82,7 +82,7 @@ static struct ml_widget_property menu_properties[] =
     { 0 }
   };
 
-static void menuitem_button_repaint (void *, ml_session, const char *, io_handle);
+static void menuitem_button_repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property menuitem_button_properties[];
 
 struct ml_widget_operations menuitem_button_ops =
@@ -105,7 +105,7 @@ static struct ml_widget_property menuitem_button_properties[] =
     { 0 }
   };
 
-static void menuitem_separator_repaint (void *, ml_session, const char *, io_handle);
+static void menuitem_separator_repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property menuitem_separator_properties[];
 
 struct ml_widget_operations menuitem_separator_ops =
@@ -223,24 +223,24 @@ ml_menubar_pack (ml_menubar w, ml_widget _w)
 
 static void
 menubar_repaint (void *vw, ml_session session,
-		 const char *windowid, io_handle io)
+		 const char *windowid, ml_output io)
 {
   ml_menubar w = (ml_menubar) vw;
   struct menu m;
   int i;
 
-  io_fputs ("<table class=\"ml_menubar\"><tr>", io);
+  ml_output_puts_static (io, "<table class=\"ml_menubar\"><tr>");
 
   for (i = 0; i < vector_size (w->menus); ++i)
     {
       vector_get (w->menus, i, m);
 
-      io_fprintf (io, "<td class=\"ml_menubar_item\">%s", m.name);
+      ml_output_printf (io, "<td class=\"ml_menubar_item\">%s", m.name);
       menu_repaint (m.menu, session, windowid, io);
-      io_fputs ("</td>\n", io);
+      ml_output_puts_static (io, "</td>\n");
     }
 
-  io_fputs ("<td width=\"100%\"></td></tr></table>", io);
+  ml_output_puts_static (io, "<td width=\"100%\"></td></tr></table>");
 
   if (w->w) ml_widget_repaint (w->w, session, windowid, io);
 }
@@ -359,24 +359,24 @@ ml_menu_pack (ml_menu w, ml_widget menu_or_menuitem)
 
 static void
 menu_repaint (void *vw, ml_session session,
-	      const char *windowid, io_handle io)
+	      const char *windowid, ml_output io)
 {
   ml_menu w = (ml_menu) vw;
   int i;
   ml_widget m;
 
-  io_fputs ("<ul>", io);
+  ml_output_puts_static (io, "<ul>");
 
   for (i = 0; i < vector_size (w->items); ++i)
     {
       vector_get (w->items, i, m);
 
-      io_fputs ("<li>", io);
+      ml_output_puts_static (io, "<li>");
       ml_widget_repaint (m, session, windowid, io);
-      io_fputs ("</li>\n", io);
+      ml_output_puts_static (io, "</li>\n");
     }
 
-  io_fputs ("</ul>\n", io);
+  ml_output_puts_static (io, "</ul>\n");
 }
 
 ml_menuitem_button
@@ -403,12 +403,12 @@ ml_menuitem_button_set_callback (ml_menuitem_button w,
   w->action_id = 0;
 
   if (fn)
-    w->action_id = ml_register_action (session, fn, data);
+    w->action_id = ml_register_action_in_pool (session, w->pool, fn, data);
 }
 
 static void
 menuitem_button_repaint (void *vw, ml_session session,
-			 const char *windowid, io_handle io)
+			 const char *windowid, ml_output io)
 {
   ml_menuitem_button w = (ml_menuitem_button) vw;
 
@@ -416,29 +416,25 @@ menuitem_button_repaint (void *vw, ml_session session,
     {
       if (w->action_id)
 	{
-	  pool tmp = new_subpool (w->pool);
-
 	  const char *link =
-	    psprintf (tmp, "%s?ml_action=%s&ml_window=%s",
-		      ml_session_script_name (session),
-		      w->action_id,
-		      windowid);
+	    ml_scratch_sprintf (session, "%s?ml_action=%s&ml_window=%s",
+				ml_session_script_name (session),
+				w->action_id,
+				windowid);
 
-	  io_fprintf (io, "<a href=\"%s\"", link);
+	  ml_output_printf (io, "<a href=\"%s\"", link);
 
 	  if (w->title)
 	    {
-	      io_fputs (" title=\"", io);
+	      ml_output_puts_static (io, " title=\"");
 	      ml_plaintext_print (io, w->title);
-	      io_fputc ('"', io);
+	      ml_output_putc (io, '"');
 	    }
 
-	  io_fprintf (io, ">%s</a>", w->text);
-
-	  delete_pool (tmp);
+	  ml_output_printf (io, ">%s</a>", w->text);
 	}
       else
-	io_fprintf (io, "<span>%s</span>", w->text);
+	ml_output_printf (io, "<span>%s</span>", w->text);
     }
 }
 
@@ -455,7 +451,7 @@ new_ml_menuitem_separator (pool pool)
 
 static void
 menuitem_separator_repaint (void *vw, ml_session session,
-			    const char *windowid, io_handle io)
+			    const char *windowid, ml_output io)
 {
-  io_fputs ("<hr />", io);
+  ml_output_puts_static (io, "<hr />");
 }
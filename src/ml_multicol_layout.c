@@ -27,13 +27,14 @@
 #include "ml_table_layout.h"
 #include "ml_multicol_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations multicol_layout_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_multicol_layout",
   };
 
 struct ml_multicol_layout
@@ -73,6 +74,8 @@ new_ml_multicol_layout (pool pool, int nr_cols)
   w->r = w->c = 0;
   w->clazz = 0;
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
@@ -141,7 +144,7 @@ make_cell (ml_multicol_layout w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_multicol_layout w = (ml_multicol_layout) vw;
 
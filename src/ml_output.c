@@ -0,0 +1,478 @@
+/* Monolith response output buffers.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#endif
+
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_TIME_H
+#include <time.h>
+#endif
+
+#include <zlib.h>
+
+#include <pool.h>
+#include <pstring.h>
+#include <pthr_pseudothread.h>
+#include <pthr_iolib.h>
+
+#include "ml_output.h"
+#include "scratch.h"
+
+/* The buffer is a list of segments, which are sent with writev. Text
+ * which is appended is copied into chunks borrowed from a scratch
+ * arena, and consecutive appends to the same chunk just make the last
+ * segment longer. Long constant strings get a segment of their own
+ * pointing at the string itself, so they are never copied. Short ones
+ * are cheaper to copy than to send as a separate segment.
+ */
+#define CHUNK_SIZE 4096		/* Bytes in each chunk. */
+#define MIN_STATIC_SIZE 64	/* Shorter static strings are copied. */
+#define INITIAL_SEGS 32
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+struct ml_output
+{
+  pool pool;			/* Pool for allocations. */
+  scratch scratch;		/* Arena for chunks. */
+  struct iovec *segs;		/* Segments. */
+  int nr_segs, segs_alloc;
+  char *chunk;			/* Current chunk (0 = none yet). */
+  int chunk_used;		/* Bytes used in the current chunk. */
+  int size;			/* Total bytes in the buffer. */
+  void *capture;		/* Used by the widget fragment cache. */
+};
+
+/* Statistics. */
+static int nr_pages = 0;
+static int nr_syscalls = 0;
+static long long bytes_sent = 0;
+static long long bytes_copied = 0;
+static int nr_compressed = 0;
+static long long bytes_before_compression = 0;
+static long long bytes_after_compression = 0;
+static long long compression_usecs = 0;
+
+ml_output
+new_ml_output (pool pool)
+{
+  ml_output o = pmalloc (pool, sizeof *o);
+
+  o->pool = pool;
+  o->scratch = new_scratch (pool);
+  o->segs = pmalloc (pool, INITIAL_SEGS * sizeof (struct iovec));
+  o->nr_segs = 0;
+  o->segs_alloc = INITIAL_SEGS;
+  o->chunk = 0;
+  o->chunk_used = 0;
+  o->size = 0;
+  o->capture = 0;
+
+  return o;
+}
+
+static void
+add_segment (ml_output o, const char *ptr, int n)
+{
+  struct iovec *last;
+
+  if (n == 0) return;
+
+  o->size += n;
+
+  /* Does this carry straight on from the last segment? */
+  if (o->nr_segs > 0)
+    {
+      last = &o->segs[o->nr_segs-1];
+      if ((char *) last->iov_base + last->iov_len == ptr)
+	{
+	  last->iov_len += n;
+	  return;
+	}
+    }
+
+  if (o->nr_segs == o->segs_alloc)
+    {
+      o->segs_alloc *= 2;
+      o->segs = prealloc (o->pool, o->segs,
+			  o->segs_alloc * sizeof (struct iovec));
+    }
+
+  o->segs[o->nr_segs].iov_base = (void *) ptr;
+  o->segs[o->nr_segs].iov_len = n;
+  o->nr_segs++;
+}
+
+static void
+new_chunk (ml_output o)
+{
+  o->chunk = scratch_alloc (o->scratch, CHUNK_SIZE);
+  o->chunk_used = 0;
+}
+
+void
+ml_output_write (ml_output o, const void *vptr, int n)
+{
+  const char *ptr = (const char *) vptr;
+  int m;
+
+  bytes_copied += n;
+
+  while (n > 0)
+    {
+      if (!o->chunk || o->chunk_used == CHUNK_SIZE)
+	new_chunk (o);
+
+      m = CHUNK_SIZE - o->chunk_used;
+      if (m > n) m = n;
+
+      memcpy (o->chunk + o->chunk_used, ptr, m);
+      add_segment (o, o->chunk + o->chunk_used, m);
+      o->chunk_used += m;
+      ptr += m;
+      n -= m;
+    }
+}
+
+void
+ml_output_puts (ml_output o, const char *s)
+{
+  ml_output_write (o, s, strlen (s));
+}
+
+void
+ml_output_puts_static (ml_output o, const char *s)
+{
+  int n = strlen (s);
+
+  if (n < MIN_STATIC_SIZE)
+    ml_output_write (o, s, n);
+  else
+    add_segment (o, s, n);
+}
+
+void
+ml_output_putc (ml_output o, int c)
+{
+  char ch = c;
+
+  if (o->chunk && o->chunk_used < CHUNK_SIZE)
+    {
+      bytes_copied++;
+      o->chunk[o->chunk_used] = ch;
+      add_segment (o, o->chunk + o->chunk_used, 1);
+      o->chunk_used++;
+    }
+  else
+    ml_output_write (o, &ch, 1);
+}
+
+void
+ml_output_printf (ml_output o, const char *fs, ...)
+{
+  va_list args;
+  char *str;
+  int n, avail;
+
+  /* Usually the string fits in the rest of the current chunk. */
+  avail = o->chunk ? CHUNK_SIZE - o->chunk_used : 0;
+  str = o->chunk ? o->chunk + o->chunk_used : 0;
+
+  va_start (args, fs);
+  n = vsnprintf (str, avail, fs, args);
+  va_end (args);
+
+  if (n >= avail)
+    {
+      /* Start a new chunk, or if the string is too big for that, give
+       * it some memory of its own.
+       */
+      if (n < CHUNK_SIZE)
+	{
+	  new_chunk (o);
+	  str = o->chunk;
+	}
+      else
+	str = scratch_alloc (o->scratch, n + 1);
+
+      va_start (args, fs);
+      vsnprintf (str, n + 1, fs, args);
+      va_end (args);
+    }
+
+  bytes_copied += n;
+  add_segment (o, str, n);
+  if (str == o->chunk + o->chunk_used)
+    o->chunk_used += n;
+}
+
+int
+ml_output_size (ml_output o)
+{
+  return o->size;
+}
+
+void
+ml_output_copy (ml_output o, int offset, char *buf)
+{
+  int i, n, skip;
+
+  assert (offset >= 0 && offset <= o->size);
+
+  /* Walk backwards from the end, since the caller usually only wants
+   * the last few segments.
+   */
+  for (i = o->nr_segs, n = o->size; i > 0 && n > offset; )
+    n -= o->segs[--i].iov_len;
+
+  skip = offset - n;
+  for (; i < o->nr_segs; ++i)
+    {
+      n = o->segs[i].iov_len - skip;
+      memcpy (buf, (char *) o->segs[i].iov_base + skip, n);
+      buf += n;
+      skip = 0;
+    }
+}
+
+/* zlib gives us two different 32 bit checksums, which together are
+ * good enough to tell whether a page has changed.
+ */
+const char *
+ml_output_checksum (ml_output o, pool pool)
+{
+  uLong crc = crc32 (0, Z_NULL, 0);
+  uLong adler = adler32 (0, Z_NULL, 0);
+  int i;
+
+  for (i = 0; i < o->nr_segs; ++i)
+    {
+      crc = crc32 (crc, o->segs[i].iov_base, o->segs[i].iov_len);
+      adler = adler32 (adler, o->segs[i].iov_base, o->segs[i].iov_len);
+    }
+
+  return psprintf (pool, "%08lx%08lx", crc & 0xffffffffUL,
+		   adler & 0xffffffffUL);
+}
+
+/* Compress the buffer, segment by segment, into fresh chunks. The old
+ * segments stay where they are (the chunks they point to belong to the
+ * arena until the request finishes), so we only need a new list of
+ * segments.
+ */
+int
+ml_output_compress (ml_output o, int encoding, int level)
+{
+  z_stream z;
+  struct iovec *old_segs = o->segs;
+  int old_nr_segs = o->nr_segs, old_size = o->size;
+  int i, r, n, flush;
+  clock_t start = clock ();
+
+  memset (&z, 0, sizeof z);
+  if (deflateInit2 (&z, level, Z_DEFLATED,
+		    encoding == ML_OUTPUT_GZIP ? 15 + 16 : 15,
+		    8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return -1;
+
+  o->segs = pmalloc (o->pool, o->segs_alloc * sizeof (struct iovec));
+  o->nr_segs = 0;
+  o->size = 0;
+  o->chunk = 0;
+
+  for (i = 0; i <= old_nr_segs; ++i)
+    {
+      if (i < old_nr_segs)
+	{
+	  z.next_in = (Bytef *) old_segs[i].iov_base;
+	  z.avail_in = old_segs[i].iov_len;
+	  flush = Z_NO_FLUSH;
+	}
+      else
+	{
+	  z.next_in = 0;
+	  z.avail_in = 0;
+	  flush = Z_FINISH;
+	}
+
+      do
+	{
+	  if (!o->chunk || o->chunk_used == CHUNK_SIZE)
+	    new_chunk (o);
+
+	  z.next_out = (Bytef *) o->chunk + o->chunk_used;
+	  z.avail_out = CHUNK_SIZE - o->chunk_used;
+
+	  r = deflate (&z, flush);
+	  assert (r != Z_STREAM_ERROR);
+
+	  n = CHUNK_SIZE - o->chunk_used - z.avail_out;
+	  add_segment (o, o->chunk + o->chunk_used, n);
+	  o->chunk_used += n;
+	}
+      while (flush == Z_FINISH ? r != Z_STREAM_END
+	     : z.avail_in > 0 || z.avail_out == 0);
+    }
+
+  deflateEnd (&z);
+
+  nr_compressed++;
+  bytes_before_compression += old_size;
+  bytes_after_compression += o->size;
+  compression_usecs +=
+    (long long) (clock () - start) * 1000000 / CLOCKS_PER_SEC;
+
+  return 0;
+}
+
+int
+ml_output_send (ml_output o, io_handle io)
+{
+  struct iovec *iov = o->segs;
+  int fd, nr = o->nr_segs, r;
+
+  nr_pages++;
+
+  /* Send the headers. */
+  io_fflush (io);
+  nr_syscalls++;
+
+  fd = io_fileno (io);
+
+  while (nr > 0)
+    {
+      r = writev (fd, iov, nr < IOV_MAX ? nr : IOV_MAX);
+      nr_syscalls++;
+
+      if (r == -1)
+	{
+	  if (errno == EAGAIN || errno == EWOULDBLOCK)
+	    {
+	      pth_wait_writable (fd);
+	      continue;
+	    }
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+
+      bytes_sent += r;
+
+      /* Skip over the segments which have been sent. */
+      while (nr > 0 && r >= iov->iov_len)
+	{
+	  r -= iov->iov_len;
+	  iov++;
+	  nr--;
+	}
+      if (r > 0)
+	{
+	  iov->iov_base = (char *) iov->iov_base + r;
+	  iov->iov_len -= r;
+	}
+    }
+
+  return 0;
+}
+
+int
+_ml_output_get_nr_pages ()
+{
+  return nr_pages;
+}
+
+int
+_ml_output_get_nr_syscalls ()
+{
+  return nr_syscalls;
+}
+
+long long
+_ml_output_get_bytes_sent ()
+{
+  return bytes_sent;
+}
+
+long long
+_ml_output_get_bytes_copied ()
+{
+  return bytes_copied;
+}
+
+int
+_ml_output_get_nr_compressed ()
+{
+  return nr_compressed;
+}
+
+long long
+_ml_output_get_bytes_before_compression ()
+{
+  return bytes_before_compression;
+}
+
+long long
+_ml_output_get_bytes_after_compression ()
+{
+  return bytes_after_compression;
+}
+
+long long
+_ml_output_get_compression_usecs ()
+{
+  return compression_usecs;
+}
+
+void *
+_ml_output_get_capture (ml_output o)
+{
+  return o->capture;
+}
+
+void
+_ml_output_set_capture (ml_output o, void *capture)
+{
+  o->capture = capture;
+}
@@ -0,0 +1,117 @@
+/* Monolith response output buffers.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#ifndef ML_OUTPUT_H
+#define ML_OUTPUT_H
+
+#include <pool.h>
+#include <pthr_iolib.h>
+
+struct ml_output;
+typedef struct ml_output *ml_output;
+
+#define ML_OUTPUT_GZIP    1
+#define ML_OUTPUT_DEFLATE 2
+
+/* Function: new_ml_output - buffer for the body of a response
+ * Function: ml_output_puts
+ * Function: ml_output_puts_static
+ * Function: ml_output_putc
+ * Function: ml_output_write
+ * Function: ml_output_printf
+ * Function: ml_output_size
+ * Function: ml_output_copy
+ * Function: ml_output_checksum
+ * Function: ml_output_compress
+ * Function: ml_output_send
+ *
+ * Widgets repaint themselves by writing HTML into an @code{ml_output}
+ * buffer, instead of writing directly to the connection. When the
+ * whole window has been painted, monolith knows how long the page is,
+ * so it can send a @code{Content-Length} header, and then it sends the
+ * page with as few system calls as possible.
+ *
+ * @code{new_ml_output} creates an empty buffer in @code{pool}.
+ *
+ * @code{ml_output_puts} appends a copy of the string @code{s}.
+ * @code{ml_output_puts_static} is the same, except that long strings
+ * are not copied: the buffer just remembers where the string is. It
+ * must only be used for string constants, or other strings which will
+ * not change or go away before the buffer is sent. In particular, the
+ * page is sent after the session has been unlocked, so strings
+ * belonging to widgets must be copied.
+ *
+ * @code{ml_output_putc} appends a single character.
+ * @code{ml_output_write} appends @code{n} bytes starting at @code{ptr}.
+ * @code{ml_output_printf} appends a formatted string.
+ *
+ * @code{ml_output_size} returns the number of bytes in the buffer.
+ * @code{ml_output_copy} copies everything from byte @code{offset} to
+ * the end of the buffer into @code{buf}, which must have room for
+ * @code{ml_output_size (o) - offset} bytes.
+ *
+ * @code{ml_output_checksum} returns a 64 bit checksum of the contents
+ * of the buffer, as 16 hex digits allocated in @code{pool}. This is
+ * not cryptographically strong, but buffers with different contents
+ * will almost never have the same checksum.
+ *
+ * @code{ml_output_compress} replaces the contents of the buffer with
+ * the same contents compressed using zlib at compression @code{level}
+ * (1-9). @code{encoding} is either @code{ML_OUTPUT_GZIP} (for
+ * @code{Content-Encoding: gzip}) or @code{ML_OUTPUT_DEFLATE} (for
+ * @code{Content-Encoding: deflate}). Nothing can be appended to the
+ * buffer afterwards. It returns @code{0}, or @code{-1} if zlib could
+ * not be initialised, in which case the buffer is left alone.
+ *
+ * @code{ml_output_send} writes the contents of the buffer to
+ * @code{io}, after flushing anything already buffered in @code{io}
+ * (such as the response headers). It returns @code{0}, or @code{-1}
+ * if there was a write error, for example because the browser closed
+ * the connection.
+ *
+ * See also: @ref{ml_widget_repaint(3)}.
+ */
+extern ml_output new_ml_output (pool pool);
+extern void ml_output_puts (ml_output, const char *s);
+extern void ml_output_puts_static (ml_output, const char *s);
+extern void ml_output_putc (ml_output, int c);
+extern void ml_output_write (ml_output, const void *ptr, int n);
+extern void ml_output_printf (ml_output, const char *fs, ...) __attribute__ ((format (printf, 2, 3)));
+extern int ml_output_size (ml_output);
+extern void ml_output_copy (ml_output, int offset, char *buf);
+extern const char *ml_output_checksum (ml_output, pool pool);
+extern int ml_output_compress (ml_output, int encoding, int level);
+extern int ml_output_send (ml_output, io_handle io);
+
+/* Private functions used by the stats app. */
+extern int _ml_output_get_nr_pages (void);
+extern int _ml_output_get_nr_syscalls (void);
+extern long long _ml_output_get_bytes_sent (void);
+extern long long _ml_output_get_bytes_copied (void);
+extern int _ml_output_get_nr_compressed (void);
+extern long long _ml_output_get_bytes_before_compression (void);
+extern long long _ml_output_get_bytes_after_compression (void);
+extern long long _ml_output_get_compression_usecs (void);
+
+/* Private functions used by the widget fragment cache. */
+extern void *_ml_output_get_capture (ml_output);
+extern void _ml_output_set_capture (ml_output, void *capture);
+
+#endif /* ML_OUTPUT_H */
@@ -0,0 +1,685 @@
+/* Monolith query result cache.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#endif
+
+#include <pool.h>
+#include <hash.h>
+#include <vector.h>
+#include <pstring.h>
+#include <pthr_reactor.h>
+#include <pthr_pseudothread.h>
+#include <pthr_dbi.h>
+
+#include "monolith.h"
+#include "ml_query_cache.h"
+
+/* Default size of the cache, in kilobytes. */
+#define QUERY_CACHE_SIZE 1024
+
+/* A cached result. Each entry has its own subpool, which holds the
+ * entry itself, the key, the tags and the result built by fill_fn.
+ */
+struct entry
+{
+  pool pool;			/* Subpool of cache_pool. */
+  const char *key;		/* Key (factory, SQL text and parameters). */
+  const void *result;		/* Result returned by fill_fn. */
+  vector tags;			/* Tags (vector of const char *). */
+  reactor_time_t expires;	/* When the result expires. */
+  int ttl;			/* Time to live (seconds). */
+  int size;			/* Size of the subpool. */
+  int pins;			/* Number of requests using the result. */
+  int dead;			/* Set if removed from the cache (the entry
+				 * is freed when the last request unpins it). */
+  int refreshing;		/* Set while a thread is fetching a new
+				 * result for this key. */
+  struct entry *prev, *next;	/* LRU list (most recently used first). */
+};
+
+static pool cache_pool;		/* Pool for the whole cache. */
+static pool index_pool;		/* Subpool holding the index. */
+static shash cache_index;	/* Hash key -> struct entry *. */
+static int nr_index_inserts;	/* Inserts since the index was rebuilt. */
+static struct entry *lru_head, *lru_tail;
+
+/* Each call to ml_query_cache_invalidate gets a new generation number,
+ * which is remembered against its tag. A fetch which started before
+ * the tag was invalidated may have read the old data, so its result
+ * is not put into the cache.
+ */
+static int generation;		/* Current generation. */
+static shash tag_generations;	/* Hash tag -> last invalidation. */
+
+static int nr_entries;		/* Number of entries in the cache. */
+static long long total_size;	/* Total size of the entries. */
+static long long budget;	/* Size limit (from the configuration). */
+static int nr_hits, nr_stale_hits, nr_misses, nr_evictions,
+  nr_invalidations;
+
+static void query_cache_init (void) __attribute__ ((constructor));
+static void query_cache_stop (void) __attribute__ ((destructor));
+
+static void
+query_cache_init ()
+{
+  cache_pool = new_subpool (global_pool);
+  index_pool = new_subpool (cache_pool);
+  cache_index = new_shash (index_pool, struct entry *);
+  tag_generations = new_shash (cache_pool, int);
+}
+
+static void
+query_cache_stop ()
+{
+  delete_pool (cache_pool);
+}
+
+/* The hash library never frees the space used by erased keys, so every
+ * so often we copy the live entries into a new index and throw the
+ * old one away.
+ */
+static void
+rebuild_index ()
+{
+  pool new_pool = new_subpool (cache_pool);
+  shash new_index = new_shash (new_pool, struct entry *);
+  struct entry *e;
+
+  for (e = lru_head; e; e = e->next)
+    shash_insert (new_index, e->key, e);
+
+  delete_pool (index_pool);
+  index_pool = new_pool;
+  cache_index = new_index;
+  nr_index_inserts = nr_entries;
+}
+
+static void
+lru_unlink (struct entry *e)
+{
+  if (e->prev) e->prev->next = e->next; else lru_head = e->next;
+  if (e->next) e->next->prev = e->prev; else lru_tail = e->prev;
+  e->prev = e->next = 0;
+}
+
+static void
+lru_push_front (struct entry *e)
+{
+  e->prev = 0;
+  e->next = lru_head;
+  if (lru_head) lru_head->prev = e; else lru_tail = e;
+  lru_head = e;
+}
+
+/* Take an entry out of the cache. It is freed now, or when the last
+ * request using it finishes.
+ */
+static void
+remove_entry (struct entry *e)
+{
+  shash_erase (cache_index, e->key);
+  lru_unlink (e);
+  nr_entries--;
+  total_size -= e->size;
+  e->dead = 1;
+
+  if (e->pins == 0)
+    delete_pool (e->pool);
+}
+
+static void
+unpin (void *ve)
+{
+  struct entry *e = (struct entry *) ve;
+
+  if (--e->pins == 0 && e->dead)
+    delete_pool (e->pool);
+}
+
+/* Stop the entry from being freed until the end of the current request
+ * (actually, until the thread's pool is deleted).
+ */
+static inline void
+pin (struct entry *e)
+{
+  e->pins++;
+  pool_register_cleanup_fn (pth_get_pool (current_pth), unpin, e);
+}
+
+static const void *
+use_entry (struct entry *e)
+{
+  lru_unlink (e);
+  lru_push_front (e);
+  pin (e);
+  return e->result;
+}
+
+static void
+evict ()
+{
+  while (budget > 0 && total_size > budget && lru_tail != lru_head)
+    {
+      remove_entry (lru_tail);
+      nr_evictions++;
+    }
+}
+
+/* Look up key in the cache. If there is a result we can use, returns
+ * the entry (pinned). Otherwise returns NULL and the caller must fetch
+ * a new result, in which case *oldp is set to the expired entry for
+ * this key, if there is one (it is pinned and marked as refreshing).
+ */
+static struct entry *
+lookup (ml_dbh_factory dbf, const char *key, struct entry **oldp)
+{
+  struct entry *old;
+
+  *oldp = 0;
+
+  if (shash_get (cache_index, key, old))
+    {
+      if (reactor_time < old->expires)
+	{
+	  nr_hits++;
+	  use_entry (old);
+	  return old;
+	}
+
+      /* The result has expired. If another thread is already fetching
+       * a new one, or if the database is too busy, make do with the old
+       * result for a while longer.
+       */
+      if (reactor_time < old->expires + old->ttl * 1000LL &&
+	  (old->refreshing || _ml_dbh_factory_is_busy (dbf)))
+	{
+	  nr_stale_hits++;
+	  use_entry (old);
+	  return old;
+	}
+
+      /* Keep hold of the old entry while we fetch the new result. */
+      old->refreshing = 1;
+      pin (old);
+      *oldp = old;
+    }
+
+  nr_misses++;
+  return 0;
+}
+
+struct fill_args
+{
+  ml_session session;
+  ml_dbh_factory dbf;
+  void *(*fill_fn) (pool, db_handle, void *);
+  pool pool;
+  void *data;
+  const void *result;
+  int generation;		/* Generation when the fetch started. */
+  db_handle dbh;		/* Handle shared by a batch. */
+};
+
+static void
+do_fill (void *vargs)
+{
+  struct fill_args *args = (struct fill_args *) vargs;
+  db_handle dbh;
+
+  dbh = ml_get_dbh_readonly (args->session, args->dbf);
+  args->result = args->fill_fn (args->pool, dbh, args->data);
+  ml_put_dbh (args->session, dbh);
+}
+
+/* Has any of the tags been invalidated since the generation? */
+static int
+invalidated_since (vector tags, int gen)
+{
+  const char *t;
+  int i, g;
+
+  for (i = 0; i < vector_size (tags); ++i)
+    {
+      vector_get (tags, i, t);
+      if (shash_get (tag_generations, t, g) && g > gen)
+	return 1;
+    }
+
+  return 0;
+}
+
+/* Put a newly fetched result into the cache, replacing any existing
+ * entry for the key. Returns the new entry (pinned). If the tables
+ * were changed while the result was being fetched, the result is
+ * returned to the caller but not cached.
+ */
+static struct entry *
+install (const char *key, int ttl, const char *tags, struct fill_args *args)
+{
+  struct entry *e, *old;
+  struct pool_stats pool_stats;
+
+  e = pmalloc (args->pool, sizeof *e);
+  e->pool = args->pool;
+  e->key = pstrdup (args->pool, key);
+  e->result = args->result;
+  e->ttl = ttl;
+  e->expires = reactor_time + ttl * 1000LL;
+  e->pins = 0;
+  e->dead = 0;
+  e->refreshing = 0;
+
+  if (tags)
+    e->tags = pstrcsplit (args->pool, tags, ' ');
+  else
+    e->tags = new_vector (args->pool, const char *);
+
+  if (invalidated_since (e->tags, args->generation))
+    {
+      /* Freed when the caller's request finishes. */
+      e->dead = 1;
+      pin (e);
+      return e;
+    }
+
+  pool_get_stats (e->pool, &pool_stats, sizeof (pool_stats));
+  e->size = pool_stats.struct_size;
+
+  /* We have to look the key up again, because fetching the result may
+   * have blocked.
+   */
+  if (shash_get (cache_index, key, old))
+    remove_entry (old);
+
+  if (nr_index_inserts > 4 * nr_entries + 64)
+    rebuild_index ();
+
+  shash_insert (cache_index, e->key, e);
+  nr_index_inserts++;
+  lru_push_front (e);
+  nr_entries++;
+  total_size += e->size;
+
+  evict ();
+
+  pin (e);
+  return e;
+}
+
+static inline void
+update_budget (ml_session session)
+{
+  budget = ml_cfg_get_int (session, "monolith query cache size",
+			   QUERY_CACHE_SIZE) * 1024LL;
+}
+
+static inline const char *
+make_key (ml_session session, ml_statement stmt, const char *params)
+{
+  return ml_scratch_sprintf (session, "%p\n%s\n%s",
+			     _ml_statement_get_factory (stmt),
+			     _ml_statement_get_query (stmt),
+			     params ? : "");
+}
+
+const void *
+ml_query_cache_get (ml_session session, ml_statement stmt,
+		    const char *params, int ttl, const char *tags,
+		    void *(*fill_fn) (pool, db_handle, void *), void *data)
+{
+  ml_dbh_factory dbf = _ml_statement_get_factory (stmt);
+  struct entry *e, *old;
+  struct fill_args args;
+  const char *key, *err;
+
+  update_budget (session);
+
+  key = make_key (session, stmt, params);
+
+  if ((e = lookup (dbf, key, &old)) != 0)
+    return e->result;
+
+  /* Fetch the result into a new entry. */
+  args.session = session;
+  args.dbf = dbf;
+  args.fill_fn = fill_fn;
+  args.pool = new_subpool (cache_pool);
+  args.data = data;
+  args.result = 0;
+  args.generation = generation;
+  args.dbh = 0;
+
+  err = pth_catch (do_fill, &args);
+  if (old) old->refreshing = 0;
+
+  if (err)
+    {
+      delete_pool (args.pool);
+      pth_die (err);
+    }
+
+  return install (key, ttl, tags, &args)->result;
+}
+
+/* A query in a batch. */
+struct query
+{
+  ml_query_batch batch;		/* Batch containing this query. */
+  const char *key;		/* Cache key. */
+  int ttl;			/* Time to live (seconds). */
+  const char *tags;		/* Tags. */
+  struct fill_args args;	/* Arguments for do_fill. */
+  struct entry *old;		/* Expired entry being refreshed, if any. */
+  const void *result;		/* Result, once the batch has run. */
+  const char *err;		/* Error from fill_fn, if any. */
+  int fill;			/* Set if the result must be fetched. */
+};
+
+struct ml_query_batch
+{
+  pool pool;			/* Pool for allocations. */
+  ml_session session;		/* Current session. */
+  vector queries;		/* Queries (vector of struct query *). */
+  int done;			/* Set once the batch has run. */
+};
+
+static int nr_batches, nr_batch_fills;
+
+ml_query_batch
+new_ml_query_batch (pool pool, ml_session session)
+{
+  ml_query_batch batch = pmalloc (pool, sizeof *batch);
+
+  batch->pool = pool;
+  batch->session = session;
+  batch->queries = new_vector (pool, struct query *);
+  batch->done = 0;
+
+  return batch;
+}
+
+int
+ml_query_batch_add (ml_query_batch batch, ml_statement stmt,
+		    const char *params, int ttl, const char *tags,
+		    void *(*fill_fn) (pool, db_handle, void *), void *data)
+{
+  struct query *q = pmalloc (batch->pool, sizeof *q);
+
+  /* Adding queries to a batch which has already run is a bug. */
+  assert (!batch->done);
+
+  q->batch = batch;
+  q->key = pstrdup (batch->pool, make_key (batch->session, stmt, params));
+  q->ttl = ttl;
+  q->tags = tags ? pstrdup (batch->pool, tags) : 0;
+  q->args.session = batch->session;
+  q->args.dbf = _ml_statement_get_factory (stmt);
+  q->args.fill_fn = fill_fn;
+  q->args.pool = 0;
+  q->args.data = data;
+  q->args.result = 0;
+  q->args.generation = 0;
+  q->args.dbh = 0;
+  q->old = 0;
+  q->result = 0;
+  q->err = 0;
+  q->fill = 0;
+
+  vector_push_back (batch->queries, q);
+  return vector_size (batch->queries) - 1;
+}
+
+static void
+do_borrow (void *vargs)
+{
+  struct fill_args *args = (struct fill_args *) vargs;
+
+  args->dbh = ml_get_dbh_readonly (args->session, args->dbf);
+}
+
+static void
+do_fill_shared (void *vargs)
+{
+  struct fill_args *args = (struct fill_args *) vargs;
+
+  args->result = args->fill_fn (args->pool, args->dbh, args->data);
+}
+
+/* Fetch the results for the queries in the batch which use factory
+ * dbf, one after another on a single handle. After an error the
+ * handle's transaction may be unusable, so it is given back and the
+ * remaining queries borrow a fresh one.
+ */
+static void
+fill_from (ml_query_batch batch, ml_dbh_factory dbf)
+{
+  struct query *q;
+  struct fill_args borrow;
+  db_handle dbh = 0;
+  int i;
+
+  borrow.session = batch->session;
+  borrow.dbf = dbf;
+
+  for (i = 0; i < vector_size (batch->queries); ++i)
+    {
+      vector_get (batch->queries, i, q);
+      if (!q->fill || q->args.dbf != dbf) continue;
+
+      if (!dbh)
+	{
+	  q->err = pth_catch (do_borrow, &borrow);
+	  if (q->err) continue;
+	  dbh = borrow.dbh;
+	}
+
+      q->args.dbh = dbh;
+      q->err = pth_catch (do_fill_shared, &q->args);
+      nr_batch_fills++;
+
+      if (q->err)
+	{
+	  ml_put_dbh (batch->session, dbh);
+	  dbh = 0;
+	}
+    }
+
+  if (dbh)
+    ml_put_dbh (batch->session, dbh);
+}
+
+void
+ml_query_batch_run (ml_query_batch batch)
+{
+  struct query *q, *q2;
+  struct entry *e;
+  const char *err = 0;
+  int i, j;
+
+  assert (!batch->done);
+  batch->done = 1;
+
+  update_budget (batch->session);
+
+  /* Answer what we can from the cache, and work out what needs to be
+   * fetched.
+   */
+  for (i = 0; i < vector_size (batch->queries); ++i)
+    {
+      vector_get (batch->queries, i, q);
+
+      if ((e = lookup (q->args.dbf, q->key, &q->old)) != 0)
+	q->result = e->result;
+      else
+	{
+	  q->fill = 1;
+	  q->args.pool = new_subpool (cache_pool);
+	  q->args.generation = generation;
+	}
+    }
+
+  nr_batches++;
+
+  /* Fetch the rest, borrowing one handle from each factory involved
+   * (usually there is only one).
+   */
+  for (i = 0; i < vector_size (batch->queries); ++i)
+    {
+      vector_get (batch->queries, i, q);
+      if (!q->fill) continue;
+
+      for (j = 0; j < i; ++j)
+	{
+	  vector_get (batch->queries, j, q2);
+	  if (q2->fill && q2->args.dbf == q->args.dbf) break;
+	}
+      if (j == i)
+	fill_from (batch, q->args.dbf);
+    }
+
+  /* Put the new results into the cache. */
+  for (i = 0; i < vector_size (batch->queries); ++i)
+    {
+      vector_get (batch->queries, i, q);
+      if (!q->fill) continue;
+
+      if (q->old) q->old->refreshing = 0;
+
+      if (q->err)
+	{
+	  delete_pool (q->args.pool);
+	  if (!err) err = q->err;
+	}
+      else
+	q->result = install (q->key, q->ttl, q->tags, &q->args)->result;
+    }
+
+  if (err) pth_die (err);
+}
+
+const void *
+ml_query_batch_get (ml_query_batch batch, int i)
+{
+  struct query *q;
+
+  assert (batch->done);
+
+  vector_get (batch->queries, i, q);
+  return q->result;
+}
+
+void
+ml_query_cache_invalidate (const char *tag)
+{
+  struct entry *e, *next;
+  const char *t;
+  int i;
+
+  generation++;
+  shash_insert (tag_generations, tag, generation);
+
+  for (e = lru_head; e; e = next)
+    {
+      next = e->next;
+
+      for (i = 0; i < vector_size (e->tags); ++i)
+	{
+	  vector_get (e->tags, i, t);
+	  if (strcmp (t, tag) == 0)
+	    {
+	      remove_entry (e);
+	      nr_invalidations++;
+	      break;
+	    }
+	}
+    }
+}
+
+int
+_ml_query_cache_get_nr_entries ()
+{
+  return nr_entries;
+}
+
+long long
+_ml_query_cache_get_size ()
+{
+  return total_size;
+}
+
+long long
+_ml_query_cache_get_budget ()
+{
+  return budget;
+}
+
+int
+_ml_query_cache_get_nr_hits ()
+{
+  return nr_hits;
+}
+
+int
+_ml_query_cache_get_nr_stale_hits ()
+{
+  return nr_stale_hits;
+}
+
+int
+_ml_query_cache_get_nr_misses ()
+{
+  return nr_misses;
+}
+
+int
+_ml_query_cache_get_nr_evictions ()
+{
+  return nr_evictions;
+}
+
+int
+_ml_query_cache_get_nr_invalidations ()
+{
+  return nr_invalidations;
+}
+
+int
+_ml_query_cache_get_nr_batches ()
+{
+  return nr_batches;
+}
+
+int
+_ml_query_cache_get_nr_batch_fills ()
+{
+  return nr_batch_fills;
+}
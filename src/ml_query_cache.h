@@ -0,0 +1,140 @@
+/* Monolith query result cache.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#ifndef ML_QUERY_CACHE_H
+#define ML_QUERY_CACHE_H
+
+#include <pool.h>
+#include <pthr_dbi.h>
+
+#include "monolith.h"
+
+struct ml_query_batch;
+typedef struct ml_query_batch *ml_query_batch;
+
+/* Function: ml_query_cache_get - shared cache of query results
+ * Function: ml_query_cache_invalidate
+ *
+ * Many widgets run the same queries over and over again, for every
+ * session and on every repaint, even though the results are the same
+ * for everyone and change rarely. The query cache lets all sessions
+ * share the results of such queries for a short while.
+ *
+ * @code{ml_query_cache_get} returns the cached result of running
+ * the registered statement @code{stmt} (see
+ * @ref{ml_register_statement(3)}) with the parameters @code{params}.
+ * @code{params} is a string which must uniquely describe the values
+ * of the parameters (for example, @code{pitoa (pool, userid)}), or
+ * @code{NULL} if the statement has no parameters. The cache is
+ * keyed on the statement's factory, the SQL text of the statement
+ * and @code{params}.
+ *
+ * If there is no cached result, or it is older than @code{ttl}
+ * seconds, then a read only database handle is borrowed from the
+ * statement's factory and @code{fill_fn (pool, dbh, data)} is
+ * called. This function should execute the statement (using
+ * @code{ml_prepare}), fetch the rows, and build whatever structure
+ * the caller wants from them, allocating everything (including copies
+ * of any strings) in @code{pool}. It returns a pointer to the
+ * structure, which is what @code{ml_query_cache_get} returns.
+ *
+ * The result is shared with other sessions, so callers must not
+ * modify it. It remains valid until the end of the current request.
+ *
+ * @code{tags} is a space-separated list of the tables which the
+ * query reads (eg. @code{"ml_bulletins ml_users"}).
+ * @code{ml_query_cache_invalidate} discards all cached results
+ * tagged with @code{tag}. Code which modifies a table should call
+ * this after committing the change. Results with the tag which were
+ * still being fetched at the time are returned to their callers, but
+ * are not cached, since they may have been read before the change.
+ *
+ * If a result has expired but every handle in the factory is in use,
+ * then rather than waiting for a handle, the expired result is
+ * returned (for up to another @code{ttl} seconds). Likewise, while
+ * one thread is refreshing a result, other threads are given the
+ * expired one instead of running the same query again.
+ *
+ * The total size of the cache is set by the @code{monolith query
+ * cache size} key in the configuration file (in kilobytes, default
+ * 1024). When the cache grows larger than this, the least recently
+ * used results are discarded.
+ *
+ * See also: @ref{ml_register_statement(3)}, @ref{ml_get_dbh(3)}.
+ */
+extern const void *ml_query_cache_get (ml_session session, ml_statement stmt, const char *params, int ttl, const char *tags, void *(*fill_fn) (pool, db_handle, void *), void *data);
+extern void ml_query_cache_invalidate (const char *tag);
+
+/* Function: new_ml_query_batch - fetch several cached queries at once
+ * Function: ml_query_batch_add
+ * Function: ml_query_batch_run
+ * Function: ml_query_batch_get
+ *
+ * A widget which needs the results of several queries can look them
+ * all up at once using a batch. The queries which aren't answered by
+ * the cache share one read only database handle, so the widget holds
+ * at most one connection (per factory) however many queries it makes.
+ * This is not pipelining: the queries still run one after another,
+ * each taking its own round trip to the server, just as they would
+ * with @code{ml_query_cache_get}.
+ *
+ * @code{new_ml_query_batch} creates an empty batch in @code{pool}.
+ * @code{ml_query_batch_add} adds a query to the batch. The arguments
+ * are the same as for @code{ml_query_cache_get}. It returns the
+ * index of the query in the batch (0, 1, 2, ...). @code{fill_fn}
+ * is not called yet, so @code{data} must still be valid when the
+ * batch is run.
+ *
+ * @code{ml_query_batch_run} looks up every query in the cache. Then
+ * it borrows a read only handle from each factory which has results
+ * to fetch, and calls the @code{fill_fn} of each of those queries in
+ * turn, in the order they were added. If any of them fail, the
+ * others are still cached (a failed query's handle is given back,
+ * and the following queries borrow another), and then the first
+ * error is rethrown with @code{pth_die}.
+ *
+ * @code{ml_query_batch_get} returns the result of the @code{i}th
+ * query, after the batch has run. The same rules apply to the result
+ * as for @code{ml_query_cache_get}.
+ *
+ * A batch borrows its handles itself, so, as with
+ * @code{ml_query_cache_get}, avoid running one while holding a handle
+ * from a factory with a small @code{monolith dbh max handles} limit.
+ *
+ * See also: @ref{ml_query_cache_get(3)}.
+ */
+extern ml_query_batch new_ml_query_batch (pool pool, ml_session session);
+extern int ml_query_batch_add (ml_query_batch, ml_statement stmt, const char *params, int ttl, const char *tags, void *(*fill_fn) (pool, db_handle, void *), void *data);
+extern void ml_query_batch_run (ml_query_batch);
+extern const void *ml_query_batch_get (ml_query_batch, int i);
+
+/* Private functions used by the stats app. */
+extern int _ml_query_cache_get_nr_entries (void);
+extern long long _ml_query_cache_get_size (void);
+extern long long _ml_query_cache_get_budget (void);
+extern int _ml_query_cache_get_nr_hits (void);
+extern int _ml_query_cache_get_nr_stale_hits (void);
+extern int _ml_query_cache_get_nr_misses (void);
+extern int _ml_query_cache_get_nr_evictions (void);
+extern int _ml_query_cache_get_nr_invalidations (void);
+extern int _ml_query_cache_get_nr_batches (void);
+extern int _ml_query_cache_get_nr_batch_fills (void);
+
+#endif /* ML_QUERY_CACHE_H */
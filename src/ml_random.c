@@ -0,0 +1,136 @@
+/* Monolith random numbers.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_SYS_RANDOM_H
+#include <sys/random.h>
+#endif
+
+#include <pool.h>
+
+#include "ml_random.h"
+
+/* Random bytes are read from the kernel in blocks of this size, so that
+ * creating a session costs a memcpy rather than several system calls.
+ * Bytes are only ever handed out once.
+ */
+#define BUFFER_SIZE 4096
+
+static unsigned char buffer[BUFFER_SIZE];
+static int avail = 0;		/* Bytes remaining at end of buffer. */
+
+#ifndef HAVE_GETRANDOM
+static int fd = -1;		/* /dev/urandom, kept open. */
+#endif
+
+static void
+refill (void)
+{
+  int n = 0, r;
+
+  while (n < BUFFER_SIZE)
+    {
+#ifdef HAVE_GETRANDOM
+      r = getrandom (buffer + n, BUFFER_SIZE - n, 0);
+#else
+      if (fd == -1)
+	{
+	  fd = open ("/dev/urandom", O_RDONLY);
+	  if (fd == -1) abort ();
+	  fcntl (fd, F_SETFD, FD_CLOEXEC);
+	}
+      r = read (fd, buffer + n, BUFFER_SIZE - n);
+#endif
+      if (r == -1 && errno == EINTR) continue;
+      if (r <= 0) abort ();
+      n += r;
+    }
+
+  avail = BUFFER_SIZE;
+}
+
+void
+ml_random_bytes (void *vp, int n)
+{
+  unsigned char *p = (unsigned char *) vp;
+  int i;
+
+  while (n > 0)
+    {
+      if (avail == 0) refill ();
+
+      i = n < avail ? n : avail;
+      memcpy (p, buffer + BUFFER_SIZE - avail, i);
+
+      /* Don't leave the bytes we handed out lying around. */
+      memset (buffer + BUFFER_SIZE - avail, 0, i);
+
+      avail -= i;
+      p += i;
+      n -= i;
+    }
+}
+
+static const char hex_digits[] = "0123456789abcdef";
+
+const char *
+ml_random_token (pool pool)
+{
+  char *token = pmalloc (pool, 33 * sizeof (char));
+
+  ml_random_token_r (token);
+  return token;
+}
+
+void
+ml_random_token_r (char *token)
+{
+  unsigned char r[16];
+  int i;
+
+  ml_random_bytes (r, 16);
+
+  for (i = 0; i < 16; ++i)
+    {
+      token[i*2] = hex_digits[r[i] >> 4];
+      token[i*2+1] = hex_digits[r[i] & 15];
+    }
+  token[32] = '\0';
+}
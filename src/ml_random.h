@@ -0,0 +1,48 @@
+/* Monolith random numbers.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#ifndef ML_RANDOM_H
+#define ML_RANDOM_H
+
+#include <pool.h>
+
+/* Function: ml_random_bytes - cryptographically strong random numbers
+ * Function: ml_random_token
+ * Function: ml_random_token_r
+ *
+ * @code{ml_random_bytes} fills @code{buffer} with @code{n} bytes
+ * from the kernel's random number generator. Bytes are read from the
+ * kernel in large blocks and handed out from a buffer, so calling this
+ * is cheap. If random numbers cannot be read, the program aborts.
+ *
+ * @code{ml_random_token} returns a fresh 128 bit random number,
+ * allocated in @code{pool} and encoded as a string of 32 lowercase
+ * hex digits. This is used for session IDs, authentication cookies
+ * and other secrets.
+ *
+ * @code{ml_random_token_r} is the same, but writes the token into
+ * @code{buffer}, which must have room for 33 characters (including
+ * the trailing ASCII NUL).
+ */
+extern void ml_random_bytes (void *buffer, int n);
+extern const char *ml_random_token (pool);
+extern void ml_random_token_r (char *buffer);
+
+#endif /* ML_RANDOM_H */
@@ -36,7 +36,7 @@
 #include "ml_smarttext.h"
 #include "ml_select_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations select_layout_ops =
@@ -230,7 +230,7 @@ ml_select_layout_get_selection (ml_select_layout w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_select_layout w = (ml_select_layout) vw;
   int i;
@@ -243,44 +243,44 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
     w->selected = vector_size (w->tabs) - 1;
 
   /* Begin the table. */
-  io_fprintf (io, "<table class=\"%s\"><tr><td valign=\"top\">", clazz);
+  ml_output_printf (io, "<table class=\"%s\"><tr><td valign=\"top\">", clazz);
 
   /* Left hand column. */
   if (w->top) ml_widget_repaint (w->top, session, windowid, io);
 
-  io_fputs ("<table class=\"ml_select_layout_left\">", io);
+  ml_output_puts_static (io, "<table class=\"ml_select_layout_left\">");
 
   for (i = 0; i < vector_size (w->tabs); ++i)
     {
       vector_get_ptr (w->tabs, i, tab);
 
-      io_fputs ("<tr>", io);
-      if (i == w->selected) io_fputs ("<th>", io);
-      else io_fputs ("<td>", io);
+      ml_output_puts_static (io, "<tr>");
+      if (i == w->selected) ml_output_puts_static (io, "<th>");
+      else ml_output_puts_static (io, "<td>");
 
-      io_fprintf (io, "<a href=\"%s?ml_action=%s&ml_window=%s\">",
-		  ml_session_script_name (w->session),
-		  tab->action_id, windowid);
+      ml_output_printf (io, "<a href=\"%s?ml_action=%s&ml_window=%s\">",
+			ml_session_script_name (w->session),
+			tab->action_id, windowid);
       ml_plaintext_print (io, tab->name);
-      io_fputs ("</a>", io);
+      ml_output_puts_static (io, "</a>");
 
-      if (i == w->selected) io_fputs ("</th>", io);
-      else io_fputs ("</td>", io);
-      io_fputs ("</tr>\n", io);
+      if (i == w->selected) ml_output_puts_static (io, "</th>");
+      else ml_output_puts_static (io, "</td>");
+      ml_output_puts_static (io, "</tr>\n");
     }
 
-  io_fputs ("</table>", io);
+  ml_output_puts_static (io, "</table>");
 
   if (w->bottom) ml_widget_repaint (w->bottom, session, windowid, io);
 
-  io_fputs ("</td>\n<td valign=\"top\">", io);
+  ml_output_puts_static (io, "</td>\n<td valign=\"top\">");
 
   /* Right hand column: the widget. */
   vector_get_ptr (w->tabs, w->selected, tab);
 
   if (tab->w) ml_widget_repaint (tab->w, session, windowid, io);
 
-  io_fputs ("</td></tr></table>", io);
+  ml_output_puts_static (io, "</td></tr></table>");
 }
 
 static void do_select (ml_session session, void *vargs);
@@ -298,7 +298,7 @@ make_action (ml_select_layout w, struct tab *tab)
 
   args->w = w;
   args->action_id = tab->action_id =
-    ml_register_action (w->session, do_select, args);
+    ml_register_action_in_pool (w->session, w->pool, do_select, args);
 }
 
 static void
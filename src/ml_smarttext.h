@@ -21,9 +21,8 @@
 #ifndef ML_SMARTTEXT_H
 #define ML_SMARTTEXT_H
 
-#include <pthr_iolib.h>
-
 #include "monolith.h"
+#include "ml_output.h"
 
 /* Function: ml_plaintext_print - convert text to HTML
  * Function: ml_plaintext_to_html
@@ -65,21 +64,21 @@
  * - @code{1/4}, @code{1/2}, @code{3/4} are marked up as fractions.
  *
  * @code{ml_plaintext_print} converts a string @code{text} containing
- * just plain text to HTML and writes it directly to @code{io}.
+ * just plain text to HTML and writes it to the output buffer @code{io}.
  *
  * @code{ml_plaintext_to_html} converts a string @code{text} containing
  * just plain text to HTML and returns this as a new string allocated
  * in @code{pool}.
  *
  * @code{ml_smarttext_print} converts a string @code{text} containing
- * smart text to HTML and writes it directly to @code{io}.
+ * smart text to HTML and writes it to the output buffer @code{io}.
  *
  * @code{ml_smarttext_to_html} converts a string @code{text} containing
  * smart text to HTML and returns this as a new string allocated
  * in @code{pool}.
  *
  * @code{ml_filterhtml_print} converts a string @code{text} containing
- * filtered HTML to HTML and writes it directly to @code{io}.
+ * filtered HTML to HTML and writes it to the output buffer @code{io}.
  *
  * @code{ml_filterhtml_to_html} converts a string @code{text} containing
  * filtered HTML to HTML and returns this as a new string allocated
@@ -90,13 +89,13 @@
  * value passed in the @code{type} argument, which must be one of
  * @code{'p'}, @code{'s'} or @code{'h'}.
  */
-extern void ml_plaintext_print (io_handle io, const char *text);
+extern void ml_plaintext_print (ml_output io, const char *text);
 extern const char *ml_plaintext_to_html (pool, const char *text);
-extern void ml_smarttext_print (io_handle io, const char *text);
+extern void ml_smarttext_print (ml_output io, const char *text);
 extern const char *ml_smarttext_to_html (pool, const char *text);
-extern void ml_filterhtml_print (io_handle io, const char *text);
+extern void ml_filterhtml_print (ml_output io, const char *text);
 extern const char *ml_filterhtml_to_html (pool, const char *text);
-extern void ml_anytext_print (io_handle io, const char *text, char type);
+extern void ml_anytext_print (ml_output io, const char *text, char type);
 extern const char *ml_anytext_to_html (pool, const char *text, char type);
 
 #endif /* ML_SMARTTEXT_H */
@@ -31,7 +31,7 @@
 #include "monolith.h"
 #include "ml_tabbed_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations tabbed_layout_ops =
   {
@@ -282,7 +282,7 @@ verify_structures (ml_tabbed_layout w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_tabbed_layout w = (ml_tabbed_layout) vw;
   int i;
@@ -30,13 +30,14 @@
 #include "monolith.h"
 #include "ml_table_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations table_layout_ops =
   {
     repaint: repaint,
-    properties: properties
+    properties: properties,
+    name: "ml_table_layout"
   };
 
 struct cell
@@ -111,12 +112,15 @@ new_ml_table_layout (pool pool, int rows, int cols)
 	init_cell (w, r, c);
     }
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_table_layout_pack (ml_table_layout w, ml_widget _w, int row, int col)
 {
+  ml_widget_invalidate (w);
   get_cell (w, row, col)->w = _w;
 }
 
@@ -125,6 +129,7 @@ ml_table_layout_add_row (ml_table_layout w)
 {
   int c;
 
+  ml_widget_invalidate (w);
   w->cells = prealloc (w->pool,
 		       w->cells, sizeof (struct cell *) * (w->rows+1));
   w->cells[w->rows] = pmalloc (w->pool, sizeof (struct cell) * w->cols);
@@ -138,6 +143,7 @@ ml_table_layout_add_row (ml_table_layout w)
 void
 ml_table_layout_set_colspan (ml_table_layout w, int row, int col, int colspan)
 {
+  ml_widget_invalidate (w);
   assert (colspan > 0);
   assert (col + colspan <= w->cols);
   get_cell (w, row, col)->colspan = colspan;
@@ -146,6 +152,7 @@ ml_table_layout_set_colspan (ml_table_layout w, int row, int col, int colspan)
 void
 ml_table_layout_set_rowspan (ml_table_layout w, int row, int col, int rowspan)
 {
+  ml_widget_invalidate (w);
   assert (rowspan > 0);
   assert (row + rowspan <= w->rows);
   get_cell (w, row, col)->rowspan = rowspan;
@@ -155,6 +162,7 @@ void
 ml_table_layout_set_align (ml_table_layout w, int row, int col,
 			   const char *align)
 {
+  ml_widget_invalidate (w);
   get_cell (w, row, col)->align = align[0];
 }
 
@@ -162,6 +170,7 @@ void
 ml_table_layout_set_valign (ml_table_layout w, int row, int col,
 			    const char *valign)
 {
+  ml_widget_invalidate (w);
   get_cell (w, row, col)->valign = valign[0];
 }
 
@@ -169,6 +178,7 @@ void
 ml_table_layout_set_class (ml_table_layout w, int row, int col,
 			   const char *clazz)
 {
+  ml_widget_invalidate (w);
   get_cell (w, row, col)->clazz = clazz;
 }
 
@@ -176,6 +186,8 @@ void
 ml_table_layout_set_header (ml_table_layout w, int row, int col,
 			    int is_header)
 {
+  ml_widget_invalidate (w);
+
   if (is_header)
     get_cell (w, row, col)->flags |= CELL_FLAGS_IS_HEADER;
   else
@@ -183,7 +195,7 @@ ml_table_layout_set_header (ml_table_layout w, int row, int col,
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_table_layout w = (ml_table_layout) vw;
   int r, c;
@@ -194,14 +206,14 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
       get_cell (w, r, c)->flags &= ~CELL_FLAGS_NO_PAINT;
 
   /* Start of the table. */
-  io_fputs ("<table", io);
-  if (w->clazz) io_fprintf (io, " class=\"%s\"", w->clazz);
-  io_fputs (">", io);
+  ml_output_puts_static (io, "<table");
+  if (w->clazz) ml_output_printf (io, " class=\"%s\"", w->clazz);
+  ml_output_puts_static (io, ">");
 
   /* Paint the cells. */
   for (r = 0; r < w->rows; ++r)
     {
-      io_fprintf (io, "<tr>");
+      ml_output_puts_static (io, "<tr>");
 
       for (c = 0; c < w->cols; ++c)
 	{
@@ -219,37 +231,37 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
 		  get_cell (w, r+i, c+j)->flags |= CELL_FLAGS_NO_PAINT;
 
 	      if (!(cl->flags & CELL_FLAGS_IS_HEADER))
-		io_fprintf (io, "<td");
+		ml_output_puts_static (io, "<td");
 	      else
-		io_fprintf (io, "<th");
+		ml_output_puts_static (io, "<th");
 	      if (cl->clazz)
-		io_fprintf (io, " class=\"%s\"", cl->clazz);
+		ml_output_printf (io, " class=\"%s\"", cl->clazz);
 	      if (cl->rowspan > 1)
-		io_fprintf (io, " rowspan=\"%d\"", cl->rowspan);
+		ml_output_printf (io, " rowspan=\"%d\"", cl->rowspan);
 	      if (cl->colspan > 1)
-		io_fprintf (io, " colspan=\"%d\"", cl->colspan);
+		ml_output_printf (io, " colspan=\"%d\"", cl->colspan);
 	      if (cl->align == 'r')
-		io_fprintf (io, " align=\"right\"");
+		ml_output_puts_static (io, " align=\"right\"");
 	      else if (cl->align == 'c')
-		io_fprintf (io, " align=\"center\"");
+		ml_output_puts_static (io, " align=\"center\"");
 	      if (cl->valign == 't')
-		io_fprintf (io, " valign=\"top\"");
+		ml_output_puts_static (io, " valign=\"top\"");
 	      else if (cl->valign == 'b')
-		io_fprintf (io, " valign=\"bottom\"");
-	      io_fprintf (io, ">");
+		ml_output_puts_static (io, " valign=\"bottom\"");
+	      ml_output_puts_static (io, ">");
 	      if (cl->w)
 		ml_widget_repaint (cl->w, session, windowid, io);
 	      else
-		io_fprintf (io, "&nbsp;");
+		ml_output_puts_static (io, "&nbsp;");
 	      if (!(cl->flags & CELL_FLAGS_IS_HEADER))
-		io_fprintf (io, "</td>\n");
+		ml_output_puts_static (io, "</td>\n");
 	      else
-		io_fprintf (io, "</th>\n");
+		ml_output_puts_static (io, "</th>\n");
 	    }
 	}
 
-      io_fprintf (io, "</tr>\n");
+      ml_output_puts_static (io, "</tr>\n");
     }
 
-  io_fprintf (io, "</table>");
+  ml_output_puts_static (io, "</table>");
 }
@@ -31,13 +31,14 @@
 #include "ml_smarttext.h"
 #include "ml_text_label.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations text_label_ops =
   {
     repaint: repaint,
     properties: properties,
+    name: "ml_text_label",
   };
 
 struct ml_text_label
@@ -87,11 +88,13 @@ new_ml_text_label (pool pool, const char *text)
   w->font_weight = 0;
   w->font_size = 0;
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_text_label w = (ml_text_label) vw;
 
@@ -99,23 +102,23 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
     {
       if (w->text_align || w->colour || w->font_weight || w->font_size)
 	{
-	  io_fprintf (io, "<span style=\"");
+	  ml_output_puts_static (io, "<span style=\"");
 	  if (w->text_align)
-	    io_fprintf (io, "text-align: %s;", w->text_align);
+	    ml_output_printf (io, "text-align: %s;", w->text_align);
 	  if (w->colour)
-	    io_fprintf (io, "color: %s;", w->colour);
+	    ml_output_printf (io, "color: %s;", w->colour);
 	  if (w->font_weight)
-	    io_fprintf (io, "font-weight: %s;", w->font_weight);
+	    ml_output_printf (io, "font-weight: %s;", w->font_weight);
 	  if (w->font_size)
-	    io_fprintf (io, "font-size: %s;", w->font_size);
-	  io_fprintf (io, "\">");
+	    ml_output_printf (io, "font-size: %s;", w->font_size);
+	  ml_output_puts_static (io, "\">");
 	}
 
       ml_plaintext_print (io, w->text);
 
       if (w->text_align || w->colour || w->font_weight || w->font_size)
 	{
-	  io_fprintf (io, "</span>");
+	  ml_output_puts_static (io, "</span>");
 	}
     }
 }
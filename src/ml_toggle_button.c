@@ -28,7 +28,7 @@
 #include "ml_widget.h"
 #include "ml_toggle_button.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations toggle_button_ops =
@@ -76,7 +76,7 @@ new_ml_toggle_button (pool pool, ml_session session, const char *text)
   w->data = 0;
 
   /* Register the action for this toggle button. */
-  w->action_id = ml_register_action (session, toggle_me, w);
+  w->action_id = ml_register_action_in_pool (session, pool, toggle_me, w);
 
   return w;
 }
@@ -115,10 +115,9 @@ ml_toggle_button_get_state (ml_toggle_button w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_toggle_button w = (ml_toggle_button) vw;
-  pool pool = ml_session_pool (session);
 
   if (w->text)
     {
@@ -139,12 +138,12 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
 	    clazz = "ml_toggle_button_key_pressed";
 	}
 
-      link = psprintf (pool, "%s?ml_action=%s&ml_window=%s",
-		       ml_session_script_name (session),
-		       w->action_id,
-		       windowid);
+      link = ml_scratch_sprintf (session, "%s?ml_action=%s&ml_window=%s",
+				 ml_session_script_name (session),
+				 w->action_id,
+				 windowid);
 
-      io_fprintf (io, "<a class=\"%s\" href=\"%s\">%s</a>",
-		  clazz, link, w->text);
+      ml_output_printf (io, "<a class=\"%s\" href=\"%s\">%s</a>",
+			clazz, link, w->text);
     }
 }
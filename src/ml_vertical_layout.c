@@ -26,13 +26,14 @@
 #include "monolith.h"
 #include "ml_vertical_layout.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 static struct ml_widget_property properties[];
 
 struct ml_widget_operations vertical_layout_ops =
   {
     repaint: repaint,
-    properties: properties
+    properties: properties,
+    name: "ml_vertical_layout"
   };
 
 struct ml_vertical_layout
@@ -61,18 +62,22 @@ new_ml_vertical_layout (pool pool)
   w->clazz = 0;
   w->v = new_vector (pool, ml_widget);
 
+  ml_widget_enable_cache (w, pool);
+
   return w;
 }
 
 void
 ml_vertical_layout_push_back (ml_vertical_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->v, _w);
 }
 
 void
 ml_vertical_layout_pack (ml_vertical_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_back (w->v, _w);
 }
 
@@ -81,6 +86,7 @@ ml_vertical_layout_pop_back (ml_vertical_layout w)
 {
   ml_widget _w;
 
+  ml_widget_invalidate (w);
   vector_pop_back (w->v, _w);
   return _w;
 }
@@ -88,6 +94,7 @@ ml_vertical_layout_pop_back (ml_vertical_layout w)
 void
 ml_vertical_layout_push_front (ml_vertical_layout w, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_push_front (w->v, _w);
 }
 
@@ -96,6 +103,7 @@ ml_vertical_layout_pop_front (ml_vertical_layout w)
 {
   ml_widget _w;
 
+  ml_widget_invalidate (w);
   vector_pop_front (w->v, _w);
   return _w;
 }
@@ -112,24 +120,28 @@ ml_vertical_layout_get (ml_vertical_layout w, int i)
 void
 ml_vertical_layout_insert (ml_vertical_layout w, int i, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_insert (w->v, i, _w);
 }
 
 void
 ml_vertical_layout_replace (ml_vertical_layout w, int i, ml_widget _w)
 {
+  ml_widget_invalidate (w);
   vector_replace (w->v, i, _w);
 }
 
 void
 ml_vertical_layout_erase (ml_vertical_layout w, int i)
 {
+  ml_widget_invalidate (w);
   vector_erase (w->v, i);
 }
 
 void
 ml_vertical_layout_clear (ml_vertical_layout w)
 {
+  ml_widget_invalidate (w);
   vector_clear (w->v);
 }
 
@@ -140,7 +152,7 @@ ml_vertical_layout_size (ml_vertical_layout w)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_vertical_layout w = (ml_vertical_layout) vw;
   int i;
@@ -150,10 +162,10 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
       ml_widget _w;
 
       vector_get (w->v, i, _w);
-      io_fputs ("<div", io);
-      if (w->clazz) io_fprintf (io, " class=\"%s\"", w->clazz);
-      io_fputc ('>', io);
+      ml_output_puts_static (io, "<div");
+      if (w->clazz) ml_output_printf (io, " class=\"%s\"", w->clazz);
+      ml_output_putc (io, '>');
       ml_widget_repaint (_w, session, windowid, io);
-      io_fputs ("</div>\n", io);
+      ml_output_puts_static (io, "</div>\n");
     }
 }
@@ -31,8 +31,13 @@
 #include <string.h>
 #endif
 
+#include <pool.h>
+#include <vector.h>
+#include <pstring.h>
+
 #include "monolith.h"
 #include "ml_widget.h"
+#include "session_table.h"
 
 /* This is what generic widget objects *actually* look like. */
 struct widget
@@ -40,13 +45,308 @@ struct widget
   struct ml_widget_operations *ops;
 };
 
+/* The fragment cache. Each cacheable widget has an entry in a table
+ * keyed on the address of the widget. The entry is allocated in the
+ * widget's pool, and a cleanup function removes it from the table when
+ * the pool is deleted, so a new widget which happens to get the same
+ * address never finds an old widget's HTML.
+ *
+ * The cached HTML, and the list of widgets which this one was painted
+ * inside, live in a subpool which is simply deleted to invalidate the
+ * widget.
+ */
+struct fragment
+{
+  const char *windowid;		/* Window this copy was painted for. */
+  const char *data;		/* The HTML. */
+  int len;
+};
+
+struct type_stats
+{
+  const struct ml_widget_operations *ops;
+  int hits;			/* Written from the cache. */
+  int misses;			/* Painted, then cached. */
+  int uncached;			/* Painted, but couldn't be cached. */
+};
+
+struct widget_cache
+{
+  struct widget *w;		/* The widget. */
+  struct type_stats *stats;	/* Statistics for this type of widget. */
+  pool pool;			/* Widget's pool. */
+  pool fpool;			/* Cached copies (0 = nothing cached). */
+  vector fragments;		/* List of struct fragment. */
+  vector parents;		/* Widgets this one was painted inside. */
+  int size;			/* Total bytes in fragments. */
+  int generation;		/* Incremented when invalidated. */
+};
+
+/* While a cacheable widget is being painted, one of these sits on the
+ * stack, and the output buffer points to it. The captures for the
+ * widgets being painted form a list, innermost first.
+ */
+struct capture
+{
+  struct capture *outer;	/* Capture for the enclosing widget. */
+  struct widget_cache *cache;	/* Widget being painted. */
+  int start;			/* Where its HTML starts in the buffer. */
+  int generation;		/* cache->generation when we started. */
+  int uncacheable;		/* Contains an uncacheable widget. */
+};
+
+static session_table caches = 0; /* Widget address -> struct widget_cache. */
+static vector all_stats = 0;	/* List of struct type_stats *. */
+static long long cache_size = 0; /* Total bytes in all fragments. */
+
+static inline void
+make_key (const void *vw, struct session_key *key)
+{
+  key->hi = (unsigned long) vw;
+  key->lo = 0;
+}
+
+static inline struct widget_cache *
+get_cache (const void *vw)
+{
+  struct session_key key;
+
+  if (!caches) return 0;
+  make_key (vw, &key);
+  return session_table_get (caches, &key);
+}
+
+static struct type_stats *
+get_stats (const struct ml_widget_operations *ops)
+{
+  struct type_stats *stats;
+  int i;
+
+  for (i = 0; i < vector_size (all_stats); ++i)
+    {
+      vector_get (all_stats, i, stats);
+      if (stats->ops == ops) return stats;
+    }
+
+  stats = pmalloc (global_pool, sizeof *stats);
+  stats->ops = ops;
+  stats->hits = stats->misses = stats->uncached = 0;
+  vector_push_back (all_stats, stats);
+  return stats;
+}
+
+static void
+remove_cache (void *vcache)
+{
+  struct widget_cache *cache = (struct widget_cache *) vcache;
+  struct session_key key;
+
+  /* The cached copies go with the widget's pool. */
+  cache_size -= cache->size;
+
+  make_key (cache->w, &key);
+  session_table_erase (caches, &key);
+}
+
+void
+ml_widget_enable_cache (void *vw, pool pool)
+{
+  struct widget *w = (struct widget *) vw;
+  struct widget_cache *cache = pmalloc (pool, sizeof *cache);
+  struct session_key key;
+
+  if (!caches)
+    {
+      caches = new_session_table (global_pool);
+      all_stats = new_vector (global_pool, struct type_stats *);
+    }
+
+  cache->w = w;
+  cache->stats = get_stats (w->ops);
+  cache->pool = pool;
+  cache->fpool = 0;
+  cache->size = 0;
+  cache->generation = 0;
+
+  make_key (w, &key);
+  session_table_insert (caches, &key, cache);
+  pool_register_cleanup_fn (pool, remove_cache, cache);
+}
+
+static void
+invalidate (struct widget_cache *cache)
+{
+  struct widget_cache *parent;
+  struct widget *pw;
+  vector parents;
+  pool fpool;
+  int i;
+
+  cache->generation++;
+
+  /* If there's nothing cached then the widgets we were painted inside
+   * have been invalidated already.
+   */
+  if (!cache->fpool) return;
+
+  fpool = cache->fpool;
+  parents = cache->parents;
+  cache->fpool = 0;
+  cache_size -= cache->size;
+  cache->size = 0;
+
+  for (i = 0; i < vector_size (parents); ++i)
+    {
+      vector_get (parents, i, pw);
+      if ((parent = get_cache (pw)) != 0)
+	invalidate (parent);
+    }
+
+  delete_pool (fpool);
+}
+
+void
+ml_widget_invalidate (void *vw)
+{
+  struct widget_cache *cache = get_cache (vw);
+
+  if (cache) invalidate (cache);
+}
+
+static const struct fragment *
+find_fragment (struct widget_cache *cache, const char *windowid)
+{
+  const struct fragment *f;
+  int i;
+
+  if (!cache->fpool) return 0;
+
+  for (i = 0; i < vector_size (cache->fragments); ++i)
+    {
+      vector_get_ptr (cache->fragments, i, f);
+      if (strcmp (f->windowid, windowid) == 0) return f;
+    }
+
+  return 0;
+}
+
+static void
+add_fragment (struct widget_cache *cache, const char *windowid,
+	      ml_output io, int start)
+{
+  struct fragment f;
+  char *data;
+
+  if (!cache->fpool)
+    {
+      cache->fpool = new_subpool (cache->pool);
+      cache->fragments = new_vector (cache->fpool, struct fragment);
+      cache->parents = new_vector (cache->fpool, struct widget *);
+    }
+
+  f.len = ml_output_size (io) - start;
+  data = pmalloc (cache->fpool, f.len);
+  ml_output_copy (io, start, data);
+  f.data = data;
+  f.windowid = pstrdup (cache->fpool, windowid);
+  vector_push_back (cache->fragments, f);
+
+  cache->size += f.len;
+  cache_size += f.len;
+}
+
+/* Remember that the widget was painted inside the widget being
+ * captured by outer, so that invalidating it invalidates outer too.
+ */
+static void
+add_parent (struct widget_cache *cache, struct capture *outer)
+{
+  struct widget *pw;
+  int i;
+
+  if (!outer) return;
+
+  for (i = 0; i < vector_size (cache->parents); ++i)
+    {
+      vector_get (cache->parents, i, pw);
+      if (pw == outer->cache->w) return;
+    }
+
+  vector_push_back (cache->parents, outer->cache->w);
+}
+
+/* The widgets being painted can't be cached, since they contain a
+ * widget which isn't.
+ */
+static inline void
+poison (struct capture *c)
+{
+  for (; c; c = c->outer)
+    c->uncacheable = 1;
+}
+
 void
 ml_widget_repaint (void *vw, ml_session session, const char *windowid,
-		   io_handle io)
+		   ml_output io)
 {
   struct widget *w = (struct widget *) vw;
+  struct widget_cache *cache;
+  const struct fragment *f;
+  struct capture *outer, c;
+
+  /* Don't carry on painting for a browser which has gone away. */
+  ml_session_check_request (session);
+
+  if (!w->ops->repaint) return;
+
+  outer = _ml_output_get_capture (io);
 
-  if (w->ops->repaint) w->ops->repaint (vw, session, windowid, io);
+  if ((cache = get_cache (w)) == 0)
+    {
+      poison (outer);
+      w->ops->repaint (vw, session, windowid, io);
+      return;
+    }
+
+  /* Write out the cached copy. This must be copied into the buffer,
+   * because the page is sent after the session is unlocked, and by
+   * then another request may have invalidated the widget.
+   */
+  if ((f = find_fragment (cache, windowid)) != 0)
+    {
+      ml_output_write (io, f->data, f->len);
+      add_parent (cache, outer);
+      cache->stats->hits++;
+      return;
+    }
+
+  /* Paint it and keep a copy. If the repaint function dies, the
+   * buffer is thrown away along with the request, so it doesn't
+   * matter that it is left pointing at this stack frame.
+   */
+  c.outer = outer;
+  c.cache = cache;
+  c.start = ml_output_size (io);
+  c.generation = cache->generation;
+  c.uncacheable = 0;
+
+  _ml_output_set_capture (io, &c);
+  w->ops->repaint (vw, session, windowid, io);
+  _ml_output_set_capture (io, outer);
+
+  /* Don't cache it if the widget changed while it was being painted. */
+  if (c.uncacheable || c.generation != cache->generation)
+    {
+      poison (outer);
+      cache->stats->uncached++;
+      return;
+    }
+
+  /* Another thread may have painted the same window meanwhile. */
+  if (!find_fragment (cache, windowid))
+    add_fragment (cache, windowid, io, c.start);
+  add_parent (cache, outer);
+  cache->stats->misses++;
 }
 
 const struct ml_widget_property *
@@ -113,6 +413,8 @@ ml_widget_set_property (void *vw, const char *property_name, ...)
 
 	  if (properties->on_set) properties->on_set (vw);
 
+	  ml_widget_invalidate (vw);
+
 	  return;
 	}
 
@@ -180,3 +482,49 @@ _ml_widget_get_property (void *vw, const char *property_name, void *varptr)
 	   property_name);
   abort ();
 }
+
+int
+_ml_widget_get_nr_cached ()
+{
+  return caches ? session_table_size (caches) : 0;
+}
+
+long long
+_ml_widget_get_cache_size ()
+{
+  return cache_size;
+}
+
+vector
+_ml_widget_get_cache_types (pool pool)
+{
+  vector v = new_vector (pool, const struct ml_widget_operations *);
+  struct type_stats *stats;
+  int i;
+
+  for (i = 0; all_stats && i < vector_size (all_stats); ++i)
+    {
+      vector_get (all_stats, i, stats);
+      vector_push_back (v, stats->ops);
+    }
+
+  return v;
+}
+
+int
+_ml_widget_get_nr_cache_hits (const struct ml_widget_operations *ops)
+{
+  return get_stats (ops)->hits;
+}
+
+int
+_ml_widget_get_nr_cache_misses (const struct ml_widget_operations *ops)
+{
+  return get_stats (ops)->misses;
+}
+
+int
+_ml_widget_get_nr_cache_uncached (const struct ml_widget_operations *ops)
+{
+  return get_stats (ops)->uncached;
+}
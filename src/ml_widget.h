@@ -23,7 +23,10 @@
 
 #include <stdarg.h>
 
-#include <pthr_iolib.h>
+#include <pool.h>
+#include <vector.h>
+
+#include <ml_output.h>
 
 struct ml_session;
 
@@ -58,10 +61,15 @@ struct ml_widget_operations
 {
   /* All widgets must have a repaint function. */
   void (*repaint) (void *widget, struct ml_session *session,
-		   const char *windowid, io_handle io);
+		   const char *windowid, ml_output io);
 
   /* List of properties (NULL = no properties). */
   struct ml_widget_property *properties;
+
+  /* Name of the widget type, used in statistics. Only widgets which
+   * call ml_widget_enable_cache need to set this.
+   */
+  const char *name;
 };
 
 /* Function: ml_widget_repaint - Operations on generic monolith widgets.
@@ -71,7 +79,11 @@ struct ml_widget_operations
  * Function: _ml_widget_get_property
  *
  * @code{ml_widget_repaint} calls the repaint function on a generic
- * widget.
+ * widget. Repaint functions write the widget's HTML into the output
+ * buffer @code{io} (see @ref{new_ml_output(3)}). If the widget has
+ * been painted before and has not changed since, the HTML may be
+ * written out from the fragment cache instead (see
+ * @ref{ml_widget_enable_cache(3)}).
  *
  * The @code{*property} functions are concerned with widget properties.
  * Properties are generic attributes of a widget which can be read and
@@ -124,10 +136,57 @@ struct ml_widget_operations
  * title or "tooltip".
  *
  */
-extern void ml_widget_repaint (ml_widget widget, struct ml_session *, const char *windowid, io_handle);
+extern void ml_widget_repaint (ml_widget widget, struct ml_session *, const char *windowid, ml_output);
 extern const struct ml_widget_property *ml_widget_get_properties (ml_widget widget);
 extern void ml_widget_set_property (ml_widget widget, const char *property_name, ...);
 #define ml_widget_get_property(widget,property_name,var) (_ml_widget_get_property ((widget), (property_name), &(var)))
 extern void _ml_widget_get_property (ml_widget widget, const char *property_name, void *varptr);
 
+/* Function: ml_widget_enable_cache - cache the HTML of unchanged widgets
+ * Function: ml_widget_invalidate
+ *
+ * Most actions change only a small part of a window, but the whole
+ * window is repainted afterwards. Widgets which opt in to the
+ * fragment cache are only painted once: @code{ml_widget_repaint}
+ * keeps a copy of the HTML which the widget wrote (one copy for each
+ * window it appears in), and the next time the widget is repainted,
+ * the copy is written out instead.
+ *
+ * A widget's constructor calls @code{ml_widget_enable_cache} to opt
+ * in. @code{pool} must be the pool which the widget was allocated in,
+ * so that the cached copy is thrown away along with the widget. Only
+ * widgets whose HTML depends on nothing but the widget's own state
+ * (and the state of the widgets inside it) may do this. Widgets which
+ * print anything else, such as the current time, the results of a
+ * database query, or a freshly registered action, must not.
+ *
+ * @code{ml_widget_invalidate} throws away the cached copies of a
+ * widget, and of every widget it was painted inside, so that they
+ * are all painted again next time. @code{ml_widget_set_property}
+ * calls this, as do all of the functions in the monolith library which
+ * change a cacheable widget, such as @code{ml_vertical_layout_pack}
+ * and @code{ml_form_input_set_value}. A widget which changes its own
+ * state in any other way, or an application which changes the
+ * contents of a widget behind the library's back (for example, by
+ * modifying a string which was passed to @code{new_ml_text_label}),
+ * must call @code{ml_widget_invalidate} itself. It is safe to call it
+ * on any widget, cacheable or not.
+ *
+ * A widget which is not cacheable can still contain cacheable widgets,
+ * and those are still cached. However a cacheable layout which
+ * contains a widget that is not cacheable is painted every time.
+ *
+ * See also: @ref{ml_widget_repaint(3)}.
+ */
+extern void ml_widget_enable_cache (ml_widget widget, pool pool);
+extern void ml_widget_invalidate (ml_widget widget);
+
+/* Private functions used by the stats app. */
+extern int _ml_widget_get_nr_cached (void);
+extern long long _ml_widget_get_cache_size (void);
+extern vector _ml_widget_get_cache_types (pool);
+extern int _ml_widget_get_nr_cache_hits (const struct ml_widget_operations *);
+extern int _ml_widget_get_nr_cache_misses (const struct ml_widget_operations *);
+extern int _ml_widget_get_nr_cache_uncached (const struct ml_widget_operations *);
+
 #endif /* ML_WIDGET_H */
@@ -27,6 +27,7 @@
 #include <pool.h>
 #include <pstring.h>
 
+#include <pthr_reactor.h>
 #include <pthr_http.h>
 
 #include "monolith.h"
@@ -34,8 +35,9 @@
 
 struct ml_window
 {
-  pool pool;			/* Pool for allocations. */
+  pool pool;			/* Window's own subpool. */
   const char *windowid;		/* Window ID. */
+  reactor_time_t last_access;	/* Time window was last requested. */
 
   /* For ordinary windows: */
   ml_widget w;			/* Packed widget. */
@@ -44,6 +46,8 @@ struct ml_window
   const char *stylesheet;	/* Stylesheet for the window. */
   const char *charset;		/* Character encoding. */
   int refresh;			/* Refresh period (0 = no refresh). */
+  int cacheable;		/* If set, send ETag and honour
+				 * If-None-Match. */
   int scroll_to_x, scroll_to_y;	/* Scroll to (x, y). */
 
   /* For framesets: */
@@ -61,9 +65,16 @@ static int next_window_id = 0;
 ml_window
 new_ml_window (ml_session session, pool pool)
 {
-  ml_window w = pmalloc (pool, sizeof *w);
+  ml_window w;
+
+  /* Each window has its own subpool, so that windows which the
+   * session discards can be freed along with everything in them.
+   */
+  pool = new_subpool (pool);
+  w = pmalloc (pool, sizeof *w);
 
   w->pool = pool;
+  w->last_access = reactor_time;
   w->w = 0;
   w->headers_flag = 1;
   w->title = 0;
@@ -71,6 +82,7 @@ new_ml_window (ml_session session, pool pool)
   w->stylesheet = "/ml-styles/default.css";
   w->charset = "utf-8";
   w->refresh = 0;
+  w->cacheable = 0;
   w->scroll_to_x = w->scroll_to_y = 0;
 
   w->rows = w->cols = 0;
@@ -86,6 +98,22 @@ new_ml_window (ml_session session, pool pool)
   return w;
 }
 
+ml_window
+new_ml_transient_window (ml_session session, pool pool)
+{
+  ml_window w = new_ml_window (session, pool);
+
+  _ml_session_add_transient_window (session, w);
+
+  return w;
+}
+
+pool
+ml_window_pool (ml_window w)
+{
+  return w->pool;
+}
+
 void
 ml_window_pack (ml_window w, ml_widget _w)
 {
@@ -152,6 +180,18 @@ ml_window_get_refresh (ml_window w)
   return w->refresh;
 }
 
+void
+ml_window_set_cacheable (ml_window w, int cacheable)
+{
+  w->cacheable = cacheable;
+}
+
+int
+ml_window_get_cacheable (ml_window w)
+{
+  return w->cacheable;
+}
+
 void
 ml_window_scroll_to (ml_window w, int x, int y)
 {
@@ -223,7 +263,8 @@ update_actions (ml_window w, ml_session session)
       for (i = 0; i < vector_size (w->frames); ++i)
 	{
 	  vector_get (w->frames, i, frame);
-	  actionid = ml_register_action (session, frame.fn, frame.data);
+	  actionid = ml_register_action_in_pool (session, w->pool,
+						 frame.fn, frame.data);
 	  vector_push_back (w->actions, actionid);
 	}
     }
@@ -287,11 +328,10 @@ _ml_window_send_headers (ml_window w, pool thread_pool,
     }
   else
     {
-      /* Send the Location: header. */
+      /* Send the Location: header. (ml_entry_point sends the
+       * Content-Length: header for the empty body).
+       */
       http_response_send_header (http_response, "Location", w->uri);
-
-      /* Send the Content-Length: header. */
-      http_response_send_header (http_response, "Content-Length", "0");
     }
 }
 
@@ -302,13 +342,25 @@ _ml_window_get_windowid (ml_window w)
 }
 
 void
-_ml_window_repaint (ml_window w, ml_session session, io_handle io)
+_ml_window_touch (ml_window w)
+{
+  w->last_access = reactor_time;
+}
+
+reactor_time_t
+_ml_window_get_last_access (ml_window w)
+{
+  return w->last_access;
+}
+
+void
+_ml_window_repaint (ml_window w, ml_session session, ml_output io)
 {
   if (!w->frames && !w->uri)	/* Ordinary window. */
     {
       if (w->headers_flag)
 	{
-	  io_fprintf
+	  ml_output_puts_static
 	    (io,
 	     "<!DOCTYPE html "
 	     "PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\" "
@@ -318,15 +370,15 @@ _ml_window_repaint (ml_window w, ml_session session, io_handle io)
 	     "<head>\n");
 
 	  if (w->title)
-	    io_fprintf (io, "<title>%s</title>\n", w->title);
+	    ml_output_printf (io, "<title>%s</title>\n", w->title);
 
 	  if (w->stylesheet)
-	    io_fprintf (io,
-			"<link rel=\"stylesheet\" "
-			"href=\"%s\" type=\"text/css\">\n",
-			w->stylesheet);
+	    ml_output_printf (io,
+			      "<link rel=\"stylesheet\" "
+			      "href=\"%s\" type=\"text/css\">\n",
+			      w->stylesheet);
 
-	  io_fprintf (io, "</head><body>\n");
+	  ml_output_puts_static (io, "</head><body>\n");
 	}
 
       if (w->w)
@@ -334,7 +386,7 @@ _ml_window_repaint (ml_window w, ml_session session, io_handle io)
 
       if (w->scroll_to_x > 0 || w->scroll_to_y > 0)
 	{
-	  io_fprintf
+	  ml_output_printf
 	    (io,
 	     "<script language=\"javascript\"><!--\n"
 	     "window.scrollTo (%d, %d);\n"
@@ -343,13 +395,13 @@ _ml_window_repaint (ml_window w, ml_session session, io_handle io)
 	}
 
       if (w->headers_flag)
-	io_fprintf (io, "</body></html>\n");
+	ml_output_puts_static (io, "</body></html>\n");
     }
   else if (w->frames)		/* Frameset. */
     {
       int i;
 
-      io_fprintf
+      ml_output_puts_static
 	(io,
 	 "<!DOCTYPE html "
 	 "PUBLIC \"-//W3C//DTD XHTML 1.0 Frameset//EN\" "
@@ -359,16 +411,16 @@ _ml_window_repaint (ml_window w, ml_session session, io_handle io)
 	 "<head>\n");
 
       if (w->title)
-	io_fprintf (io, "<title>%s</title>\n", w->title);
+	ml_output_printf (io, "<title>%s</title>\n", w->title);
 
-      io_fprintf (io, "</head><frameset");
+      ml_output_puts_static (io, "</head><frameset");
 
       if (w->rows)
-	io_fprintf (io, " rows=\"%s\"", w->rows);
+	ml_output_printf (io, " rows=\"%s\"", w->rows);
       if (w->cols)
-	io_fprintf (io, " cols=\"%s\"", w->cols);
+	ml_output_printf (io, " cols=\"%s\"", w->cols);
 
-      io_fprintf (io, ">");
+      ml_output_puts_static (io, ">");
 
       for (i = 0; i < vector_size (w->frames); ++i)
 	{
@@ -378,11 +430,11 @@ _ml_window_repaint (ml_window w, ml_session session, io_handle io)
 	  /* vector_get (w->frames, i, frame); */
 	  vector_get (w->actions, i, actionid);
 
-	  io_fprintf (io, "<frame src=\"%s?ml_action=%s\" />",
-		      ml_session_script_name (session), actionid);
+	  ml_output_printf (io, "<frame src=\"%s?ml_action=%s\" />",
+			    ml_session_script_name (session), actionid);
 	}
 
-      io_fprintf (io, "</frameset></html>\n");
+      ml_output_puts_static (io, "</frameset></html>\n");
     }
   else				/* Redirect. */
     {
@@ -21,6 +21,7 @@
 #ifndef ML_WINDOW_H
 #define ML_WINDOW_H
 
+#include <pthr_reactor.h>
 #include <pthr_iolib.h>
 #include <pthr_http.h>
 #include <ml_widget.h>
@@ -48,6 +49,8 @@ struct ml_frame_description
  * Function: ml_window_get_charset
  * Function: ml_window_set_refresh
  * Function: ml_window_get_refresh
+ * Function: ml_window_set_cacheable
+ * Function: ml_window_get_cacheable
  * Function: ml_window_scroll_to
  * Function: new_ml_frameset
  * Function: ml_frameset_set_description
@@ -86,6 +89,19 @@ struct ml_frame_description
  *
  * @code{new_ml_window} creates a new monolith window.
  *
+ * @code{new_ml_transient_window} creates a window which the session
+ * may discard once it has not been requested for a while (set by
+ * @code{monolith window max idle} in the configuration file, in
+ * seconds, default 600). Use this for popups and dialogs which the
+ * application creates afresh each time, and does not refer to again.
+ * If the user comes back to a discarded window, they get an error.
+ *
+ * @code{ml_window_pool} returns the window's own pool, which is a
+ * subpool of the pool passed to @code{new_ml_window}. Widgets which
+ * only appear in a transient window should be allocated in this pool,
+ * so that they are freed (and their actions unregistered) when the
+ * window is discarded.
+ *
  * @code{ml_window_pack} packs a widget into the window. Since a
  * window can only contain a single widget, subsequent calls to
  * this function overwrite the packed widget. (Note: this call
@@ -124,6 +140,20 @@ struct ml_frame_description
  * which means no automatic refresh. It is not recommended that
  * you set this in ordinary applications.
  *
+ * @code{ml_window_(set|get)_cacheable} changes whether the browser may
+ * keep a copy of the page and ask for it again conditionally. By
+ * default windows are not cacheable, and every request sends the
+ * whole page. If the flag is set, then monolith sends an
+ * @code{ETag} header (a checksum of the page). When the browser asks
+ * for the page again (with the back button, or because of the refresh
+ * period) and the page hasn't changed, monolith replies with
+ * @code{304 Not Modified} instead of sending the page again. The page
+ * is still repainted to work out whether it has changed, so this saves
+ * network bandwidth rather than server time. It is most useful for
+ * windows which use @code{ml_window_set_refresh} to poll for changes,
+ * such as status displays. Do not set this on windows where a
+ * browser showing an old copy of the page would cause problems.
+ *
  * @code{ml_window_scroll_to} scrolls the window to the absolute
  * (@code{x}, @code{y}) pixel position given. This is not supported by
  * all browsers.
@@ -162,6 +192,8 @@ struct ml_frame_description
  * See also: @ref{ml_ok_window(3)}.
  */
 extern ml_window new_ml_window (struct ml_session *, pool pool);
+extern ml_window new_ml_transient_window (struct ml_session *, pool pool);
+extern pool ml_window_pool (ml_window);
 extern void ml_window_pack (ml_window, ml_widget);
 extern void ml_window_set_headers_flag (ml_window, int headers_flag);
 extern int ml_window_get_headers_flag (ml_window);
@@ -173,6 +205,8 @@ extern void ml_window_set_charset (ml_window, const char *charset);
 extern const char *ml_window_get_charset (ml_window);
 extern void ml_window_set_refresh (ml_window, int refresh);
 extern int ml_window_get_refresh (ml_window);
+extern void ml_window_set_cacheable (ml_window, int cacheable);
+extern int ml_window_get_cacheable (ml_window);
 extern void ml_window_scroll_to (ml_window, int x, int y);
 extern ml_window new_ml_frameset (struct ml_session *, pool pool, const char *rows, const char *cols, vector frames);
 extern void ml_frameset_set_description (ml_window, struct ml_session *, const char *rows, const char *cols, vector frames);
@@ -186,11 +220,17 @@ extern const char *ml_redirect_get_uri (ml_window);
 extern int _ml_window_get_response_code (ml_window w);
 extern const char *_ml_window_get_response_name (ml_window w);
 extern void _ml_window_send_headers (ml_window w, pool thread_pool, http_response http_response);
-extern void _ml_window_repaint (ml_window, struct ml_session *, io_handle);
+extern void _ml_window_repaint (ml_window, struct ml_session *, ml_output);
 
 /* Internal function to get the current windowid - used in a very few,
  * quite rare places in monolith widgets.
  */
 extern const char *_ml_window_get_windowid (ml_window);
 
+/* Internal functions used by the session to discard idle transient
+ * windows.
+ */
+extern void _ml_window_touch (ml_window);
+extern reactor_time_t _ml_window_get_last_access (ml_window);
+
 #endif /* ML_WINDOW_H */
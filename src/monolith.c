@@ -22,6 +22,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
 #include <assert.h>
 
 #ifdef HAVE_SYS_TYPES_H
@@ -32,6 +34,10 @@
 #include <string.h>
 #endif
 
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -56,6 +62,10 @@
 #include <sys/socket.h>
 #endif
 
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
 #include <pool.h>
 #include <hash.h>
 #include <vector.h>
@@ -63,13 +73,17 @@
 #include <pthr_reactor.h>
 #include <pthr_pseudothread.h>
 #include <pthr_iolib.h>
-#include <pthr_mutex.h>
+#include <pthr_rwlock.h>
 #include <pthr_http.h>
 #include <pthr_wait_queue.h>
 #include <rws_request.h>
 
 #include "ml_window.h"
+#include "ml_output.h"
 #include "monolith.h"
+#include "ml_random.h"
+#include "scratch.h"
+#include "session_table.h"
 
 #ifndef STRINGIFY
 #ifdef HAVE_STRINGIZE
@@ -93,26 +107,110 @@
 #define SESSION_REAP_MAX 3600
 #define SESSION_REAP_INC 600
 
+/* Headers sent with windows which may be cached. The browser may keep
+ * the page, but must ask us whether it has changed before using it.
+ */
+#define CACHEABLE_HEADERS "Cache-Control", "private, no-cache", \
+                          "Expires", DISTANT_PAST
+
+/* Default compression settings. */
+#define COMPRESSION_LEVEL 6
+#define COMPRESSION_THRESHOLD 1024 /* Bytes. */
+
+/* Number of form tokens (ml_token) remembered per session. */
+#define NR_USED_TOKENS 32
+
+/* An action request which is running or waiting for the session lock.
+ * Identical requests arriving meanwhile are coalesced with it. The
+ * structure lives in its own pool, which is freed when the first
+ * request and all the requests coalesced with it have finished.
+ */
+struct pending_action
+{
+  pool pool;			/* Pool holding this structure. */
+  int refs;			/* Requests using this structure. */
+  const char *signature;	/* ml_action, ml_window and arguments. */
+  int nr_followers;		/* Number of requests coalesced with this. */
+  const char *windowid;		/* Window painted by the first request. */
+  char *page;			/* The page it painted (NULL = none). */
+  int page_len;
+};
+
+/* Per-request state. Several requests may be using a session at the
+ * same time (eg. repainting different frames of a frameset), and they
+ * each need their own copy of these.
+ */
+struct ml_request
+{
+  pseudothread pth;		/* Thread handling this request. */
+  rws_request rws_rq;		/* Current request. */
+  io_handle io;			/* Current IO handle. */
+  cgi submitted_args;		/* Current arguments. */
+  ml_window current_window;	/* "Current" window for the application. */
+  const char *auth_cookie;      /* If set, send an auth cookie at the end
+				 * of the current HTTP request. */
+  const char *auth_cookie_path, *auth_cookie_expires;
+  int lock_mode;		/* How we hold the session lock (LOCK_*). */
+  int nr_updates;		/* Nesting of ml_session_begin_update. */
+  int upgraded;			/* Set if begin_update upgraded the lock. */
+  scratch scratch;		/* Scratch memory (created on first use). */
+  pool dbh_pool;		/* Database handles borrowed by this request
+				 * (created on first use). */
+  vector dbhs;			/* The handles (struct factory_dbh *),
+				 * allocated in dbh_pool. */
+  reactor_timer watch;		/* Checks the request while it holds
+				 * handles (NULL = not running). */
+  reactor_time_t deadline;	/* Abandon the request after this (0 = never). */
+  reactor_time_t last_peer_check; /* When we last checked for the browser
+				 * disconnecting. */
+  int cancellable;		/* Set while running the action or repaint. */
+  int cancelled;		/* Why the request was abandoned (CANCEL_*). */
+};
+
+#define CANCEL_NONE       0
+#define CANCEL_DEADLINE   1
+#define CANCEL_DISCONNECT 2
+
+#define LOCK_NONE      0
+#define LOCK_SHARED    1
+#define LOCK_EXCLUSIVE 2
+
 struct ml_session
 {
   const char *sessionid;	/* Session ID (string of 32 hex digits). */
+  struct session_key key;	/* Session ID decoded into binary. */
   pool session_pool;		/* Pool for this session. */
-  mutex lock;			/* Lock for this session. */
+  rwlock lock;			/* Lock for this session. */
+  int dead;			/* Set when the session is being killed. */
+  int nr_users;			/* Threads holding or waiting for lock. */
+  wait_queue teardown_wq;	/* kill_session waits here for users. */
   int hits;			/* Number of requests in this session. */
   reactor_time_t created, last_access; /* Session created, last accessed. */
   int reap_min;			/* Time to reap, if hits == 1. */
   int reap_max;			/* Maximum reap time. */
   int reap_inc;			/* Increment in reap time, per hit. */
+  reactor_time_t expires;	/* Time at which the reaper will kill it. */
+  int heap_index;		/* Position in the expiry heap (-1 = none). */
+  int size;			/* Size of session pool when last measured. */
+  int over_quota;		/* Set if session exceeded its size limit. */
+  vector pending;		/* Actions in flight (struct pending_action *). */
+  struct session_key used_tokens[NR_USED_TOKENS]; /* Recent ml_tokens. */
+  int next_used_token;		/* Next slot to overwrite in used_tokens. */
   struct sockaddr_in original_ip; /* IP address of initial request. */
   cgi args;			/* Initial arguments. */
-  cgi submitted_args;		/* Current arguments (short-lived). */
-  rws_request rws_rq;		/* Current request (short-lived). */
-  io_handle io;			/* Current IO handle (short-lived). */
+  vector requests;		/* Requests using this session (struct
+				 * ml_request *). */
   void (*app_main) (ml_session); /* Main entry point into the application. */
-  ml_window current_window;	/* "Current" window for the application. */
   ml_window main_window;	/* Nominated main window for the application.*/
   shash windows;		/* Maps window IDs -> ml_window. */
-  shash actions;		/* Maps action IDs -> callback functions. */
+  vector transient_windows;	/* Windows which may be discarded. */
+  reactor_time_t next_window_sweep; /* Time to look for idle windows. */
+  struct action **actions;	/* Slab of action slots. */
+  int nr_actions;		/* Number of slots in use or free. */
+  int actions_alloc;		/* Number of slots allocated. */
+  int actions_free;		/* First free slot (-1 = none). */
+  vector action_owners;		/* Pools owning actions (struct
+				 * action_owner *). */
   const char *host_header;	/* Host header. */
   const char *canonical_path;	/* Full path to the script. */
   const char *script_name;	/* Just the name of the script. */
@@ -120,20 +218,134 @@ struct ml_session
   hash dbhs;			/* Hash db_handle -> pools of
 				 * handles given out in current session. */
   int userid;			/* Currently logged in user (0 = none). */
-  const char *auth_cookie;      /* If set, send an auth cookie at the end
-				 * of the current HTTP request. */
-  const char *auth_cookie_path, *auth_cookie_expires;
   ml_dbh_factory auth_dbf;	/* Connection used for authentication. */
+  struct auth_queue *auth_queue; /* Queued writes to the user database. */
+  ml_statement auth_select_cookie;
+};
+
+/* Actions are stored in a per-session array of slots. The action ID
+ * is "index.generation", so looking up an action is just an array
+ * access. When an action is unregistered, the generation of its slot is
+ * incremented and the slot is put on the free list for reuse. Old IDs
+ * (eg. in a page which the user has kept open) then no longer match.
+ *
+ * Slots are allocated once and never move, and the ID string is kept
+ * in the slot, so registering an action again in a reused slot doesn't
+ * allocate anything.
+ *
+ * Actions registered with ml_register_action_in_pool are also on a list
+ * belonging to that pool. There is one owner structure (and one cleanup
+ * function) per pool, however many times its widgets re-register.
+ */
+struct action_owner
+{
+  ml_session session;
+  pool pool;
+  int first;			/* First slot owned (-1 = none). */
 };
 
 struct action
 {
-  void (*callback_fn) (ml_session, void *data);
+  void (*callback_fn) (ml_session, void *data); /* NULL if slot is free. */
   void *data;
+  int index;			/* Index of this slot. */
+  unsigned generation;		/* Incremented each time slot is freed. */
+  int next_free;		/* Next slot in the free list (-1 = end). */
+  struct action_owner *owner;	/* Pool owning this action, or NULL. */
+  int next_owned;		/* Next slot with the same owner (-1 = end). */
+  char id[24];			/* "index.generation" */
 };
 
 static pool ml_pool;		/* Monolith library's own pool. */
-static shash sessions;		/* Maps session IDs -> ml_session. */
+static session_table sessions;	/* Maps session keys -> ml_session. */
+
+/* Live sessions are also kept in a binary min-heap ordered on their
+ * expiry time, so the reaper thread can find the next session to kill
+ * without scanning every session.
+ */
+static ml_session *expiry_heap;	/* Array of sessions. */
+static int expiry_heap_size;	/* Number of sessions in the heap. */
+static int expiry_heap_alloc;	/* Allocated size of the array. */
+static pseudothread reaper_pth;	/* Session reaper thread. */
+
+/* Session memory accounting. Sizes are measured (using the same pool
+ * statistics that the stats app shows) at the end of each request.
+ */
+static long long sessions_total_size; /* Sum of session->size. */
+static int session_max_size;	/* Per-session limit in bytes (0 = none). */
+static long long sessions_memory_budget; /* Global limit (0 = none). */
+static int nr_sessions_evicted;	/* Sessions killed to stay in budget. */
+static int nr_sessions_over_quota; /* Sessions killed for being too big. */
+
+static int nr_requests_coalesced; /* Duplicate action requests merged. */
+static int nr_pages_shared;	/* Coalesced requests sent the first
+				 * request's page. */
+static int nr_duplicate_submits; /* Forms submitted twice (same ml_token). */
+
+static int nr_deadline_cancels;	/* Requests abandoned at the deadline. */
+static int nr_not_modified;	/* 304 Not Modified responses sent. */
+static long long bytes_not_modified; /* Page bytes not sent because of
+				      * 304 responses. */
+static int nr_disconnect_cancels; /* Requests abandoned because the browser
+				 * went away. */
+static int nr_queries_cancelled; /* Queries cancelled on the server for
+				 * abandoned requests. */
+
+static int nr_windows_retired;	/* Idle transient windows discarded. */
+static long long windows_retired_size; /* Memory freed by doing so. */
+static pseudothread evictor_pth; /* Memory pressure eviction thread. */
+static wait_queue pressure_wq;	/* Evictor sleeps here until needed. */
+
+/* A database handle belonging to a factory. Each handle is opened in
+ * its own subpool of the factory pool, so that we can close a single
+ * connection by deleting the subpool.
+ */
+struct factory_dbh
+{
+  pool pool;			/* Subpool holding the handle. */
+  ml_dbh_factory dbf;		/* Factory which owns the handle. */
+  db_handle dbh;		/* The handle itself. */
+  reactor_time_t last_used;	/* When the handle was last given back. */
+  int readonly;			/* Set if the connection is in read only mode. */
+  int statement_timeout;	/* Current statement_timeout (seconds). */
+  int backend_pid;		/* Server process ID (0 = unknown). */
+  vector sths;			/* Registered statements prepared on this
+				 * handle (vector of st_handle, indexed by
+				 * ml_statement->index, NULL if preparing
+				 * failed). */
+};
+
+/* A statement registered with a factory. */
+struct ml_statement
+{
+  ml_dbh_factory dbf;		/* Factory. */
+  int index;			/* Index in dbf->statements. */
+  const char *query;		/* Query string. */
+  int nr_types;			/* Number of placeholders. */
+  int types[ML_STATEMENT_MAX_ARGS]; /* Placeholder types (DBI_*). */
+  int nr_prepares;		/* Number of times prepared. */
+  int nr_executes;		/* Number of times used. */
+};
+
+/* A thread waiting for a free handle. Waiters are queued in order of
+ * arrival, and a handle which is given back goes straight to the first
+ * waiter, so that newly arriving threads cannot jump the queue.
+ */
+struct dbh_waiter
+{
+  wait_queue wq;		/* The waiting thread sleeps on this. */
+  int queued;			/* Set while in the factory's queue. */
+  struct factory_dbh *fdbh;	/* Handle passed to the waiter, or NULL
+				 * if it should try again. */
+  reactor_timer timer;		/* Wakes the waiter to check its request
+				 * (NULL = not set, or gone off). */
+};
+
+/* Histogram of time spent waiting for a handle. Bucket 0 counts requests
+ * which didn't have to wait, and bucket i (i > 0) counts waits of less
+ * than 10^i milliseconds. The last bucket counts everything longer.
+ */
+#define NR_DBH_WAIT_BUCKETS 6
 
 /* Database handle factory. This stores a pool of database handles
  * for a given connection.
@@ -142,274 +354,972 @@ struct ml_dbh_factory
 {
   pool pool;			/* Pool for allocations. */
   const char *conninfo;		/* Connection info string. */
-  int allocated;		/* Total number of handles open. */
-  vector free_handles;		/* List of FREE handles. */
+  int allocated;		/* Total number of handles open (including
+				 * handles which are being opened). */
+  int max_handles;		/* Maximum number of handles (0 = no limit). */
+  int min_handles;		/* Handles kept open even when idle. */
+  int max_idle;			/* Close free handles idle this long (secs). */
+  vector free_handles;		/* List of FREE handles (struct factory_dbh *),
+				 * least recently used first. */
+  vector waiters;		/* Queue of waiting threads (struct dbh_waiter *). */
+  int nr_waits[NR_DBH_WAIT_BUCKETS]; /* Time spent waiting for handles. */
+  int nr_reaped;		/* Number of idle handles closed. */
+  int nr_dead;			/* Number of handles found to be dead. */
+  int nr_rollbacks;		/* Handles rolled back when given back. */
+  int nr_rollbacks_skipped;	/* Handles given back with no transaction. */
+  vector statements;		/* Registered statements (ml_statement). */
+  shash statements_by_query;	/* Hash query -> ml_statement. */
+
+  /* Read replicas. A replica is a factory of its own, but it isn't in
+   * dbh_factories, and it shares the statements of its primary.
+   */
+  ml_dbh_factory primary;	/* If this is a replica, its primary. */
+  vector replicas;		/* Replicas (vector of ml_dbh_factory). */
+  int replica_lag;		/* Read from the primary for this long
+				 * after a write (seconds). */
+  int statement_timeout;	/* statement_timeout for handles (secs). */
+  reactor_time_t last_write;	/* When a read write handle was last
+				 * given back. */
+  reactor_time_t down_until;	/* Replica failed: don't use it until. */
+  int nr_replica_reads;		/* Read only handles taken from replicas. */
+  int nr_replica_failures;	/* Replicas which failed. */
 };
 
 static shash dbh_factories;	/* Hash conninfo -> ml_dbh_factory. */
+static hash dbh_handles;	/* Hash db_handle -> struct factory_dbh *. */
+static pseudothread dbh_reaper_pth; /* Closes idle database handles. */
+
+/* Auth cookies which have been checked recently, so that a returning
+ * user starting a new session doesn't always have to wait for the
+ * database. Cookies are indexed in their decoded form, like session
+ * IDs, and the entries are kept on an LRU list.
+ */
+struct auth_cache_entry
+{
+  struct session_key key;	/* The cookie. */
+  ml_dbh_factory dbf;		/* User database which was asked. */
+  int userid;			/* User ID (0 = cookie is not valid). */
+  reactor_time_t expires;	/* When to ask the database again. */
+  struct auth_cache_entry *prev, *next; /* LRU list (most recent first). */
+};
+
+static session_table auth_cache; /* Key -> struct auth_cache_entry *. */
+static struct auth_cache_entry *auth_cache_head, *auth_cache_tail;
+static struct auth_cache_entry *auth_cache_free; /* Unused entries. */
+static int auth_cache_max;	/* Maximum number of entries. */
+static int auth_cache_generation; /* Incremented on each invalidation. */
+static int nr_auth_cache_hits, nr_auth_cache_misses;
+
+/* Default auth cache settings. */
+#define AUTH_CACHE_SIZE 1024	/* Entries. */
+#define AUTH_CACHE_TTL 300	/* Seconds. */
+#define AUTH_CACHE_NEGATIVE_TTL 10 /* Seconds. */
+
+/* These are the default database handle factory settings. */
+#define DBH_MAX_HANDLES 0	/* No limit. */
+#define DBH_MIN_HANDLES 0
+#define DBH_MAX_IDLE 300	/* Seconds. */
+#define DBH_REPLICA_LAG 2	/* Seconds. */
+
+/* When a read replica fails, leave it alone for this long (in seconds)
+ * before trying it again.
+ */
+#define DBH_REPLICA_RETRY 30
+
+/* Free handles which have been idle for longer than this (in seconds)
+ * are checked before being handed out, in case the server has closed
+ * the connection in the meantime.
+ */
+#define DBH_CHECK_AFTER 30
+
+/* How often the database handle reaper runs (in seconds). */
+#define DBH_REAP_INTERVAL 10
+
+/* How often a request waiting for a handle checks whether it should be
+ * abandoned (in milliseconds).
+ */
+#define DBH_WAIT_CHECK_INTERVAL 1000
+
+/* How often a request holding handles is checked, in case it should be
+ * abandoned while waiting for a query (in milliseconds).
+ */
+#define DBH_WATCH_INTERVAL 1000
 
 static void run_action (ml_session, const char *);
 static int bad_request_error (rws_request rq, const char *text);
 static int auth_to_userid (ml_session, const char *auth);
 static void monolith_init (void) __attribute__ ((constructor));
 static void monolith_stop (void) __attribute__ ((destructor));
-static void kill_session (const char *sessionid);
+static void kill_session (ml_session);
+static struct action *get_action (ml_session, const char *action_id);
+static struct action *register_action (ml_session, void (*callback_fn) (ml_session, void *), void *data);
+static void free_action (ml_session, struct action *);
+static int session_enter (ml_session, struct ml_request *, int lock_mode);
+static void session_leave (ml_session, struct ml_request *);
+static struct ml_request *find_request (ml_session);
+static struct ml_request *current_request (ml_session);
+static void retire_windows (ml_session, struct ml_request *);
+static struct pending_action *begin_action (ml_session, pool, cgi, int *follower);
+static void end_action (ml_session, struct pending_action *);
+static void share_page (struct pending_action *, struct ml_request *, ml_output);
+static int use_shared_page (ml_session, struct ml_request *, struct pending_action *, ml_output);
+static int claim_token (ml_session, const char *token);
+static void schedule_session (ml_session);
+static void unschedule_session (ml_session);
+static void start_reaper (void);
+static void account_session (ml_session);
+static void recover_request_dbhs (struct ml_request *);
 
 static void
 monolith_init ()
 {
   ml_pool = new_subpool (global_pool);
-  sessions = new_shash (ml_pool, ml_session);
+  sessions = new_session_table (ml_pool);
   dbh_factories = new_shash (ml_pool, ml_dbh_factory);
+  dbh_handles = new_hash (ml_pool, db_handle, struct factory_dbh *);
+  auth_cache = new_session_table (ml_pool);
 }
 
+static void install_shutdown_hook (void);
+
 static void
 monolith_stop ()
 {
-  /* Note that this will also free up memory used by sessions, since
+  /* Queued changes to the user database are written by the shutdown
+   * hook (see install_shutdown_hook), not here: the reactor can't be
+   * run from inside exit.
+   *
+   * Note that this will also free up memory used by sessions, since
    * each session pool is a subpool of ml_pool.
    */
   delete_pool (ml_pool);
 }
 
+/* Calculate the time at which a session should be reaped. Sessions
+ * which have been used more are given longer to live.
+ */
+static inline reactor_time_t
+session_expiry (ml_session session)
+{
+  int reap_age;
+
+  reap_age = session->reap_min + (session->hits - 1) * session->reap_inc;
+  if (reap_age > session->reap_max)
+    reap_age = session->reap_max;
+
+  return session->last_access + reap_age * 1000LL;
+}
+
 static inline void
-kill_old_sessions ()
+heap_set (int i, ml_session session)
 {
-  static reactor_time_t last_reap = 0;
+  expiry_heap[i] = session;
+  session->heap_index = i;
+}
 
-  /* Only reap sessions every 10s. This also ensures that only one thread
-   * will try to kill sessions.
-   */
-  if (reactor_time - last_reap > 10000LL)
+static void
+heap_sift_up (int i)
+{
+  ml_session session = expiry_heap[i];
+
+  while (i > 0)
     {
-      vector session_list;
-      int i;
+      int parent = (i - 1) / 2;
 
-      last_reap = reactor_time;
+      if (expiry_heap[parent]->expires <= session->expires)
+	break;
+      heap_set (i, expiry_heap[parent]);
+      i = parent;
+    }
+  heap_set (i, session);
+}
 
-      session_list
-	= shash_values_in_pool (sessions, pth_get_pool (current_pth));
+static void
+heap_sift_down (int i)
+{
+  ml_session session = expiry_heap[i];
 
-      for (i = 0; i < vector_size (session_list); ++i)
-	{
-	  ml_session session;
-	  int reap_age;
+  for (;;)
+    {
+      int child = 2 * i + 1;
+
+      if (child >= expiry_heap_size)
+	break;
+      if (child + 1 < expiry_heap_size &&
+	  expiry_heap[child + 1]->expires < expiry_heap[child]->expires)
+	child++;
+      if (session->expires <= expiry_heap[child]->expires)
+	break;
+      heap_set (i, expiry_heap[child]);
+      i = child;
+    }
+  heap_set (i, session);
+}
 
-	  vector_get (session_list, i, session);
+/* (Re)compute the expiry time of a session and put it in the right
+ * place in the expiry heap. This is called on each hit.
+ */
+static void
+schedule_session (ml_session session)
+{
+  /* Dead sessions are no longer in the heap, so don't put them back. */
+  if (session->dead) return;
 
-	  /* Calculate the age before reaping. */
-	  reap_age = session->reap_min +
-	    (session->hits - 1) * session->reap_inc;
-	  if (reap_age > session->reap_max)
-	    reap_age = session->reap_max;
+  session->expires = session_expiry (session);
 
-	  /* Session is older than this? */
-	  if (reactor_time - session->last_access > reap_age * 1000LL)
+  if (session->heap_index == -1)
+    {
+      if (expiry_heap_size == expiry_heap_alloc)
+	{
+	  if (expiry_heap_alloc == 0)
 	    {
-#if 0
-	      fprintf (stderr,
-		       "reaping session ID %s\n"
-		       "current time = %llu, last access = %llu, diff = %llu",
-		       session->sessionid,
-		       reactor_time,
-		       session->last_access,
-		       reactor_time - session->last_access
-		       );
-#endif
-	      kill_session (session->sessionid);
+	      expiry_heap_alloc = 256;
+	      expiry_heap = pmalloc (ml_pool,
+				     expiry_heap_alloc * sizeof (ml_session));
+	    }
+	  else
+	    {
+	      expiry_heap_alloc *= 2;
+	      expiry_heap = prealloc (ml_pool, expiry_heap,
+				      expiry_heap_alloc * sizeof (ml_session));
 	    }
 	}
+      heap_set (expiry_heap_size++, session);
     }
+
+  heap_sift_up (session->heap_index);
+  heap_sift_down (session->heap_index);
 }
 
-static inline int
-my_isxdigit (char c)
+static void
+unschedule_session (ml_session session)
 {
-  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+  int i = session->heap_index;
+
+  if (i == -1) return;
+
+  session->heap_index = -1;
+  expiry_heap_size--;
+  if (i < expiry_heap_size)
+    {
+      heap_set (i, expiry_heap[expiry_heap_size]);
+      heap_sift_up (i);
+      heap_sift_down (expiry_heap[i]->heap_index);
+    }
 }
 
-static inline const char *
-get_sessionid_from_cookie (http_request http_request)
-{
-  const char *sessionid;
-  int i;
+/* The reaper thread sleeps until the first session in the heap is due
+ * to expire, kills it, and so on. This means that no user request ever
+ * has to pay for reaping sessions.
+ */
+#define REAPER_MAX_SLEEP 10000	/* Milliseconds. */
 
-  sessionid = http_request_get_cookie (http_request, "ml_sessionid");
-  if (sessionid)
+static void
+reaper (void *data)
+{
+  for (;;)
     {
-      /* Check that the cookie has a valid form (32 hex digits). If
-       * not, just ignore it.
-       */
-      if (strlen (sessionid) == 32)
+      reactor_time_t wait = REAPER_MAX_SLEEP;
+
+      while (expiry_heap_size > 0 && expiry_heap[0]->expires <= reactor_time)
 	{
-	  for (i = 0; i < 32; ++i)
-	    if (!my_isxdigit (sessionid[i]))
-	      break;
-	  return sessionid;
+#if 0
+	  fprintf (stderr,
+		   "reaping session ID %s\n"
+		   "current time = %llu, last access = %llu, diff = %llu",
+		   expiry_heap[0]->sessionid,
+		   reactor_time,
+		   expiry_heap[0]->last_access,
+		   reactor_time - expiry_heap[0]->last_access
+		   );
+#endif
+	  kill_session (expiry_heap[0]);
 	}
+
+      if (expiry_heap_size > 0 &&
+	  expiry_heap[0]->expires - reactor_time < wait)
+	wait = expiry_heap[0]->expires - reactor_time;
+
+      pth_millisleep ((int) wait);
     }
+}
 
-  return 0;
+static void evictor (void *data);
+
+static void
+start_reaper ()
+{
+  reaper_pth = new_pseudothread (ml_pool, reaper, 0,
+				 "monolith session reaper");
+  pth_start (reaper_pth);
+
+  pressure_wq = new_wait_queue (ml_pool);
+  evictor_pth = new_pseudothread (ml_pool, evictor, 0,
+				  "monolith session evictor");
+  pth_start (evictor_pth);
 }
 
-/* This function is so useful, it should be part of c2lib (XXX)
- * See also the other occurrence in ml_login_nopw.c
+/* Measure the size of the session and update the global total. This is
+ * called at the end of each request. If either the per-session limit or
+ * the global budget has been exceeded, wake up the evictor thread.
  */
-static inline const char *
-generate_sessionid (pool pool)
+static void
+account_session (ml_session session)
 {
-  int fd, i;
-  unsigned char buffer[16];
-  char *sessionid = pmalloc (pool, 33 * sizeof (char));
+  struct pool_stats pool_stats;
+
+  /* If the session was killed during this request, kill_session has
+   * already taken it out of the total.
+   */
+  if (session->dead) return;
+
+  /* Read the limits from the configuration file (in kilobytes). */
+  session_max_size =
+    ml_cfg_get_int (session, "monolith session max size", 0) * 1024;
+  sessions_memory_budget =
+    ml_cfg_get_int (session, "monolith sessions memory budget", 0) * 1024LL;
 
-  fd = open ("/dev/urandom", O_RDONLY);
-  if (fd == -1) abort ();
-  if (read (fd, buffer, 16) != 16) abort ();
-  close (fd);
+  pool_get_stats (session->session_pool, &pool_stats, sizeof (pool_stats));
+  sessions_total_size += pool_stats.struct_size - session->size;
+  session->size = pool_stats.struct_size;
 
-  for (i = 0; i < 16; ++i)
-    sprintf (sessionid + i*2, "%02x", buffer[i]);
+  if (session_max_size > 0 && session->size > session_max_size)
+    session->over_quota = 1;
 
-  return sessionid;
+  if (session->over_quota ||
+      (sessions_memory_budget > 0 &&
+       sessions_total_size > sessions_memory_budget))
+    wq_wake_up (pressure_wq);
 }
 
-static const char *
-get_script_name (pool pool, const char *canonical_path)
+/* Sessions which have been idle longest and are biggest are evicted
+ * first. The score is idle time (in seconds, plus one so that sessions
+ * active this second still get ranked by size) times size.
+ */
+static inline double
+eviction_score (ml_session session)
 {
-  char *t = strrchr (canonical_path, '/');
-  return t ? pstrdup (pool, t+1) : canonical_path;
+  return ((reactor_time - session->last_access) / 1000 + 1)
+    * (double) session->size;
 }
 
-int
-ml_entry_point (rws_request rq, void (*app_main) (ml_session))
+static int
+compare_eviction_scores (const void *av, const void *bv)
 {
-  pool thread_pool = pth_get_pool (current_pth);
-  io_handle io = rws_request_io (rq);
-  http_request http_request = rws_request_http_request (rq);
-  const char *host_header = rws_request_host_header (rq);
-  const char *canonical_path = rws_request_canonical_path (rq);
-  const char *sessionid;
-  cgi cgi;
+  double a = eviction_score (*(ml_session *) av);
+  double b = eviction_score (*(ml_session *) bv);
+
+  return a > b ? -1 : a < b ? 1 : 0;
+}
+
+/* kill_session can sleep, during which other threads may kill and free
+ * sessions. So when killing a list of sessions, we remember their keys
+ * and look each one up again just before killing it.
+ */
+static vector
+get_session_keys (pool pool, vector session_list, int only_over_quota)
+{
+  vector keys = new_vector (pool, struct session_key);
   ml_session session;
-  int send_sessionid = 0;
-  http_response http_response;
-  int close;
-  const char *actionid, *windowid, *auth;
+  int i;
 
-  /* Look for old sessions and kill them. */
-  kill_old_sessions ();
+  for (i = 0; i < vector_size (session_list); ++i)
+    {
+      vector_get (session_list, i, session);
+      if (!only_over_quota || session->over_quota)
+	vector_push_back (keys, session->key);
+    }
 
-  /* Get the sessionid, if there is one. */
-  sessionid = get_sessionid_from_cookie (http_request);
+  return keys;
+}
 
-  /* Parse the CGI parameters, and extract the monolith-specific
-   * parameters. Note that these are parsed into the thread pool,
-   * not into the session pool (we don't even know yet if we have
-   * a session pool, so that's not an option).
-   */
-  cgi = new_cgi (thread_pool, http_request, io);
+static void
+evict_sessions ()
+{
+  pool pool = new_subpool (pth_get_pool (current_pth));
+  vector session_list, keys;
+  struct session_key key;
+  ml_session session;
+  long long low_water;
+  int i;
 
-  /* If ml_reset passed, begin a new session regardless. */
-  if (cgi_param (cgi, "ml_reset"))
+  session_list = session_table_values (sessions, pool);
+
+  /* Kill any sessions which have grown beyond the per-session limit. */
+  keys = get_session_keys (pool, session_list, 1);
+  for (i = 0; i < vector_size (keys); ++i)
     {
-      /* But if there was an existing session, delete it now. */
-      if (sessionid)
-	kill_session (sessionid);
+      vector_get (keys, i, key);
 
-      sessionid = 0;
+      if ((session = session_table_get (sessions, &key)) != 0)
+	{
+	  nr_sessions_over_quota++;
+	  kill_session (session);
+	}
     }
 
-  if (sessionid && shash_get (sessions, sessionid, session))
+  /* If we are still over the global budget, kill the coldest sessions
+   * until we are comfortably (10%) below it, so we don't immediately get
+   * woken up again.
+   */
+  if (sessions_memory_budget > 0 &&
+      sessions_total_size > sessions_memory_budget)
     {
-      /* It's an existing, valid session. */
-
-      /* Acquire the lock before accessing any parts of the session
-       * structure.
-       */
-      mutex_enter (session->lock);
-
-      /* Update the access time. */
-      session->last_access = reactor_time;
+      session_list = session_table_values (sessions, pool);
+      vector_sort (session_list, compare_eviction_scores);
+      keys = get_session_keys (pool, session_list, 0);
 
-      /* Hit. */
-      session->hits++;
+      low_water = sessions_memory_budget - sessions_memory_budget / 10;
 
-      /* Get the current window, from the ml_window parameter. If there
-       * is no ml_window parameter (can happen when opening new windows),
-       * then set current window to NULL and expect that the action will
-       * set the current window.
-       */
-      session->current_window = session->main_window;
-      windowid = cgi_param (cgi, "ml_window");
-      if (windowid &&
-	  ! shash_get (session->windows, windowid, session->current_window))
+      for (i = 0;
+	   i < vector_size (keys) && sessions_total_size > low_water;
+	   ++i)
 	{
-	  return bad_request_error (rq,
-				    psprintf (thread_pool,
-					      "invalid window ID: %s",
-					      windowid));
+	  vector_get (keys, i, key);
+
+	  if ((session = session_table_get (sessions, &key)) != 0)
+	    {
+	      nr_sessions_evicted++;
+	      kill_session (session);
+	    }
 	}
+    }
 
-      /* Set the rws_rq field to the current request. */
-      session->rws_rq = rq;
+  delete_pool (pool);
+}
 
-      /* Set the current IO handle. */
-      session->io = io;
+static void
+evictor (void *data)
+{
+  for (;;)
+    {
+      wq_sleep_on (pressure_wq);
+      evict_sessions ();
+    }
+}
 
-      /* Get ready for sending back auth cookie. */
-      session->auth_cookie = 0;
+static inline const char *
+get_sessionid_from_cookie (http_request http_request, struct session_key *key)
+{
+  const char *sessionid;
 
-      /* If the userid is set, check to see if there is a "poison" cookie.
-       * If so, then we log out the user.
-       */
-      if (session->userid != 0 &&
-	  (auth = http_request_get_cookie (http_request, "ml_auth")) != 0
-	  && strcmp (auth, "poison") == 0)
-	{
-	  session->userid = 0;
-	}
-      else if (session->userid == 0 &&
-	       (auth = http_request_get_cookie (http_request, "ml_auth")) != 0)
+  sessionid = http_request_get_cookie (http_request, "ml_sessionid");
+
+  /* Check that the cookie has a valid form (32 hex digits), and decode
+   * it. If not, just ignore it.
+   */
+  if (sessionid && session_key_parse (sessionid, key))
+    return sessionid;
+
+  return 0;
+}
+
+static const char *
+get_script_name (pool pool, const char *canonical_path)
+{
+  char *t = strrchr (canonical_path, '/');
+  return t ? pstrdup (pool, t+1) : canonical_path;
+}
+
+/* Return the quality which an Accept-Encoding header gives to a
+ * content coding (0 = not acceptable).
+ */
+static double
+coding_quality (pool pool, const char *accept, const char *coding)
+{
+  vector items, params;
+  char *item, *param;
+  double q, star_q = 0;
+  int i, j;
+
+  items = pstrcsplit (pool, accept, ',');
+  for (i = 0; i < vector_size (items); ++i)
+    {
+      vector_get (items, i, item);
+      params = pstrcsplit (pool, item, ';');
+      if (vector_size (params) == 0) continue;
+
+      q = 1;
+      for (j = 1; j < vector_size (params); ++j)
 	{
-	  session->userid = auth_to_userid (session, auth);
+	  vector_get (params, j, param);
+	  param = ptrim (param);
+	  if (strncasecmp (param, "q=", 2) == 0)
+	    q = atof (param + 2);
 	}
 
-      /* If the ml_action parameter is given, invoke the appropriate
-       * function.
-       */
-      actionid = cgi_param (cgi, "ml_action");
+      vector_get (params, 0, item);
+      item = ptrim (item);
+      if (strcasecmp (item, coding) == 0)
+	return q;
+      if (strcmp (item, "*") == 0)
+	star_q = q;
+    }
 
-      /* Save the submitted args, for forms. */
-      session->submitted_args = cgi;
+  return star_q;
+}
 
-      if (actionid)
-	run_action (session, actionid);
-    }
-  else
+static const char *
+make_etag (pool pool, const char *checksum, int encoding)
+{
+  return psprintf (pool, "\"%s%s\"", checksum,
+		   encoding == ML_OUTPUT_GZIP ? "-gzip" :
+		   encoding == ML_OUTPUT_DEFLATE ? "-deflate" : "");
+}
+
+/* Does the If-None-Match header list the ETag of the page? */
+static int
+etag_matches (pool pool, const char *if_none_match, const char *etag)
+{
+  vector tags;
+  char *tag;
+  int i;
+
+  tags = pstrcsplit (pool, if_none_match, ',');
+  for (i = 0; i < vector_size (tags); ++i)
     {
-      /* Start a new session. */
-      pool session_pool;
-      socklen_t namelen;
-      const char *ua;
+      vector_get (tags, i, tag);
+      tag = ptrim (tag);
+
+      /* If-None-Match uses the weak comparison, so ignore W/. */
+      if (strncmp (tag, "W/", 2) == 0)
+	tag += 2;
+      if (strcmp (tag, etag) == 0 || strcmp (tag, "*") == 0)
+	return 1;
+    }
 
-      /* Create a pool for this session. */
-      session_pool = new_subpool (ml_pool);
+  return 0;
+}
+
+/* Decide whether, and how, to compress the response. Returns
+ * ML_OUTPUT_GZIP, ML_OUTPUT_DEFLATE or 0.
+ */
+static int
+choose_encoding (pool pool, http_request http_request)
+{
+  const char *accept;
+  double gzip_q, deflate_q;
+
+  accept = http_request_get_header (http_request, "Accept-Encoding");
+  if (!accept) return 0;
+
+  gzip_q = coding_quality (pool, accept, "gzip");
+  deflate_q = coding_quality (pool, accept, "deflate");
+
+  if (gzip_q > 0 && gzip_q >= deflate_q) return ML_OUTPUT_GZIP;
+  if (deflate_q > 0) return ML_OUTPUT_DEFLATE;
+  return 0;
+}
+
+/* The action (or app_main) and the repaint are run inside pth_catch,
+ * so that if the request has to be abandoned part way through, we can
+ * still give back the session lock and the database handles.
+ */
+struct request_step
+{
+  ml_session session;
+  struct ml_request *req;
+  const char *actionid;
+  void (*app_main) (ml_session);
+  ml_output out;
+};
+
+static inline void
+init_step (struct request_step *step,
+	   ml_session session, struct ml_request *req)
+{
+  step->session = session;
+  step->req = req;
+  step->actionid = 0;
+  step->app_main = 0;
+  step->out = 0;
+}
+
+static void
+do_action (void *vstep)
+{
+  struct request_step *step = (struct request_step *) vstep;
+
+  run_action (step->session, step->actionid);
+}
+
+static void
+do_app_main (void *vstep)
+{
+  struct request_step *step = (struct request_step *) vstep;
+
+  step->app_main (step->session);
+}
+
+static void
+do_repaint (void *vstep)
+{
+  struct request_step *step = (struct request_step *) vstep;
+
+  _ml_window_repaint (step->req->current_window, step->session,
+		      step->out);
+}
+
+static const char *
+run_step (struct request_step *step, void (*fn) (void *))
+{
+  const char *err;
+
+  step->req->cancellable = 1;
+  err = pth_catch (fn, step);
+  step->req->cancellable = 0;
+
+  return err;
+}
+
+/* Clean up after an action or repaint has failed. If the request was
+ * abandoned because of the deadline or because the browser went away,
+ * then we finish the request here. Any other error is passed on.
+ */
+static int
+abandon_request (ml_session session, struct ml_request *req,
+		 struct pending_action *pending, const char *err)
+{
+  int cancelled = req->cancelled;
+
+  /* A query which was stopped by the statement_timeout we set in
+   * get_dbh shows up as an ordinary database error.
+   */
+  if (cancelled == CANCEL_NONE &&
+      req->deadline && reactor_time >= req->deadline)
+    cancelled = CANCEL_DEADLINE;
+
+  recover_request_dbhs (req);
+  end_action (session, pending);
+  account_session (session);
+  session_leave (session, req);
+
+  switch (cancelled)
+    {
+    case CANCEL_DEADLINE:
+      nr_deadline_cancels++;
+      /* The page is painted before any of the response is sent, so we
+       * can always tell the browser why.
+       */
+      return bad_request_error (req->rws_rq, "request took too long");
+
+    case CANCEL_DISCONNECT:
+      nr_disconnect_cancels++;
+      return 1;
+
+    default:
+      pth_die (err);
+    }
+}
+
+/* Has the browser closed the connection? */
+static int
+peer_has_gone (struct ml_request *req)
+{
+  char c;
+  int r;
+
+  r = recv (io_fileno (req->io), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (r == 0) return 1;
+  if (r == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    return 1;
+  return 0;
+}
+
+/* Should the request be abandoned? If so, this sets req->cancelled
+ * to the reason.
+ */
+static int
+request_cancelled (struct ml_request *req)
+{
+  if (!req->cancellable) return 0;
+
+  if (req->deadline && reactor_time >= req->deadline)
+    {
+      req->cancelled = CANCEL_DEADLINE;
+      return 1;
+    }
+
+  /* The browser can only have gone away if we have given up the CPU
+   * since we last looked.
+   */
+  if (req->last_peer_check != reactor_time)
+    {
+      req->last_peer_check = reactor_time;
+      if (peer_has_gone (req))
+	{
+	  req->cancelled = CANCEL_DISCONNECT;
+	  return 1;
+	}
+    }
+
+  return req->cancelled != CANCEL_NONE;
+}
+
+static void
+check_request (struct ml_request *req)
+{
+  if (request_cancelled (req))
+    pth_die (req->cancelled == CANCEL_DEADLINE
+	     ? "request deadline exceeded"
+	     : "browser closed the connection");
+}
+
+/* How long a request waiting for a database handle should sleep before
+ * checking whether it should give up (in milliseconds).
+ */
+static int
+wait_interval (struct ml_request *req)
+{
+  reactor_time_t left;
+
+  if (req->deadline)
+    {
+      left = req->deadline - reactor_time;
+      if (left < DBH_WAIT_CHECK_INTERVAL)
+	return left > 0 ? (int) left : 1;
+    }
+
+  return DBH_WAIT_CHECK_INTERVAL;
+}
+
+void
+ml_session_check_request (ml_session session)
+{
+  struct ml_request *req = find_request (session);
+
+  if (req) check_request (req);
+}
+
+int
+ml_entry_point (rws_request rq, void (*app_main) (ml_session))
+{
+  pool thread_pool = pth_get_pool (current_pth);
+  io_handle io = rws_request_io (rq);
+  http_request http_request = rws_request_http_request (rq);
+  const char *host_header = rws_request_host_header (rq);
+  const char *canonical_path = rws_request_canonical_path (rq);
+  const char *sessionid;
+  struct session_key key;
+  cgi cgi;
+  ml_session session = 0;
+  int send_sessionid = 0;
+  http_response http_response;
+  int close;
+  const char *actionid, *windowid, *auth, *token;
+  struct pending_action *pending = 0, *shared = 0;
+  int follower = 0, lock_mode, deadline, userid;
+  struct ml_request *req;
+  struct request_step step;
+  const char *err = 0;
+  ml_output out = 0;
+  int level, threshold, encoding = 0, not_modified = 0;
+  const char *checksum = 0, *etag = 0, *if_none_match;
+
+  /* Start the session reaper the first time we are called. */
+  if (!reaper_pth)
+    start_reaper ();
+
+  /* Get the sessionid, if there is one. */
+  sessionid = get_sessionid_from_cookie (http_request, &key);
+  if (sessionid)
+    session = session_table_get (sessions, &key);
+
+  /* Parse the CGI parameters, and extract the monolith-specific
+   * parameters. Note that these are parsed into the thread pool,
+   * not into the session pool (we don't even know yet if we have
+   * a session pool, so that's not an option).
+   */
+  cgi = new_cgi (thread_pool, http_request, io);
+
+  /* If ml_reset passed, begin a new session regardless. */
+  if (cgi_param (cgi, "ml_reset"))
+    {
+      /* But if there was an existing session, delete it now. */
+      if (session)
+	kill_session (session);
+
+      session = 0;
+    }
+
+  /* If this request is identical to one which is already running or
+   * waiting in this session (double clicks, impatient users pressing
+   * reload, etc.), then don't run the action again. We still need to
+   * send back a page, which will show the result of the first request.
+   * HEAD requests never run the action, so they mustn't become the
+   * first request either, otherwise a GET which arrived meanwhile
+   * would wait for them and then not run the action at all.
+   */
+  actionid = cgi_param (cgi, "ml_action");
+  if (session && actionid && !http_request_is_HEAD (http_request))
+    {
+      pending = begin_action (session, thread_pool, cgi, &follower);
+      if (follower)
+	{
+	  shared = pending;
+	  pending = 0;
+	}
+    }
+
+  /* Set up the per-request state. */
+  req = pmalloc (thread_pool, sizeof *req);
+  req->pth = current_pth;
+  req->rws_rq = rq;
+  req->io = io;
+  req->submitted_args = cgi;
+  req->current_window = 0;
+  req->auth_cookie = 0;
+  req->lock_mode = LOCK_NONE;
+  req->nr_updates = 0;
+  req->upgraded = 0;
+  req->scratch = 0;
+  req->dbh_pool = 0;
+  req->dbhs = 0;
+  req->watch = 0;
+  req->deadline = 0;
+  req->last_peer_check = reactor_time;
+  req->cancellable = 0;
+  req->cancelled = CANCEL_NONE;
+
+  deadline = rws_request_cfg_get_int (rq, "monolith request deadline", 0);
+  if (deadline > 0)
+    req->deadline = reactor_time + deadline * 1000LL;
+
+  /* Acquire the lock before accessing any parts of the session
+   * structure. Requests which just repaint a window (no action, or a
+   * duplicate action which we won't run, or HEAD) only read the session,
+   * so they can share the lock. If the session is killed while we are
+   * waiting for the lock, then we just start a new session instead.
+   */
+  if (actionid && !follower && !http_request_is_HEAD (http_request))
+    lock_mode = LOCK_EXCLUSIVE;
+  else
+    lock_mode = LOCK_SHARED;
+
+  if (session && !session_enter (session, req, lock_mode))
+    {
+      session = 0;
+      shared = 0;
+    }
+
+  if (session)
+    {
+      /* It's an existing, valid session. */
+
+      /* Update the access time. */
+      session->last_access = reactor_time;
+
+      /* Hit. */
+      session->hits++;
+
+      /* Push back the time at which this session will be reaped. */
+      schedule_session (session);
+
+      /* Get the current window, from the ml_window parameter. If there
+       * is no ml_window parameter (can happen when opening new windows),
+       * then set current window to NULL and expect that the action will
+       * set the current window.
+       */
+      req->current_window = session->main_window;
+      windowid = cgi_param (cgi, "ml_window");
+      if (windowid &&
+	  ! shash_get (session->windows, windowid, req->current_window))
+	{
+	  end_action (session, pending);
+	  session_leave (session, req);
+	  return bad_request_error (rq,
+				    psprintf (thread_pool,
+					      "invalid window ID: %s",
+					      windowid));
+	}
+      if (req->current_window)
+	_ml_window_touch (req->current_window);
+
+      /* If the userid is set, check to see if there is a "poison" cookie.
+       * If so, then we log out the user.
+       *
+       * We may only have the shared lock here, and other requests
+       * repainting this session must not see the user change halfway
+       * through a page, so the userid is changed inside an update.
+       * Looking up the cookie can sleep on the database, and so can
+       * waiting for the update, so check the userid again before
+       * changing it.
+       */
+      if (session->userid != 0 &&
+	  (auth = http_request_get_cookie (http_request, "ml_auth")) != 0
+	  && strcmp (auth, "poison") == 0)
+	{
+	  ml_session_begin_update (session);
+	  session->userid = 0;
+	  ml_session_end_update (session);
+	}
+      else if (session->userid == 0 &&
+	       (auth = http_request_get_cookie (http_request, "ml_auth")) != 0
+	       && (userid = auth_to_userid (session, auth)) != 0)
+	{
+	  ml_session_begin_update (session);
+	  if (session->userid == 0)
+	    session->userid = userid;
+	  ml_session_end_update (session);
+	}
+
+      /* If the ml_action parameter is given, invoke the appropriate
+       * function. Forms may also pass a single-use ml_token parameter,
+       * in which case a form which is submitted twice only has its
+       * callback run the first time.
+       */
+      token = cgi_param (cgi, "ml_token");
+
+      if (lock_mode == LOCK_EXCLUSIVE &&
+	  (!token || claim_token (session, token)))
+	{
+	  init_step (&step, session, req);
+	  step.actionid = actionid;
+	  err = run_step (&step, do_action);
+	}
+    }
+  else
+    {
+      /* Start a new session. */
+      pool session_pool;
+      socklen_t namelen;
+      const char *ua;
+
+      /* Create a pool for this session. */
+      session_pool = new_subpool (ml_pool);
 
       /* Create some state for this session. */
       session = pmalloc (session_pool, sizeof *session);
-      session->lock = new_mutex (session_pool);
+      session->lock = new_rwlock (session_pool);
+      rwlock_writers_have_priority (session->lock);
+      session->dead = 0;
+      session->nr_users = 0;
+      session->teardown_wq = new_wait_queue (session_pool);
       session->hits = 1;
       session->last_access = session->created = reactor_time;
       session->reap_min = SESSION_REAP_MIN;
       session->reap_max = SESSION_REAP_MAX;
       session->reap_inc = SESSION_REAP_INC;
+      session->heap_index = -1;
+      session->size = 0;
+      session->over_quota = 0;
+      session->pending = new_vector (session_pool, struct pending_action *);
+      memset (session->used_tokens, 0, sizeof session->used_tokens);
+      session->next_used_token = 0;
       session->session_pool = session_pool;
       session->app_main = app_main;
-      session->current_window = 0;
+      session->requests = new_vector (session_pool, struct ml_request *);
       session->main_window = 0;
       session->windows = new_shash (session_pool, ml_window);
-      session->sessionid = sessionid = generate_sessionid (session_pool);
-      session->actions = new_shash (session_pool, struct action);
+      session->transient_windows = new_vector (session_pool, ml_window);
+      session->next_window_sweep = 0;
+      session->sessionid = sessionid = ml_random_token (session_pool);
+      session_key_parse (sessionid, &session->key);
+      session->actions = 0;
+      session->nr_actions = session->actions_alloc = 0;
+      session->actions_free = -1;
+      session->action_owners =
+	new_vector (session_pool, struct action_owner *);
       session->host_header = pstrdup (session_pool, host_header);
       session->canonical_path = pstrdup (session_pool, canonical_path);
       session->script_name =
@@ -431,18 +1341,20 @@ ml_entry_point (rws_request rq, void (*app_main) (ml_session))
       cgi_erase (session->args, "ml_reset");
       cgi_erase (session->args, "ml_window");
       cgi_erase (session->args, "ml_action");
-
-      /* Set the rws_rq field to the current request. */
-      session->rws_rq = rq;
-
-      /* Set the current IO handle. */
-      session->io = io;
+      cgi_erase (session->args, "ml_token");
 
       /* Initialize the list of database handles. */
       session->dbhs = new_hash (session_pool, db_handle, pool);
 
       /* No initial authentication connection. */
       session->auth_dbf = 0;
+      session->auth_queue = 0;
+
+      /* Acquire the lock. Nothing else can see the session yet, but
+       * this also registers the current request, which the functions
+       * below need.
+       */
+      session_enter (session, req, LOCK_EXCLUSIVE);
 
       /* See if there's an ml_auth cookie. If so, and it's valid, then
        * we initialize the session->userid from this. Otherwise we
@@ -453,41 +1365,122 @@ ml_entry_point (rws_request rq, void (*app_main) (ml_session))
       else
 	session->userid = 0;
 
-      /* Get ready for sending back auth cookie. */
-      session->auth_cookie = 0;
-
       /* Remember to send back the ml_sessionid cookie. */
       send_sessionid = 1;
 
       /* Save the session. */
-      shash_insert (sessions, sessionid, session);
-
-      /* Acquire the lock. (Actually we don't strictly need to do this
-       * until after we have sent the cookie, but it makes the code
-       * simpler).
-       */
-      mutex_enter (session->lock);
+      session_table_insert (sessions, &session->key, session);
+      schedule_session (session);
 
       /* Run the "main" program. */
-      app_main (session);
+      init_step (&step, session, req);
+      step.app_main = app_main;
+      err = run_step (&step, do_app_main);
     }
 
-  if (! session->current_window)
+  if (err)
+    return abandon_request (session, req, pending, err);
+
+  if (! req->current_window)
     {
+      end_action (session, pending);
+      session_leave (session, req);
       return bad_request_error (rq, "no current window");
     }
 
+  /* Paint the window into a buffer, so that we know how long the
+   * page is before we send the headers.
+   */
+  if (!http_request_is_HEAD (http_request))
+    {
+      out = new_ml_output (thread_pool);
+
+      /* If this request was coalesced with an identical one, send the
+       * page which that request painted, if we can.
+       */
+      if (!shared || !use_shared_page (session, req, shared, out))
+	{
+	  init_step (&step, session, req);
+	  step.out = out;
+	  err = run_step (&step, do_repaint);
+	  if (err)
+	    return abandon_request (session, req, pending, err);
+
+	  if (pending && pending->nr_followers > 0)
+	    share_page (pending, req, out);
+	}
+    }
+
+  /* Compress the page if the browser can cope with it, and if it's
+   * big enough to be worth it.
+   */
+  level = ml_cfg_get_int (session, "monolith compression level",
+			  COMPRESSION_LEVEL);
+  if (out && level > 0)
+    {
+      threshold = ml_cfg_get_int (session, "monolith compression threshold",
+				  COMPRESSION_THRESHOLD);
+      if (ml_output_size (out) >= threshold)
+	encoding = choose_encoding (thread_pool, http_request);
+    }
+
+  /* If the window may be cached, then the ETag is a checksum of the
+   * page. If the browser already has this page, it doesn't need it
+   * again. Compressed and uncompressed pages are different entities,
+   * so they need different ETags.
+   */
+  if (out &&
+      ml_window_get_cacheable (req->current_window) &&
+      _ml_window_get_response_code (req->current_window) == 200 &&
+      http_request_method (http_request) == HTTP_METHOD_GET)
+    {
+      checksum = ml_output_checksum (out, thread_pool);
+      etag = make_etag (thread_pool, checksum, encoding);
+
+      if_none_match = http_request_get_header (http_request, "If-None-Match");
+      if (if_none_match && etag_matches (thread_pool, if_none_match, etag))
+	{
+	  nr_not_modified++;
+	  bytes_not_modified += ml_output_size (out);
+	  out = 0;
+	  not_modified = 1;
+	}
+    }
+
+  if (out && encoding &&
+      ml_output_compress (out, encoding, level > 9 ? 9 : level) == -1)
+    {
+      encoding = 0;
+      if (etag) etag = make_etag (thread_pool, checksum, encoding);
+    }
+
   /* Begin the response. */
-  http_response = new_http_response
-    (thread_pool, http_request, io,
-     _ml_window_get_response_code (session->current_window),
-     _ml_window_get_response_name (session->current_window));
+  if (not_modified)
+    http_response = new_http_response (thread_pool, http_request, io,
+				       304, "Not Modified");
+  else
+    http_response = new_http_response
+      (thread_pool, http_request, io,
+       _ml_window_get_response_code (req->current_window),
+       _ml_window_get_response_name (req->current_window));
 
-  http_response_send_headers (http_response,
-			      /* Send headers to defeat caching. */
-			      NO_CACHE_HEADERS,
-			      /* End of headers. */
-			      NULL);
+  if (etag)
+    {
+      http_response_send_headers (http_response,
+				  /* Browser must check with us each time. */
+				  CACHEABLE_HEADERS,
+				  "ETag", etag,
+				  /* End of headers. */
+				  NULL);
+    }
+  else
+    {
+      http_response_send_headers (http_response,
+				  /* Send headers to defeat caching. */
+				  NO_CACHE_HEADERS,
+				  /* End of headers. */
+				  NULL);
+    }
 
   /* Send the session cookie if necessary. */
   if (send_sessionid)
@@ -501,93 +1494,354 @@ ml_entry_point (rws_request rq, void (*app_main) (ml_session))
     }
 
   /* Send the auth cookie if necessary. */
-  if (session->auth_cookie)
+  if (req->auth_cookie)
     {
       http_response_send_header (http_response,
 				 "Set-Cookie",
 				 psprintf (thread_pool,
 					   "ml_auth=%s; path=%s; expires=%s",
-					   session->auth_cookie,
-					   session->auth_cookie_path
+					   req->auth_cookie,
+					   req->auth_cookie_path
 					   ? : canonical_path,
-					   session->auth_cookie_expires
+					   req->auth_cookie_expires
 					   ? : ""));
-
-      session->auth_cookie = 0;
     }
 
   /* Send any additional headers required by the current window. */
-  _ml_window_send_headers (session->current_window, thread_pool,
+  _ml_window_send_headers (req->current_window, thread_pool,
 			   http_response);
 
-  close = http_response_end_headers (http_response);
+  /* The page we send depends on Accept-Encoding, so caches must not
+   * give a compressed page to a browser which didn't ask for one.
+   */
+  if (level > 0)
+    http_response_send_header (http_response, "Vary", "Accept-Encoding");
+  if (encoding)
+    http_response_send_header (http_response,
+			       "Content-Encoding",
+			       encoding == ML_OUTPUT_GZIP ? "gzip" : "deflate");
+
+  if (out)
+    http_response_send_header (http_response,
+			       "Content-Length",
+			       pitoa (thread_pool, ml_output_size (out)));
 
-  if (!http_request_is_HEAD (http_request))
-    {
-      /* Display the main window. */
-      _ml_window_repaint (session->current_window, session, io);
-    }
+  close = http_response_end_headers (http_response);
 
-  /* XXX We might need to recover database handles here, particularly
-   * if we implement chunked encoding, and we start to process many
-   * requests over the same connection.
+  /* Give back any database handles which the application or widgets
+   * are still holding, so that another request can use them while
+   * this thread finishes off the connection.
    */
+  recover_request_dbhs (req);
+
+  /* Identical requests arriving from now on must run the action again. */
+  end_action (session, pending);
+
+  /* Discard any transient windows which haven't been used for a while. */
+  if (req->lock_mode == LOCK_EXCLUSIVE)
+    retire_windows (session, req);
+
+  /* Update the memory accounting for this session. */
+  account_session (session);
 
   /* Free the session lock. */
-  mutex_leave (session->lock);
+  session_leave (session, req);
+
+  /* Send the page. The buffer doesn't refer to anything in the session,
+   * so we don't need to hold the lock while a slow browser reads it.
+   * If the browser has gone away, there's no point keeping the
+   * connection open.
+   */
+  if (out && ml_output_send (out, io) == -1)
+    close = 1;
 
   return close;
 }
 
-/* Delete a session.
- *
- * Killing a session is a non-trivial task, because we must make sure
- * at all costs that no other thread is using the session structure, or
- * might be waiting on the mutex to enter the session.
- *
- * The procedure is as follows. If any step fails, then we need to go
- * back round to the top and try again. Eventually this function will
- * delete the session.
- *
- * - Acquire the mutex.
- * - Check if any other threads are waiting to enter the mutex.
- * - If none, then remove the session from the sessions hash (this ensures
- *   that no other thread will try to use the session - particularly
- *   important if the session deletion is protracted and involves I/O).
- * - Release the mutex (no other thread will try to acquire it).
- * - Delete the session pool, which invokes any session finalisers.
+/* The signature of a request is the list of all its parameters (which
+ * includes ml_action and ml_window). Each value is prefixed by its
+ * length so that different requests cannot have the same signature.
  */
-static void
-kill_session (const char *sessionid)
+static const char *
+request_signature (pool pool, cgi cgi)
 {
-  ml_session session;
-
-  /* Get the session structure. */
-  if (!shash_get (sessions, sessionid, session))
-    return;			/* No such session - ignore it. */
-
- again:
-  /* Acquire the session lock. */
-  mutex_enter (session->lock);
+  vector names = cgi_params (cgi), values, strs;
+  const char *name, *value;
+  int i, j;
 
-  /* Any other threads waiting to enter the mutex? */
-  if (mutex_nr_sleepers (session->lock) > 0)
+  strs = new_vector (pool, const char *);
+  for (i = 0; i < vector_size (names); ++i)
     {
-      /* Release the lock and try again later. */
-      mutex_leave (session->lock);
-      pth_millisleep (100);	/* To be on the safe side ... */
-      goto again;
+      vector_get (names, i, name);
+      values = cgi_param_list (cgi, name);
+      for (j = 0; j < vector_size (values); ++j)
+	{
+	  vector_get (values, j, value);
+	  value = psprintf (pool, "%s=%d:%s", name, (int) strlen (value), value);
+	  vector_push_back (strs, value);
+	}
     }
 
-  /* Remove the session from the list of sessions. After this, no
-   * other threads can find or enter this session.
+  return pjoin (pool, strs, "&");
+}
+
+static void
+release_action (void *vpending)
+{
+  struct pending_action *pending = (struct pending_action *) vpending;
+
+  if (--pending->refs == 0)
+    delete_pool (pending->pool);
+}
+
+/* The structure is kept until the thread pool of the request is
+ * deleted.
+ */
+static void
+hold_action (pool pool, struct pending_action *pending)
+{
+  pending->refs++;
+  pool_register_cleanup_fn (pool, release_action, pending);
+}
+
+/* Register an action request as in flight, or if an identical request
+ * is already in flight, set *follower and return that one instead.
+ * The signature is allocated in the (short-lived) thread pool of the
+ * first request, which must call end_action before it finishes.
+ */
+static struct pending_action *
+begin_action (ml_session session, pool pool, cgi cgi, int *follower)
+{
+  const char *signature = request_signature (pool, cgi);
+  struct pending_action *pending;
+  struct pool *p;
+  int i;
+
+  for (i = 0; i < vector_size (session->pending); ++i)
+    {
+      vector_get (session->pending, i, pending);
+      if (strcmp (pending->signature, signature) == 0)
+	{
+	  pending->nr_followers++;
+	  nr_requests_coalesced++;
+	  hold_action (pool, pending);
+	  *follower = 1;
+	  return pending;
+	}
+    }
+
+  p = new_subpool (ml_pool);
+  pending = pmalloc (p, sizeof *pending);
+  pending->pool = p;
+  pending->refs = 0;
+  pending->signature = signature;
+  pending->nr_followers = 0;
+  pending->windowid = 0;
+  pending->page = 0;
+  pending->page_len = 0;
+  hold_action (pool, pending);
+  vector_push_back (session->pending, pending);
+  *follower = 0;
+  return pending;
+}
+
+/* Keep a copy of the page painted by the first request, for the
+ * requests which were coalesced with it. They each need a copy of
+ * their own, since they may compress it differently.
+ */
+static void
+share_page (struct pending_action *pending, struct ml_request *req,
+	    ml_output out)
+{
+  pending->page_len = ml_output_size (out);
+  pending->page = pmalloc (pending->pool, pending->page_len);
+  ml_output_copy (out, 0, pending->page);
+  pending->windowid =
+    pstrdup (pending->pool, _ml_window_get_windowid (req->current_window));
+}
+
+/* Copy the page painted by the first request into out. The action may
+ * have changed the current window, so we send the same window as the
+ * first request did. Returns 0 if there is no page (the first request
+ * failed, or this request got the lock first), or if the window has
+ * gone since.
+ */
+static int
+use_shared_page (ml_session session, struct ml_request *req,
+		 struct pending_action *shared, ml_output out)
+{
+  ml_window w;
+
+  if (!shared->page ||
+      !shash_get (session->windows, shared->windowid, w))
+    return 0;
+
+  req->current_window = w;
+  _ml_window_touch (w);
+  ml_output_write (out, shared->page, shared->page_len);
+  nr_pages_shared++;
+  return 1;
+}
+
+static void
+end_action (ml_session session, struct pending_action *pending)
+{
+  struct pending_action *p;
+  int i;
+
+  if (!pending) return;
+
+  for (i = 0; i < vector_size (session->pending); ++i)
+    {
+      vector_get (session->pending, i, p);
+      if (p == pending)
+	{
+	  vector_erase (session->pending, i);
+	  return;
+	}
+    }
+}
+
+/* Check a form token and remember it. Returns 1 if the token has not
+ * been seen before, or 0 if it has (ie. the form has been submitted
+ * more than once). Tokens which don't parse are ignored.
+ */
+static int
+claim_token (ml_session session, const char *token)
+{
+  struct session_key key;
+  int i;
+
+  if (!session_key_parse (token, &key)) return 1;
+
+  for (i = 0; i < NR_USED_TOKENS; ++i)
+    if (session->used_tokens[i].hi == key.hi &&
+	session->used_tokens[i].lo == key.lo)
+      {
+	nr_duplicate_submits++;
+	return 0;
+      }
+
+  session->used_tokens[session->next_used_token] = key;
+  session->next_used_token =
+    (session->next_used_token + 1) % NR_USED_TOKENS;
+  return 1;
+}
+
+/* Acquire the session lock in the given mode, and register the request
+ * with the session. Returns 0 (without the lock) if the session was
+ * killed while we were waiting for it.
+ */
+static int
+session_enter (ml_session session, struct ml_request *req, int lock_mode)
+{
+  if (session->dead) return 0;
+
+  session->nr_users++;
+  vector_push_back (session->requests, req);
+
+  if (lock_mode == LOCK_EXCLUSIVE)
+    rwlock_enter_write (session->lock);
+  else
+    rwlock_enter_read (session->lock);
+  req->lock_mode = lock_mode;
+
+  if (session->dead)
+    {
+      session_leave (session, req);
+      return 0;
+    }
+  return 1;
+}
+
+/* Release the session lock. If the session is being killed and we are
+ * the last thread using it, hand off to kill_session.
+ */
+static void
+session_leave (ml_session session, struct ml_request *req)
+{
+  struct ml_request *r;
+  int i;
+
+  if (req->lock_mode != LOCK_NONE)
+    rwlock_leave (session->lock);
+  req->lock_mode = LOCK_NONE;
+
+  for (i = 0; i < vector_size (session->requests); ++i)
+    {
+      vector_get (session->requests, i, r);
+      if (r == req)
+	{
+	  vector_erase (session->requests, i);
+	  break;
+	}
+    }
+
+  if (--session->nr_users == 0 && session->dead)
+    wq_wake_up (session->teardown_wq);
+}
+
+/* Find the request being handled by the current thread, or NULL if
+ * the current thread isn't handling a request in this session.
+ */
+static struct ml_request *
+find_request (ml_session session)
+{
+  struct ml_request *req;
+  int i;
+
+  for (i = 0; i < vector_size (session->requests); ++i)
+    {
+      vector_get (session->requests, i, req);
+      if (req->pth == current_pth)
+	return req;
+    }
+
+  return 0;
+}
+
+/* Find the request being handled by the current thread. */
+static struct ml_request *
+current_request (ml_session session)
+{
+  struct ml_request *req = find_request (session);
+
+  /* Called from a thread which isn't handling a request in this session. */
+  if (!req) abort ();
+
+  return req;
+}
+
+/* Delete a session.
+ *
+ * We must make sure that no other thread is using the session structure
+ * when we delete it. The session is marked as dead and removed from the
+ * sessions table straight away, so no new requests can find it, and
+ * requests which are waiting for the lock give up when they get it.
+ * Then we wait for the remaining users to leave the session (the last
+ * one wakes us up) and delete the session pool, which invokes any
+ * session finalisers.
+ */
+static void
+kill_session (ml_session session)
+{
+  /* Already being killed by another thread? */
+  if (session->dead) return;
+
+  /* Mark the session as dead and remove it from the list of sessions.
+   * After this, no new threads can find or enter this session, and
+   * threads already waiting for the lock will give up when they get it.
    */
-  assert (shash_erase (sessions, sessionid));
+  session->dead = 1;
+  assert (session_table_erase (sessions, &session->key));
+  unschedule_session (session);
+  sessions_total_size -= session->size;
 
-  /* Release the lock. */
-  mutex_leave (session->lock);
+  /* Wait for threads which are using the session to finish. */
+  while (session->nr_users > 0)
+    wq_sleep_on (session->teardown_wq);
 
-  /* Finally, we can delete the thread. */
+  /* Finally, we can delete the session. */
   delete_pool (session->session_pool);
 }
 
@@ -651,7 +1905,7 @@ ml_session_get_peername (ml_session session,
 {
   int s;
 
-  s = io_fileno (session->io);
+  s = io_fileno (current_request (session)->io);
   return getpeername (s, name, namelen);
 }
 
@@ -671,21 +1925,130 @@ ml_session_get_peernamestr (ml_session session)
   return pstrdup (session->session_pool, inet_ntoa (addr.sin_addr));
 }
 
+/* The session IDs are returned in a stable order (sorted by key), so
+ * repeated calls list sessions in the same order.
+ */
 const vector
 _ml_get_sessions (pool pool)
 {
-  return shash_keys_in_pool (sessions, pool);
+  vector session_list, sessionids;
+  ml_session session;
+  int i;
+
+  session_list = session_table_values (sessions, pool);
+  sessionids = new_vector (pool, const char *);
+
+  for (i = 0; i < vector_size (session_list); ++i)
+    {
+      const char *sessionid;
+
+      vector_get (session_list, i, session);
+      sessionid = pstrdup (pool, session->sessionid);
+      vector_push_back (sessionids, sessionid);
+    }
+
+  return sessionids;
 }
 
 ml_session
 _ml_get_session (const char *sessionid)
 {
-  ml_session session;
+  struct session_key key;
 
-  if (shash_get (sessions, sessionid, session))
-    return session;
-  else
+  if (!session_key_parse (sessionid, &key))
     return 0;
+
+  return session_table_get (sessions, &key);
+}
+
+long long
+_ml_get_sessions_total_size ()
+{
+  return sessions_total_size;
+}
+
+long long
+_ml_get_sessions_memory_budget ()
+{
+  return sessions_memory_budget;
+}
+
+int
+_ml_get_session_max_size ()
+{
+  return session_max_size;
+}
+
+int
+_ml_get_nr_sessions_evicted ()
+{
+  return nr_sessions_evicted;
+}
+
+int
+_ml_get_nr_sessions_over_quota ()
+{
+  return nr_sessions_over_quota;
+}
+
+int
+_ml_get_nr_requests_coalesced ()
+{
+  return nr_requests_coalesced;
+}
+
+int
+_ml_get_nr_pages_shared ()
+{
+  return nr_pages_shared;
+}
+
+int
+_ml_get_nr_duplicate_submits ()
+{
+  return nr_duplicate_submits;
+}
+
+int
+_ml_get_nr_deadline_cancels ()
+{
+  return nr_deadline_cancels;
+}
+
+int
+_ml_get_nr_disconnect_cancels ()
+{
+  return nr_disconnect_cancels;
+}
+
+int
+_ml_get_nr_queries_cancelled ()
+{
+  return nr_queries_cancelled;
+}
+
+int
+_ml_get_nr_not_modified ()
+{
+  return nr_not_modified;
+}
+
+long long
+_ml_get_bytes_not_modified ()
+{
+  return bytes_not_modified;
+}
+
+int
+_ml_get_nr_windows_retired ()
+{
+  return nr_windows_retired;
+}
+
+long long
+_ml_get_windows_retired_size ()
+{
+  return windows_retired_size;
 }
 
 int
@@ -694,6 +2057,12 @@ _ml_session_get_hits (ml_session session)
   return session->hits;
 }
 
+int
+_ml_session_get_size (ml_session session)
+{
+  return session->size;
+}
+
 reactor_time_t
 _ml_session_get_last_access (ml_session session)
 {
@@ -738,236 +2107,1997 @@ _ml_session_get_window (ml_session session, const char *windowid)
 const vector
 _ml_session_get_actions (ml_session session, pool pool)
 {
-  return shash_keys_in_pool (session->actions, pool);
+  vector actionids = new_vector (pool, const char *);
+  const char *actionid;
+  int i;
+
+  for (i = 0; i < session->nr_actions; ++i)
+    if (session->actions[i]->callback_fn)
+      {
+	actionid = pstrdup (pool, session->actions[i]->id);
+	vector_push_back (actionids, actionid);
+      }
+
+  return actionids;
 }
 
 int
 _ml_session_get_action (ml_session session, const char *actionid,
 			void **fn_rtn, void **data_rtn)
 {
-  struct action action;
+  struct action *action = get_action (session, actionid);
 
-  if (shash_get (session->actions, actionid, action))
+  if (action)
     {
-      *fn_rtn = action.callback_fn;
-      *data_rtn = action.data;
+      *fn_rtn = action->callback_fn;
+      *data_rtn = action->data;
       return 1;
     }
   else
     return 0;
 }
 
-const vector
-_ml_session_get_dbhs (ml_session session, pool pool)
+const vector
+_ml_session_get_dbhs (ml_session session, pool pool)
+{
+  return hash_keys_in_pool (session->dbhs, pool);
+}
+
+ml_dbh_factory
+_ml_session_get_auth_dbf (ml_session session)
+{
+  return session->auth_dbf;
+}
+
+const vector
+_ml_get_dbh_factories (pool pool)
+{
+  return shash_keys_in_pool (dbh_factories, pool);
+}
+
+ml_dbh_factory
+_ml_get_dbh_factory (const char *conninfo)
+{
+  ml_dbh_factory dbf;
+
+  if (shash_get (dbh_factories, conninfo, dbf))
+    return dbf;
+  else
+    return 0;
+}
+
+int
+_ml_dbh_factory_get_nr_allocated_handles (ml_dbh_factory dbf)
+{
+  return dbf->allocated;
+}
+
+int
+_ml_dbh_factory_get_nr_free_handles (ml_dbh_factory dbf)
+{
+  return vector_size (dbf->free_handles);
+}
+
+int
+_ml_dbh_factory_get_max_handles (ml_dbh_factory dbf)
+{
+  return dbf->max_handles;
+}
+
+int
+_ml_dbh_factory_get_min_handles (ml_dbh_factory dbf)
+{
+  return dbf->min_handles;
+}
+
+int
+_ml_dbh_factory_get_nr_waiters (ml_dbh_factory dbf)
+{
+  return vector_size (dbf->waiters);
+}
+
+int
+_ml_dbh_factory_get_nr_reaped (ml_dbh_factory dbf)
+{
+  return dbf->nr_reaped;
+}
+
+int
+_ml_dbh_factory_get_nr_dead (ml_dbh_factory dbf)
+{
+  return dbf->nr_dead;
+}
+
+const vector
+_ml_dbh_factory_get_replicas (ml_dbh_factory dbf, pool pool)
+{
+  return copy_vector (pool, dbf->replicas);
+}
+
+const char *
+_ml_dbh_factory_get_conninfo (ml_dbh_factory dbf)
+{
+  return dbf->conninfo;
+}
+
+int
+_ml_dbh_factory_get_nr_replica_reads (ml_dbh_factory dbf)
+{
+  return dbf->nr_replica_reads;
+}
+
+int
+_ml_dbh_factory_get_nr_replica_failures (ml_dbh_factory dbf)
+{
+  return dbf->nr_replica_failures;
+}
+
+int
+_ml_dbh_factory_is_down (ml_dbh_factory dbf)
+{
+  return reactor_time < dbf->down_until;
+}
+
+int
+_ml_dbh_factory_get_nr_rollbacks (ml_dbh_factory dbf)
+{
+  return dbf->nr_rollbacks;
+}
+
+int
+_ml_dbh_factory_get_nr_rollbacks_skipped (ml_dbh_factory dbf)
+{
+  return dbf->nr_rollbacks_skipped;
+}
+
+/* The factory is busy if a thread asking for a handle would have to wait. */
+int
+_ml_dbh_factory_is_busy (ml_dbh_factory dbf)
+{
+  return vector_size (dbf->free_handles) == 0 &&
+    dbf->max_handles > 0 && dbf->allocated >= dbf->max_handles;
+}
+
+ml_dbh_factory
+_ml_statement_get_factory (ml_statement stmt)
+{
+  return stmt->dbf;
+}
+
+const vector
+_ml_dbh_factory_get_statements (ml_dbh_factory dbf, pool pool)
+{
+  return copy_vector (pool, dbf->statements);
+}
+
+const char *
+_ml_statement_get_query (ml_statement stmt)
+{
+  return stmt->query;
+}
+
+int
+_ml_statement_get_nr_prepares (ml_statement stmt)
+{
+  return stmt->nr_prepares;
+}
+
+int
+_ml_statement_get_nr_executes (ml_statement stmt)
+{
+  return stmt->nr_executes;
+}
+
+int
+_ml_dbh_factory_get_nr_waits (ml_dbh_factory dbf, int bucket)
+{
+  if (bucket < 0 || bucket >= NR_DBH_WAIT_BUCKETS) return 0;
+  return dbf->nr_waits[bucket];
+}
+
+void
+ml_session_release_lock (ml_session session)
+{
+  struct ml_request *req = current_request (session);
+
+  rwlock_leave (session->lock);
+  req->lock_mode = LOCK_NONE;
+}
+
+void
+ml_session_acquire_lock (ml_session session)
+{
+  struct ml_request *req = current_request (session);
+
+  rwlock_enter_write (session->lock);
+  req->lock_mode = LOCK_EXCLUSIVE;
+
+  /* We've probably been sleeping for a while, so update the last access
+   * time to reflect this.
+   */
+  session->last_access = reactor_time;
+  schedule_session (session);
+}
+
+void
+ml_session_begin_update (ml_session session)
+{
+  struct ml_request *req = current_request (session);
+
+  if (req->nr_updates++ > 0) return;
+
+  /* There is no way to upgrade a read lock in place, so drop it and
+   * wait for exclusive access.
+   */
+  if (req->lock_mode == LOCK_SHARED)
+    {
+      rwlock_leave (session->lock);
+      rwlock_enter_write (session->lock);
+      req->lock_mode = LOCK_EXCLUSIVE;
+      req->upgraded = 1;
+    }
+}
+
+void
+ml_session_end_update (ml_session session)
+{
+  struct ml_request *req = current_request (session);
+
+  assert (req->nr_updates > 0);
+  if (--req->nr_updates > 0) return;
+
+  if (req->upgraded)
+    {
+      rwlock_leave (session->lock);
+      rwlock_enter_read (session->lock);
+      req->lock_mode = LOCK_SHARED;
+      req->upgraded = 0;
+    }
+}
+
+void *
+ml_scratch_alloc (ml_session session, int n)
+{
+  struct ml_request *req = current_request (session);
+
+  /* The scratch arena is freed along with the thread pool when the
+   * request finishes.
+   */
+  if (!req->scratch)
+    req->scratch = new_scratch (pth_get_pool (req->pth));
+
+  return scratch_alloc (req->scratch, n);
+}
+
+char *
+ml_scratch_sprintf (ml_session session, const char *fs, ...)
+{
+  struct ml_request *req = current_request (session);
+  va_list args;
+  char *str;
+
+  if (!req->scratch)
+    req->scratch = new_scratch (pth_get_pool (req->pth));
+
+  va_start (args, fs);
+  str = scratch_vsprintf (req->scratch, fs, args);
+  va_end (args);
+
+  return str;
+}
+
+cgi
+_ml_session_submitted_args (ml_session session)
+{
+  return current_request (session)->submitted_args;
+}
+
+static void dbh_reaper (void *);
+static void prepare_statements (struct factory_dbh *fdbh);
+static struct factory_dbh *open_dbh (ml_dbh_factory dbf);
+static void release_dbh (ml_dbh_factory dbf, struct factory_dbh *fdbh);
+
+static ml_dbh_factory
+create_factory (const char *conninfo)
+{
+  pool dbf_pool = new_subpool (ml_pool);
+  ml_dbh_factory dbf;
+
+  dbf = pmalloc (dbf_pool, sizeof *dbf);
+  dbf->pool = dbf_pool;
+  dbf->conninfo = pstrdup (dbf_pool, conninfo);
+  dbf->allocated = 0;
+  dbf->max_handles = DBH_MAX_HANDLES;
+  dbf->min_handles = DBH_MIN_HANDLES;
+  dbf->max_idle = DBH_MAX_IDLE;
+  dbf->free_handles = new_vector (dbf_pool, struct factory_dbh *);
+  dbf->waiters = new_vector (dbf_pool, struct dbh_waiter *);
+  memset (dbf->nr_waits, 0, sizeof dbf->nr_waits);
+  dbf->nr_reaped = 0;
+  dbf->nr_dead = 0;
+  dbf->nr_rollbacks = 0;
+  dbf->nr_rollbacks_skipped = 0;
+  dbf->statements = new_vector (dbf_pool, ml_statement);
+  dbf->statements_by_query = new_shash (dbf_pool, ml_statement);
+  dbf->primary = 0;
+  dbf->replicas = new_vector (dbf_pool, ml_dbh_factory);
+  dbf->replica_lag = DBH_REPLICA_LAG;
+  dbf->statement_timeout = 0;
+  dbf->last_write = 0;
+  dbf->down_until = 0;
+  dbf->nr_replica_reads = 0;
+  dbf->nr_replica_failures = 0;
+
+  /* Start the thread which closes idle handles. */
+  if (!dbh_reaper_pth)
+    {
+      dbh_reaper_pth = new_pseudothread (ml_pool, dbh_reaper, 0,
+					 "monolith dbh reaper");
+      pth_start (dbh_reaper_pth);
+    }
+
+  return dbf;
+}
+
+/* Open the minimum number of handles now, so that the first requests
+ * don't have to wait for the connections to be made.
+ */
+static void
+warm_factory (ml_dbh_factory dbf)
+{
+  struct factory_dbh *fdbh;
+
+  while (dbf->allocated < dbf->min_handles)
+    {
+      fdbh = open_dbh (dbf);
+      if (!fdbh) break;
+      release_dbh (dbf, fdbh);
+    }
+}
+
+ml_dbh_factory
+new_ml_dbh_factory (ml_session session, const char *conninfo)
+{
+  ml_dbh_factory dbf, replica;
+  int i;
+
+  if (!shash_get (dbh_factories, conninfo, dbf))
+    {
+      dbf = create_factory (conninfo);
+      shash_insert (dbh_factories, conninfo, dbf);
+    }
+
+  /* Factories are shared by every application which uses the same
+   * database, so the settings come from whichever configuration file
+   * created a factory most recently.
+   */
+  dbf->max_handles = ml_cfg_get_int (session, "monolith dbh max handles",
+				     DBH_MAX_HANDLES);
+  dbf->min_handles = ml_cfg_get_int (session, "monolith dbh min handles",
+				     DBH_MIN_HANDLES);
+  dbf->max_idle = ml_cfg_get_int (session, "monolith dbh max idle",
+				  DBH_MAX_IDLE);
+  dbf->replica_lag = ml_cfg_get_int (session, "monolith dbh replica lag",
+				     DBH_REPLICA_LAG);
+  dbf->statement_timeout =
+    ml_cfg_get_int (session, "monolith request deadline", 0);
+  if (dbf->statement_timeout < 0)
+    dbf->statement_timeout = 0;
+  if (dbf->max_handles > 0 && dbf->min_handles > dbf->max_handles)
+    dbf->min_handles = dbf->max_handles;
+
+  warm_factory (dbf);
+
+  /* Replicas have the same settings as their primary. */
+  for (i = 0; i < vector_size (dbf->replicas); ++i)
+    {
+      vector_get (dbf->replicas, i, replica);
+      replica->max_handles = dbf->max_handles;
+      replica->min_handles = dbf->min_handles;
+      replica->max_idle = dbf->max_idle;
+      replica->statement_timeout = dbf->statement_timeout;
+    }
+
+  return dbf;
+}
+
+void
+ml_dbh_factory_add_replica (ml_dbh_factory dbf, const char *conninfo)
+{
+  ml_dbh_factory replica;
+  int i;
+
+  for (i = 0; i < vector_size (dbf->replicas); ++i)
+    {
+      vector_get (dbf->replicas, i, replica);
+      if (strcmp (replica->conninfo, conninfo) == 0)
+	return;
+    }
+
+  replica = create_factory (conninfo);
+  replica->primary = dbf;
+  replica->max_handles = dbf->max_handles;
+  replica->min_handles = dbf->min_handles;
+  replica->max_idle = dbf->max_idle;
+
+  /* Share the statements with the primary, so that statements which
+   * are registered on the primary are also prepared on the replica.
+   */
+  replica->statements = dbf->statements;
+  replica->statements_by_query = dbf->statements_by_query;
+
+  vector_push_back (dbf->replicas, replica);
+
+  warm_factory (replica);
+}
+
+static void
+connect_dbh (void *vfdbh)
+{
+  struct factory_dbh *fdbh = (struct factory_dbh *) vfdbh;
+  st_handle sth;
+
+  fdbh->dbh = new_db_handle (fdbh->pool,
+			     fdbh->dbf->conninfo, DBI_THROW_ERRORS);
+
+  /* Remember which server process we are talking to, so that we can
+   * ask the server to cancel its query (see watch_request).
+   */
+  sth = st_prepare_cached (fdbh->dbh, "select pg_backend_pid ()");
+  st_execute (sth);
+  st_bind (sth, 0, fdbh->backend_pid, DBI_INT);
+  st_fetch (sth);
+  db_rollback (fdbh->dbh);
+}
+
+/* Open a new handle. Returns NULL if we couldn't connect.
+ *
+ * Note here that the handle's pool is a subpool of dbf->pool, which is
+ * a subpool of ml_pool, so when we free up ml_pool, we will close the
+ * connections.
+ */
+static struct factory_dbh *
+open_dbh (ml_dbh_factory dbf)
+{
+  pool pool = new_subpool (dbf->pool);
+  struct factory_dbh *fdbh;
+
+  fdbh = pmalloc (pool, sizeof *fdbh);
+  fdbh->pool = pool;
+  fdbh->dbf = dbf;
+  fdbh->dbh = 0;
+  fdbh->last_used = reactor_time;
+  fdbh->readonly = 0;
+  fdbh->statement_timeout = 0;
+  fdbh->backend_pid = 0;
+  fdbh->sths = new_vector (pool, st_handle);
+
+  /* Connecting blocks, so count the handle first to stop other threads
+   * from going over the limit in the meantime.
+   */
+  dbf->allocated++;
+  if (pth_catch (connect_dbh, fdbh) || !fdbh->dbh)
+    {
+      delete_pool (pool);
+      dbf->allocated--;
+      return 0;
+    }
+  hash_insert (dbh_handles, fdbh->dbh, fdbh);
+
+  /* Prepare the registered statements now, rather than when a user's
+   * request first needs them.
+   */
+  prepare_statements (fdbh);
+
+  return fdbh;
+}
+
+/* Close a handle which is not on the free list. */
+static void
+close_dbh (ml_dbh_factory dbf, struct factory_dbh *fdbh)
+{
+  hash_erase (dbh_handles, fdbh->dbh);
+  delete_pool (fdbh->pool);
+  dbf->allocated--;
+}
+
+static void
+ping_dbh (void *vdbh)
+{
+  db_handle dbh = (db_handle) vdbh;
+  st_handle sth;
+
+  sth = st_prepare_cached (dbh, "select 1");
+  st_execute (sth);
+  db_rollback (dbh);
+}
+
+/* Check that the connection is still working. */
+static inline int
+dbh_is_alive (struct factory_dbh *fdbh)
+{
+  return pth_catch (ping_dbh, fdbh->dbh) == 0;
+}
+
+static void
+set_read_only (void *vdbh)
+{
+  db_handle dbh = (db_handle) vdbh;
+  st_handle sth;
+
+  sth = st_prepare_cached
+    (dbh,
+     "set session characteristics as transaction read only");
+  st_execute (sth);
+  db_commit (dbh);
+}
+
+static void
+set_read_write (void *vdbh)
+{
+  db_handle dbh = (db_handle) vdbh;
+  st_handle sth;
+
+  sth = st_prepare_cached
+    (dbh,
+     "set session characteristics as transaction read write");
+  st_execute (sth);
+  db_commit (dbh);
+}
+
+/* Put the connection into read only or read write mode, if it isn't
+ * in that mode already. Returns 0 if the connection has died.
+ */
+static int
+set_dbh_mode (struct factory_dbh *fdbh, int readonly)
+{
+  if (fdbh->readonly == readonly) return 1;
+
+  if (pth_catch (readonly ? set_read_only : set_read_write, fdbh->dbh))
+    return 0;
+  fdbh->readonly = readonly;
+  return 1;
+}
+
+struct statement_timeout_args
+{
+  db_handle dbh;
+  int timeout;
+};
+
+static void
+do_set_statement_timeout (void *vargs)
+{
+  struct statement_timeout_args *args =
+    (struct statement_timeout_args *) vargs;
+  st_handle sth;
+
+  /* (SET doesn't take placeholders, but set_config does.) */
+  sth = st_prepare_cached
+    (args->dbh,
+     "select set_config ('statement_timeout', ?, false)", DBI_STRING);
+  st_execute (sth, pitoa (pth_get_pool (current_pth), args->timeout * 1000));
+  db_commit (args->dbh);
+}
+
+/* Set the statement_timeout on the connection (in seconds, 0 meaning
+ * no timeout), if it isn't set to that already. Returns 0 if the
+ * connection has died.
+ */
+static int
+set_statement_timeout (struct factory_dbh *fdbh, int timeout)
+{
+  struct statement_timeout_args args;
+
+  if (fdbh->statement_timeout == timeout) return 1;
+
+  args.dbh = fdbh->dbh;
+  args.timeout = timeout;
+  if (pth_catch (do_set_statement_timeout, &args))
+    return 0;
+  fdbh->statement_timeout = timeout;
+  return 1;
+}
+
+/* Pass a handle to the first thread in the queue. If fdbh is NULL, the
+ * thread is told to try again. Returns 0 if no thread is waiting.
+ */
+static int
+wake_first_waiter (ml_dbh_factory dbf, struct factory_dbh *fdbh)
+{
+  struct dbh_waiter *waiter;
+
+  if (vector_size (dbf->waiters) == 0) return 0;
+
+  vector_get (dbf->waiters, 0, waiter);
+  vector_erase (dbf->waiters, 0);
+  waiter->queued = 0;
+  waiter->fdbh = fdbh;
+  wq_wake_up_one (waiter->wq);
+  return 1;
+}
+
+static void
+wake_waiter (void *vwaiter)
+{
+  struct dbh_waiter *waiter = (struct dbh_waiter *) vwaiter;
+
+  waiter->timer = 0;
+  wq_wake_up_one (waiter->wq);
+}
+
+/* Take a waiter out of the queue, when it gives up waiting. */
+static void
+remove_waiter (ml_dbh_factory dbf, struct dbh_waiter *waiter)
+{
+  struct dbh_waiter *w;
+  int i;
+
+  for (i = 0; i < vector_size (dbf->waiters); ++i)
+    {
+      vector_get (dbf->waiters, i, w);
+      if (w == waiter)
+	{
+	  vector_erase (dbf->waiters, i);
+	  break;
+	}
+    }
+  waiter->queued = 0;
+}
+
+/* Give a handle back to the factory. */
+static void
+release_dbh (ml_dbh_factory dbf, struct factory_dbh *fdbh)
+{
+  fdbh->last_used = reactor_time;
+
+  if (!wake_first_waiter (dbf, fdbh))
+    vector_push_back (dbf->free_handles, fdbh);
+}
+
+static inline void
+record_wait (ml_dbh_factory dbf, reactor_time_t start)
+{
+  reactor_time_t waited = reactor_time - start, limit = 1;
+  int i = 0;
+
+  if (waited > 0)
+    for (i = 1; i < NR_DBH_WAIT_BUCKETS - 1; ++i)
+      {
+	limit *= 10;
+	if (waited < limit) break;
+      }
+
+  dbf->nr_waits[i]++;
+}
+
+struct recover_dbh_args
+{
+  ml_session session;
+  struct ml_request *req;	/* Request holding the handle, or NULL. */
+  struct factory_dbh *fdbh;
+};
+
+static void recover_dbh (void *vargs);
+static void watch_request (void *vreq);
+
+/* Take a handle off the free list. We prefer the most recently used
+ * handle which is already in the right mode, so that the others can be
+ * closed if they stay idle, and so that we don't have to keep switching
+ * connections between read only and read write.
+ */
+static struct factory_dbh *
+pop_free_dbh (ml_dbh_factory dbf, int readonly)
+{
+  struct factory_dbh *fdbh;
+  int i;
+
+  for (i = vector_size (dbf->free_handles) - 1; i >= 0; --i)
+    {
+      vector_get (dbf->free_handles, i, fdbh);
+      if (fdbh->readonly == readonly)
+	{
+	  vector_erase (dbf->free_handles, i);
+	  return fdbh;
+	}
+    }
+
+  vector_pop_back (dbf->free_handles, fdbh);
+  return fdbh;
+}
+
+static db_handle
+get_dbh (ml_session session, ml_dbh_factory dbf, int readonly)
+{
+  pool thread_pool = pth_get_pool (current_pth);
+  reactor_time_t start = reactor_time;
+  struct factory_dbh *fdbh;
+  struct dbh_waiter *waiter;
+  struct ml_request *req;
+  struct recover_dbh_args *args;
+  pool pool;
+
+  /* Don't start on more database work if the request is being abandoned.
+   * (Background threads which aren't working for any session pass NULL
+   * as the session.)
+   */
+  req = session ? find_request (session) : 0;
+  if (req) check_request (req);
+
+ again:
+  /* If a free handle is available in the factory, grab it. */
+  if (vector_size (dbf->free_handles) > 0)
+    {
+      fdbh = pop_free_dbh (dbf, readonly);
+
+      if (reactor_time - fdbh->last_used >= DBH_CHECK_AFTER * 1000LL &&
+	  !dbh_is_alive (fdbh))
+	{
+	  close_dbh (dbf, fdbh);
+	  dbf->nr_dead++;
+	  goto again;
+	}
+    }
+  /* Else allocate one, if we are allowed to. */
+  else if (dbf->max_handles <= 0 || dbf->allocated < dbf->max_handles)
+    {
+      fdbh = open_dbh (dbf);
+      if (!fdbh)
+	{
+	  /* Let a waiting thread have a go at connecting instead. */
+	  wake_first_waiter (dbf, 0);
+	  pth_die (dbf->conninfo);
+	}
+    }
+  /* Else wait in the queue until another thread gives back a handle.
+   * A request which is waiting wakes up from time to time, and leaves
+   * the queue if it has reached its deadline or the browser has gone
+   * away. (Otherwise, if all the handles were held by threads which are
+   * themselves waiting, it could wait forever.)
+   */
+  else
+    {
+      pool = new_subpool (thread_pool);
+      waiter = pmalloc (pool, sizeof *waiter);
+      waiter->wq = new_wait_queue (pool);
+      waiter->queued = 1;
+      waiter->fdbh = 0;
+      waiter->timer = 0;
+      vector_push_back (dbf->waiters, waiter);
+
+      for (;;)
+	{
+	  if (req && req->cancellable)
+	    waiter->timer = reactor_set_timer (pool, wait_interval (req),
+					       wake_waiter, waiter);
+
+	  wq_sleep_on (waiter->wq);
+
+	  if (waiter->timer)
+	    {
+	      reactor_unset_timer_early (waiter->timer);
+	      waiter->timer = 0;
+	    }
+	  if (!waiter->queued) break;
+
+	  /* Woken by the timer. */
+	  if (request_cancelled (req))
+	    {
+	      remove_waiter (dbf, waiter);
+	      delete_pool (pool);
+	      record_wait (dbf, start);
+	      check_request (req);
+	    }
+	}
+
+      fdbh = waiter->fdbh;
+      delete_pool (pool);
+      if (!fdbh) goto again;
+    }
+
+  if (!set_dbh_mode (fdbh, readonly))
+    {
+      close_dbh (dbf, fdbh);
+      dbf->nr_dead++;
+      goto again;
+    }
+
+  /* Have the server cancel any query which runs for longer than a
+   * whole request is allowed to. This is the same for every borrower
+   * (including background threads), so the handle only needs resetting
+   * when the configuration changes. A query started near the end of a
+   * request can run past the request's deadline, but the request is
+   * abandoned as soon as the query returns.
+   */
+  if (!set_statement_timeout (fdbh, dbf->statement_timeout))
+    {
+      close_dbh (dbf, fdbh);
+      dbf->nr_dead++;
+      goto again;
+    }
+
+  /* Prepare any statements registered since the handle was opened. */
+  if (vector_size (fdbh->sths) < vector_size (dbf->statements))
+    prepare_statements (fdbh);
+
+  record_wait (dbf, start);
+
+  /* Allocate a pool to this handle, as a subpool of the request (or
+   * thread) pool, so if the request finishes without giving up the
+   * handle, we get it back.
+   */
+  if (req)
+    {
+      if (!req->dbh_pool)
+	{
+	  req->dbh_pool = new_subpool (thread_pool);
+	  req->dbhs = new_vector (req->dbh_pool, struct factory_dbh *);
+	}
+      pool = new_subpool (req->dbh_pool);
+      vector_push_back (req->dbhs, fdbh);
+
+      /* While an action or repaint holds handles, check now and again
+       * whether it should be abandoned, in case it is stuck in a query.
+       */
+      if (req->cancellable && !req->watch)
+	req->watch = reactor_set_timer (req->dbh_pool, DBH_WATCH_INTERVAL,
+					watch_request, req);
+    }
+  else
+    pool = new_subpool (thread_pool);
+  args = pmalloc (pool, sizeof *args);
+  args->session = session;
+  args->req = req;
+  args->fdbh = fdbh;
+  pool_register_cleanup_fn (pool, recover_dbh, args);
+  if (session)
+    hash_insert (session->dbhs, fdbh->dbh, pool);
+
+  return fdbh->dbh;
+}
+
+db_handle
+ml_get_dbh (ml_session session, ml_dbh_factory dbf)
+{
+  return get_dbh (session, dbf, 0);
+}
+
+/* Choose the replica with the fewest handles in use (counting threads
+ * waiting for handles too), skipping any which have failed recently.
+ */
+static ml_dbh_factory
+choose_replica (ml_dbh_factory dbf)
+{
+  ml_dbh_factory replica, best = 0;
+  int i, load, best_load = 0;
+
+  for (i = 0; i < vector_size (dbf->replicas); ++i)
+    {
+      vector_get (dbf->replicas, i, replica);
+      if (reactor_time < replica->down_until) continue;
+
+      load = replica->allocated - vector_size (replica->free_handles)
+	+ vector_size (replica->waiters);
+      if (!best || load < best_load)
+	{
+	  best = replica;
+	  best_load = load;
+	}
+    }
+
+  return best;
+}
+
+struct get_replica_dbh_args
+{
+  ml_session session;
+  ml_dbh_factory replica;
+  db_handle dbh;
+};
+
+static void
+get_replica_dbh (void *vargs)
+{
+  struct get_replica_dbh_args *args = (struct get_replica_dbh_args *) vargs;
+
+  args->dbh = get_dbh (args->session, args->replica, 1);
+}
+
+db_handle
+ml_get_dbh_readonly (ml_session session, ml_dbh_factory dbf)
+{
+  struct get_replica_dbh_args args;
+  struct ml_request *req;
+
+  /* Check this here, or an abandoned request would look like a
+   * replica failing below.
+   */
+  req = find_request (session);
+  if (req) check_request (req);
+
+  /* Send reads to the replicas, unless something has been written to
+   * the primary very recently, in which case the replicas might not
+   * have caught up yet.
+   */
+  if (vector_size (dbf->replicas) > 0 &&
+      reactor_time >= dbf->last_write + dbf->replica_lag * 1000LL)
+    {
+      args.session = session;
+      while ((args.replica = choose_replica (dbf)) != 0)
+	{
+	  if (pth_catch (get_replica_dbh, &args) == 0)
+	    {
+	      dbf->nr_replica_reads++;
+	      return args.dbh;
+	    }
+
+	  /* Couldn't connect to the replica: try another, or fall back
+	   * to the primary.
+	   */
+	  args.replica->down_until =
+	    reactor_time + DBH_REPLICA_RETRY * 1000LL;
+	  dbf->nr_replica_failures++;
+	}
+    }
+
+  return get_dbh (session, dbf, 1);
+}
+
+void
+ml_put_dbh (ml_session session, db_handle dbh)
+{
+  pool pool;
+
+  /* If this fails, then it's likely that they're trying to 'put' a
+   * database handle which they don't own, or 'put'ting a handle twice.
+   */
+  assert (hash_get (session->dbhs, dbh, pool));
+
+  /* This calls recover_dbh. */
+  delete_pool (pool);
+}
+
+static void
+recover_dbh (void *vargs)
+{
+  struct recover_dbh_args *args = (struct recover_dbh_args *) vargs;
+  struct factory_dbh *fdbh = args->fdbh, *f;
+  int i;
+
+  if (args->session)
+    assert (hash_erase (args->session->dbhs, fdbh->dbh));
+
+  if (args->req)
+    for (i = 0; i < vector_size (args->req->dbhs); ++i)
+      {
+	vector_get (args->req->dbhs, i, f);
+	if (f == fdbh)
+	  {
+	    vector_erase (args->req->dbhs, i);
+	    break;
+	  }
+      }
+
+  /* Roll back the handle, unless the code which borrowed it has already
+   * committed (or never started a transaction), in which case there is
+   * nothing to roll back and we can save a round trip to the server.
+   */
+  if (db_in_transaction (fdbh->dbh))
+    {
+      db_rollback (fdbh->dbh);
+      fdbh->dbf->nr_rollbacks++;
+    }
+  else
+    fdbh->dbf->nr_rollbacks_skipped++;
+
+  /* Remember when the primary was last written to (or might have been). */
+  if (!fdbh->readonly)
+    fdbh->dbf->last_write = reactor_time;
+
+  /* Give it to the next waiting thread, or push it onto the list of
+   * free handles.
+   */
+  release_dbh (fdbh->dbf, fdbh);
+}
+
+/* Give back all the database handles borrowed during a request. */
+static void
+recover_request_dbhs (struct ml_request *req)
+{
+  if (req->dbh_pool)
+    {
+      /* This calls recover_dbh for each handle, and stops the watch
+       * timer.
+       */
+      delete_pool (req->dbh_pool);
+      req->dbh_pool = 0;
+      req->dbhs = 0;
+      req->watch = 0;
+    }
+}
+
+struct cancel_query_args
+{
+  pool pool;
+  ml_dbh_factory dbf;		/* Factory (primary or replica). */
+  int backend_pid;		/* Server process running the query. */
+};
+
+static void
+do_cancel_query (void *vargs)
+{
+  struct cancel_query_args *args = (struct cancel_query_args *) vargs;
+  db_handle dbh;
+  st_handle sth;
+  int cancelled = 0;
+
+  /* The dbi library doesn't let us use libpq's PQcancel on the handle,
+   * so ask the server to cancel the query over a new connection (which
+   * is what PQcancel does anyway). The connection is closed when this
+   * thread exits.
+   */
+  dbh = new_db_handle (pth_get_pool (current_pth), args->dbf->conninfo,
+		       DBI_THROW_ERRORS);
+  sth = st_prepare (dbh, "select pg_cancel_backend (?)", DBI_INT);
+  st_execute (sth, args->backend_pid);
+  st_bind (sth, 0, cancelled, DBI_BOOL);
+  if (st_fetch (sth) && cancelled)
+    nr_queries_cancelled++;
+}
+
+static void
+cancel_query (void *vargs)
+{
+  struct cancel_query_args *args = (struct cancel_query_args *) vargs;
+
+  /* If this fails, the query runs until it finishes, or until the
+   * statement_timeout.
+   */
+  pth_catch (do_cancel_query, args);
+  delete_pool (args->pool);
+}
+
+/* Called by the reactor every so often while a request is running an
+ * action or repaint and holds database handles. If it should be
+ * abandoned, then have the server cancel whatever the handles are
+ * doing. The request's thread is probably waiting for one of them, and
+ * will see that the request was abandoned when the query fails.
+ */
+static void
+watch_request (void *vreq)
+{
+  struct ml_request *req = (struct ml_request *) vreq;
+  struct cancel_query_args *args;
+  struct factory_dbh *fdbh;
+  pseudothread pth;
+  pool pool;
+  int i;
+
+  req->watch = 0;
+
+  /* get_dbh starts the timer again when it is next needed. */
+  if (!req->cancellable || vector_size (req->dbhs) == 0)
+    return;
+
+  if (!request_cancelled (req))
+    {
+      req->watch = reactor_set_timer (req->dbh_pool, DBH_WATCH_INTERVAL,
+				      watch_request, req);
+      return;
+    }
+
+  for (i = 0; i < vector_size (req->dbhs); ++i)
+    {
+      vector_get (req->dbhs, i, fdbh);
+      if (!fdbh->backend_pid) continue;
+
+      pool = new_subpool (ml_pool);
+      args = pmalloc (pool, sizeof *args);
+      args->pool = pool;
+      args->dbf = fdbh->dbf;
+      args->backend_pid = fdbh->backend_pid;
+      pth = new_pseudothread (ml_pool, cancel_query, args,
+			      "monolith query canceller");
+      pth_start (pth);
+    }
+}
+
+/* Close handles which have been idle for too long, and open new ones if
+ * a factory has fallen below its minimum.
+ */
+static void
+reap_dbhs (ml_dbh_factory dbf)
+{
+  struct factory_dbh *fdbh;
+
+  while (vector_size (dbf->free_handles) > 0 &&
+	 dbf->allocated > dbf->min_handles &&
+	 dbf->max_idle > 0)
+    {
+      vector_get (dbf->free_handles, 0, fdbh);
+      if (reactor_time - fdbh->last_used < dbf->max_idle * 1000LL)
+	break;
+
+      vector_erase (dbf->free_handles, 0);
+      close_dbh (dbf, fdbh);
+      dbf->nr_reaped++;
+    }
+
+  while (dbf->allocated < dbf->min_handles)
+    {
+      fdbh = open_dbh (dbf);
+      if (!fdbh) break;
+      release_dbh (dbf, fdbh);
+    }
+}
+
+static void
+dbh_reaper (void *data)
+{
+  struct pool *tmp;
+  vector dbfs;
+  ml_dbh_factory dbf, replica;
+  int i, j;
+
+  for (;;)
+    {
+      pth_sleep (DBH_REAP_INTERVAL);
+
+      tmp = new_subpool (pth_get_pool (current_pth));
+      dbfs = shash_values_in_pool (dbh_factories, tmp);
+      for (i = 0; i < vector_size (dbfs); ++i)
+	{
+	  vector_get (dbfs, i, dbf);
+	  reap_dbhs (dbf);
+	  for (j = 0; j < vector_size (dbf->replicas); ++j)
+	    {
+	      vector_get (dbf->replicas, j, replica);
+	      reap_dbhs (replica);
+	    }
+	}
+      delete_pool (tmp);
+    }
+}
+
+ml_statement
+new_ml_statement (ml_dbh_factory dbf, const char *query, ...)
+{
+  ml_statement stmt;
+  va_list args;
+  int type;
+
+  if (shash_get (dbf->statements_by_query, query, stmt))
+    return stmt;
+
+  stmt = pmalloc (dbf->pool, sizeof *stmt);
+  stmt->dbf = dbf;
+  stmt->index = vector_size (dbf->statements);
+  stmt->query = pstrdup (dbf->pool, query);
+  stmt->nr_types = 0;
+  stmt->nr_prepares = 0;
+  stmt->nr_executes = 0;
+
+  va_start (args, query);
+  while ((type = va_arg (args, int)) != 0)
+    {
+      if (stmt->nr_types >= ML_STATEMENT_MAX_ARGS)
+	pth_die ("new_ml_statement: too many placeholders in query");
+      stmt->types[stmt->nr_types++] = type;
+    }
+  va_end (args);
+
+  vector_push_back (dbf->statements, stmt);
+  shash_insert (dbf->statements_by_query, stmt->query, stmt);
+
+  return stmt;
+}
+
+/* The dbi library only takes the placeholder types as arguments, so
+ * we have to spell out each case.
+ */
+static st_handle
+prepare_statement (db_handle dbh, ml_statement stmt)
+{
+  const char *q = stmt->query;
+  const int *t = stmt->types;
+
+  stmt->nr_prepares++;
+
+  switch (stmt->nr_types)
+    {
+    case 0: return st_prepare (dbh, q);
+    case 1: return st_prepare (dbh, q, t[0]);
+    case 2: return st_prepare (dbh, q, t[0], t[1]);
+    case 3: return st_prepare (dbh, q, t[0], t[1], t[2]);
+    case 4: return st_prepare (dbh, q, t[0], t[1], t[2], t[3]);
+    case 5: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4]);
+    case 6: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5]);
+    case 7: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5],
+			       t[6]);
+    case 8: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5],
+			       t[6], t[7]);
+    case 9: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5],
+			       t[6], t[7], t[8]);
+    case 10: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5],
+				t[6], t[7], t[8], t[9]);
+    case 11: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5],
+				t[6], t[7], t[8], t[9], t[10]);
+    case 12: return st_prepare (dbh, q, t[0], t[1], t[2], t[3], t[4], t[5],
+				t[6], t[7], t[8], t[9], t[10], t[11]);
+    }
+  abort ();
+}
+
+struct prepare_args
+{
+  db_handle dbh;
+  ml_statement stmt;
+  st_handle sth;
+};
+
+static void
+do_prepare (void *vargs)
+{
+  struct prepare_args *args = (struct prepare_args *) vargs;
+
+  args->sth = prepare_statement (args->dbh, args->stmt);
+}
+
+/* Prepare the registered statements which haven't yet been prepared
+ * on this handle. If one fails, we leave a NULL there, and ml_prepare
+ * tries again later (when the error can go back to the caller).
+ */
+static void
+prepare_statements (struct factory_dbh *fdbh)
+{
+  struct prepare_args args;
+
+  args.dbh = fdbh->dbh;
+  while (vector_size (fdbh->sths) < vector_size (fdbh->dbf->statements))
+    {
+      vector_get (fdbh->dbf->statements, vector_size (fdbh->sths),
+		  args.stmt);
+      args.sth = 0;
+      if (pth_catch (do_prepare, &args)) args.sth = 0;
+      vector_push_back (fdbh->sths, args.sth);
+    }
+}
+
+st_handle
+ml_prepare (db_handle dbh, ml_statement stmt)
+{
+  struct factory_dbh *fdbh;
+  st_handle sth;
+
+  /* If this fails, the handle didn't come from the statement's factory
+   * (or one of its replicas).
+   */
+  if (!hash_get (dbh_handles, dbh, fdbh) ||
+      fdbh->dbf->statements != stmt->dbf->statements)
+    abort ();
+
+  if (stmt->index >= vector_size (fdbh->sths))
+    prepare_statements (fdbh);
+
+  vector_get (fdbh->sths, stmt->index, sth);
+  if (!sth)
+    {
+      sth = prepare_statement (dbh, stmt);
+      vector_replace (fdbh->sths, stmt->index, sth);
+    }
+
+  stmt->nr_executes++;
+  return sth;
+}
+
+static void get_auth_dbf (ml_session);
+static const char *parse_expires_header (pool pool, const char *expires);
+
+/* Writes to the user database (the cookie changes when users log in
+ * and out, and the login counts in ml_users) are not made by the
+ * request itself. Instead they are queued, and a background thread
+ * writes everything which has been queued in one transaction, a short
+ * while later. Until then, auth_to_userid consults the queue before
+ * believing the database. There is one queue for each user database.
+ */
+#define AUTH_NONE   0
+#define AUTH_LOGIN  1
+#define AUTH_LOGOUT 2
+
+struct auth_write
+{
+  int userid;			/* User. */
+  int cookie_op;		/* AUTH_NONE, AUTH_LOGIN or AUTH_LOGOUT. */
+  const char *cookie;		/* New cookie (if cookie_op == AUTH_LOGIN). */
+  int cookie_version;		/* Incremented on each login and logout. */
+  int logins;			/* Logins not yet counted in ml_users. */
+  int bad_logins;		/* Bad logins since the last of those logins
+				 * (if logins > 0), else not yet counted. */
+};
+
+struct auth_queue
+{
+  ml_dbh_factory dbf;		/* User database. */
+  pool pool;			/* Subpool holding the queued writes. It is
+				 * replaced whenever the queue empties, since
+				 * the hashes never free erased keys. */
+  hash writes;			/* Hash userid -> struct auth_write *. */
+  shash cookies;		/* Hash cookie -> userid for queued logins. */
+  int interval;			/* How long to wait before writing (ms). */
+  int accounting;		/* Update the login counts in ml_users? */
+  int scheduled;		/* Set if a writer thread is waiting. */
+  int writing;			/* Set while a thread is writing. */
+  ml_statement delete_cookie, insert_cookie, count_logins,
+    count_bad_logins;
+};
+
+/* A copy of a queued write, taken when the writer starts. */
+struct auth_snapshot
+{
+  struct auth_write *w;
+  int cookie_op;
+  const char *cookie;
+  int cookie_version;
+  int logins;
+  int bad_logins;
+};
+
+struct auth_write_args
+{
+  struct auth_queue *q;
+  vector snapshots;		/* Vector of struct auth_snapshot. */
+  db_handle dbh;
+};
+
+static hash auth_queues;	/* Hash ml_dbh_factory -> struct auth_queue *. */
+static int nr_auth_writes;	/* Transactions written by the writer. */
+static int nr_auth_write_failures; /* Failed (the writes are retried). */
+static int nr_auth_accounting_failures; /* Login counts which were lost. */
+
+/* Default settings. */
+#define AUTH_WRITE_INTERVAL 1000 /* Milliseconds. */
+#define AUTH_SHUTDOWN_WAIT 10	/* How long to wait for writes at exit (secs). */
+
+static void
+reset_auth_queue (struct auth_queue *q)
+{
+  if (q->pool) delete_pool (q->pool);
+  q->pool = new_subpool (ml_pool);
+  q->writes = new_hash (q->pool, int, struct auth_write *);
+  q->cookies = new_shash (q->pool, int);
+}
+
+static struct auth_queue *
+get_auth_queue (ml_session session, ml_dbh_factory dbf)
+{
+  struct auth_queue *q;
+
+  if (!auth_queues)
+    auth_queues = new_hash (ml_pool, ml_dbh_factory, struct auth_queue *);
+
+  if (!hash_get (auth_queues, dbf, q))
+    {
+      q = pmalloc (ml_pool, sizeof *q);
+      q->dbf = dbf;
+      q->pool = 0;
+      reset_auth_queue (q);
+      q->scheduled = 0;
+      q->writing = 0;
+      q->delete_cookie =
+	ml_register_statement
+	(dbf, "delete from ml_user_cookie where userid = ?", DBI_INT);
+      q->insert_cookie =
+	ml_register_statement
+	(dbf,
+	 "insert into ml_user_cookie (userid, cookie) values (?, ?)",
+	 DBI_INT, DBI_STRING);
+      q->count_logins =
+	ml_register_statement
+	(dbf,
+	 "update ml_users set nr_logins = nr_logins + ?, "
+	 "lastlogin_date = current_date, bad_logins = ? "
+	 "where userid = ?",
+	 DBI_INT, DBI_INT, DBI_INT);
+      q->count_bad_logins =
+	ml_register_statement
+	(dbf,
+	 "update ml_users set bad_logins = bad_logins + ? where userid = ?",
+	 DBI_INT, DBI_INT);
+      hash_insert (auth_queues, dbf, q);
+
+      install_shutdown_hook ();
+    }
+
+  /* As with the factories, the most recent configuration wins. */
+  q->interval = ml_cfg_get_int (session, "monolith user writes delay",
+				AUTH_WRITE_INTERVAL);
+  q->accounting = ml_cfg_get_bool (session, "monolith user accounting", 1);
+
+  return q;
+}
+
+static struct auth_write *
+get_auth_write (struct auth_queue *q, int userid)
+{
+  struct auth_write *w;
+
+  if (!hash_get (q->writes, userid, w))
+    {
+      w = pmalloc (q->pool, sizeof *w);
+      w->userid = userid;
+      w->cookie_op = AUTH_NONE;
+      w->cookie = 0;
+      w->cookie_version = 0;
+      w->logins = 0;
+      w->bad_logins = 0;
+      hash_insert (q->writes, userid, w);
+    }
+
+  return w;
+}
+
+static void schedule_auth_writer (struct auth_queue *q);
+
+/* Queue a login (if cookie != NULL) or a logout (if cookie == NULL). */
+static void
+queue_auth_cookie (struct auth_queue *q, int userid, const char *cookie)
+{
+  struct auth_write *w = get_auth_write (q, userid);
+
+  if (w->cookie_op == AUTH_LOGIN)
+    shash_erase (q->cookies, w->cookie);
+  w->cookie_version++;
+
+  if (cookie)
+    {
+      w->cookie_op = AUTH_LOGIN;
+      w->cookie = pstrdup (q->pool, cookie);
+      shash_insert (q->cookies, w->cookie, userid);
+      w->logins++;
+      w->bad_logins = 0;
+    }
+  else
+    {
+      w->cookie_op = AUTH_LOGOUT;
+      w->cookie = 0;
+    }
+
+  schedule_auth_writer (q);
+}
+
+static void
+do_write_cookies (void *vargs)
+{
+  struct auth_write_args *args = (struct auth_write_args *) vargs;
+  struct auth_snapshot *snap;
+  st_handle sth;
+  int i;
+
+  args->dbh = get_dbh (0, args->q->dbf, 0);
+
+  for (i = 0; i < vector_size (args->snapshots); ++i)
+    {
+      vector_get_ptr (args->snapshots, i, snap);
+      if (snap->cookie_op == AUTH_NONE) continue;
+
+      sth = ml_prepare (args->dbh, args->q->delete_cookie);
+      st_execute (sth, snap->w->userid);
+      if (snap->cookie_op == AUTH_LOGIN)
+	{
+	  sth = ml_prepare (args->dbh, args->q->insert_cookie);
+	  st_execute (sth, snap->w->userid, snap->cookie);
+	}
+    }
+
+  db_commit (args->dbh);
+}
+
+static void
+do_write_accounting (void *vargs)
+{
+  struct auth_write_args *args = (struct auth_write_args *) vargs;
+  struct auth_snapshot *snap;
+  st_handle sth;
+  int i;
+
+  for (i = 0; i < vector_size (args->snapshots); ++i)
+    {
+      vector_get_ptr (args->snapshots, i, snap);
+
+      if (snap->logins > 0)
+	{
+	  sth = ml_prepare (args->dbh, args->q->count_logins);
+	  st_execute (sth, snap->logins, snap->bad_logins, snap->w->userid);
+	}
+      else if (snap->bad_logins > 0)
+	{
+	  sth = ml_prepare (args->dbh, args->q->count_bad_logins);
+	  st_execute (sth, snap->bad_logins, snap->w->userid);
+	}
+    }
+
+  db_commit (args->dbh);
+}
+
+/* Write everything in the queue. The caller must set q->writing first.
+ * Things queued while we are writing stay queued for next time.
+ */
+static void
+write_auth_queue (struct auth_queue *q)
+{
+  pool tmp = new_subpool (pth_get_pool (current_pth));
+  struct auth_write_args args;
+  struct auth_snapshot snap, *sp;
+  struct auth_write *w;
+  vector writes;
+  int i, userid;
+
+  args.q = q;
+  args.snapshots = new_vector (tmp, struct auth_snapshot);
+  args.dbh = 0;
+
+  writes = hash_values_in_pool (q->writes, tmp);
+  for (i = 0; i < vector_size (writes); ++i)
+    {
+      vector_get (writes, i, w);
+      snap.w = w;
+      snap.cookie_op = w->cookie_op;
+      snap.cookie = w->cookie;
+      snap.cookie_version = w->cookie_version;
+      snap.logins = q->accounting ? w->logins : 0;
+      snap.bad_logins = q->accounting ? w->bad_logins : 0;
+      vector_push_back (args.snapshots, snap);
+    }
+
+  if (vector_size (args.snapshots) == 0) goto out;
+
+  /* If the cookies can't be written, leave everything queued and try
+   * again later.
+   */
+  if (pth_catch (do_write_cookies, &args))
+    {
+      nr_auth_write_failures++;
+      goto out;
+    }
+  nr_auth_writes++;
+
+  /* A lookup which started before the commit may have seen the old
+   * cookies, and must not cache them once we take the writes out of
+   * the queue below.
+   */
+  for (i = 0; i < vector_size (args.snapshots); ++i)
+    {
+      vector_get_ptr (args.snapshots, i, sp);
+      if (sp->cookie_op != AUTH_NONE)
+	ml_auth_cache_invalidate (sp->w->userid);
+    }
+
+  /* The login counts are less important. If the users table doesn't
+   * have the columns, say, we don't want to keep on trying.
+   */
+  if (q->accounting && pth_catch (do_write_accounting, &args))
+    nr_auth_accounting_failures++;
+
+  /* Take what we have written out of the queue. */
+  for (i = 0; i < vector_size (args.snapshots); ++i)
+    {
+      vector_get_ptr (args.snapshots, i, sp);
+      w = sp->w;
+
+      if (sp->cookie_op != AUTH_NONE &&
+	  w->cookie_version == sp->cookie_version)
+	{
+	  if (w->cookie_op == AUTH_LOGIN)
+	    shash_erase (q->cookies, w->cookie);
+	  w->cookie_op = AUTH_NONE;
+	  w->cookie = 0;
+	}
+
+      if (q->accounting)
+	{
+	  /* If the user logged in again meanwhile, bad_logins counts
+	   * from that login, so it must be left alone.
+	   */
+	  if (w->logins == sp->logins)
+	    w->bad_logins -= sp->bad_logins;
+	  w->logins -= sp->logins;
+	}
+      else
+	w->logins = w->bad_logins = 0;
+
+      if (w->cookie_op == AUTH_NONE && w->logins == 0 && w->bad_logins == 0)
+	{
+	  userid = w->userid;
+	  hash_erase (q->writes, userid);
+	}
+    }
+
+  if (hash_size (q->writes) == 0)
+    reset_auth_queue (q);
+
+ out:
+  /* The database handle (if any) is given back when this thread exits. */
+  delete_pool (tmp);
+  q->writing = 0;
+}
+
+static void
+auth_writer (void *vq)
+{
+  struct auth_queue *q = (struct auth_queue *) vq;
+
+  if (q->interval > 0)
+    pth_millisleep (q->interval);
+  q->scheduled = 0;
+
+  /* Another thread is still writing (this can happen at shutdown), so
+   * leave this lot until later.
+   */
+  if (q->writing)
+    {
+      schedule_auth_writer (q);
+      return;
+    }
+
+  q->writing = 1;
+  write_auth_queue (q);
+
+  /* Failed, or more was queued meanwhile? */
+  if (hash_size (q->writes) > 0)
+    schedule_auth_writer (q);
+}
+
+static void
+schedule_auth_writer (struct auth_queue *q)
+{
+  pseudothread pth;
+
+  if (q->scheduled) return;
+  q->scheduled = 1;
+
+  /* Each write is done by a new thread, so that the database handle is
+   * given back when the thread exits.
+   */
+  pth = new_pseudothread (ml_pool, auth_writer, q,
+			  "monolith user database writer");
+  pth_start (pth);
+}
+
+static void
+auth_flusher (void *vq)
+{
+  write_auth_queue ((struct auth_queue *) vq);
+}
+
+/* Write whatever is still queued, and wait until the writes finish (or
+ * we give up waiting for them).
+ */
+static void
+flush_auth_queues ()
+{
+  reactor_time_t give_up = reactor_time + AUTH_SHUTDOWN_WAIT * 1000LL;
+  vector queues;
+  struct auth_queue *q;
+  pseudothread pth;
+  int i, busy;
+
+  if (!auth_queues) return;
+
+  queues = hash_values_in_pool (auth_queues, pth_get_pool (current_pth));
+
+  for (i = 0; i < vector_size (queues); ++i)
+    {
+      vector_get (queues, i, q);
+      if (hash_size (q->writes) > 0 && !q->writing)
+	{
+	  q->writing = 1;
+	  pth = new_pseudothread (ml_pool, auth_flusher, q,
+				  "monolith user database flusher");
+	  pth_start (pth);
+	}
+    }
+
+  do
+    {
+      busy = 0;
+      for (i = 0; i < vector_size (queues); ++i)
+	{
+	  vector_get (queues, i, q);
+	  if (q->writing) busy = 1;
+	}
+      if (busy) pth_millisleep (100);
+    }
+  while (busy && reactor_time < give_up);
+}
+
+/* rws is normally stopped with a signal, in which case exit handlers
+ * don't run. So when the first queue is created, we catch SIGTERM and
+ * SIGINT. The signal handler can't do anything much, so it just wakes
+ * up the reactor through a pipe. Then a thread writes out the queues,
+ * puts back the previous signal handler and raises the signal again.
+ * (If the server is killed some other way, the writes queued in the
+ * last 'monolith user writes delay' milliseconds are lost.)
+ */
+static int shutdown_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t shutdown_signal;
+static struct sigaction old_sigterm, old_sigint;
+static reactor_handle shutdown_handle;
+
+static void
+catch_shutdown_signal (int sig)
+{
+  int saved_errno = errno;
+  ssize_t r;
+
+  shutdown_signal = sig;
+  r = write (shutdown_pipe[1], "", 1);
+  (void) r;
+  errno = saved_errno;
+}
+
+static void
+shutdown_thread (void *vp)
 {
-  return hash_keys_in_pool (session->dbhs, pool);
+  int sig = shutdown_signal;
+
+  flush_auth_queues ();
+
+  sigaction (SIGTERM, &old_sigterm, 0);
+  sigaction (SIGINT, &old_sigint, 0);
+  raise (sig);
 }
 
-ml_dbh_factory
-_ml_session_get_auth_dbf (ml_session session)
+static void
+shutdown_requested (int fd, int events, void *vp)
 {
-  return session->auth_dbf;
+  pseudothread pth;
+
+  reactor_unregister (shutdown_handle);
+
+  pth = new_pseudothread (ml_pool, shutdown_thread, 0,
+			  "monolith shutdown");
+  pth_start (pth);
 }
 
-const vector
-_ml_get_dbh_factories (pool pool)
+static void
+install_shutdown_hook ()
 {
-  return shash_keys_in_pool (dbh_factories, pool);
+  struct sigaction sa;
+
+  if (shutdown_pipe[0] >= 0) return;
+
+  if (pipe (shutdown_pipe) == -1)
+    {
+      perror ("monolith: pipe");
+      shutdown_pipe[0] = shutdown_pipe[1] = -1;
+      return;
+    }
+  fcntl (shutdown_pipe[0], F_SETFD, FD_CLOEXEC);
+  fcntl (shutdown_pipe[1], F_SETFD, FD_CLOEXEC);
+  fcntl (shutdown_pipe[1], F_SETFL, O_NONBLOCK);
+
+  shutdown_handle = reactor_register (shutdown_pipe[0], REACTOR_READ,
+				      shutdown_requested, 0);
+
+  memset (&sa, 0, sizeof sa);
+  sa.sa_handler = catch_shutdown_signal;
+  sigemptyset (&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction (SIGTERM, &sa, &old_sigterm);
+  sigaction (SIGINT, &sa, &old_sigint);
 }
 
-ml_dbh_factory
-_ml_get_dbh_factory (const char *conninfo)
+int
+_ml_get_nr_auth_writes_queued ()
 {
-  ml_dbh_factory dbf;
+  pool tmp;
+  vector queues;
+  struct auth_queue *q;
+  int i, n = 0;
 
-  if (shash_get (dbh_factories, conninfo, dbf))
-    return dbf;
-  else
-    return 0;
+  if (!auth_queues) return 0;
+
+  tmp = new_subpool (pth_get_pool (current_pth));
+  queues = hash_values_in_pool (auth_queues, tmp);
+  for (i = 0; i < vector_size (queues); ++i)
+    {
+      vector_get (queues, i, q);
+      n += hash_size (q->writes);
+    }
+  delete_pool (tmp);
+  return n;
 }
 
 int
-_ml_dbh_factory_get_nr_allocated_handles (ml_dbh_factory dbf)
+_ml_get_nr_auth_writes ()
 {
-  return dbf->allocated;
+  return nr_auth_writes;
 }
 
 int
-_ml_dbh_factory_get_nr_free_handles (ml_dbh_factory dbf)
+_ml_get_nr_auth_write_failures ()
 {
-  return vector_size (dbf->free_handles);
+  return nr_auth_write_failures;
 }
 
-void
-ml_session_release_lock (ml_session session)
+int
+_ml_get_nr_auth_accounting_failures ()
 {
-  mutex_leave (session->lock);
+  return nr_auth_accounting_failures;
 }
 
-void
-ml_session_acquire_lock (ml_session session)
+static void
+auth_cache_unlink (struct auth_cache_entry *e)
 {
-  mutex_enter (session->lock);
-
-  /* We've probably been sleeping for a while, so update the last access
-   * time to reflect this.
-   */
-  session->last_access = reactor_time;
+  if (e->prev) e->prev->next = e->next; else auth_cache_head = e->next;
+  if (e->next) e->next->prev = e->prev; else auth_cache_tail = e->prev;
+  e->prev = e->next = 0;
 }
 
-cgi
-_ml_session_submitted_args (ml_session session)
+static void
+auth_cache_push_front (struct auth_cache_entry *e)
 {
-  return session->submitted_args;
+  e->prev = 0;
+  e->next = auth_cache_head;
+  if (auth_cache_head) auth_cache_head->prev = e; else auth_cache_tail = e;
+  auth_cache_head = e;
 }
 
-ml_dbh_factory
-new_ml_dbh_factory (ml_session session, const char *conninfo)
+static void
+auth_cache_remove (struct auth_cache_entry *e)
 {
-  ml_dbh_factory dbf;
+  session_table_erase (auth_cache, &e->key);
+  auth_cache_unlink (e);
+  e->next = auth_cache_free;
+  auth_cache_free = e;
+}
 
-  if (!shash_get (dbh_factories, conninfo, dbf))
-    {
-      pool dbf_pool = new_subpool (ml_pool);
+/* Look up a cookie. Returns 1 and sets *userid if there is an entry
+ * which hasn't expired.
+ */
+static int
+auth_cache_get (ml_dbh_factory dbf, const struct session_key *key,
+		int *userid)
+{
+  struct auth_cache_entry *e = session_table_get (auth_cache, key);
 
-      /* Create the factory. */
-      dbf = pmalloc (dbf_pool, sizeof *dbf);
-      dbf->pool = dbf_pool;
-      dbf->conninfo = pstrdup (dbf_pool, conninfo);
-      dbf->allocated = 0;
-      dbf->free_handles = new_vector (dbf_pool, db_handle);
+  if (!e || e->dbf != dbf) return 0;
 
-      shash_insert (dbh_factories, conninfo, dbf);
+  if (reactor_time >= e->expires)
+    {
+      auth_cache_remove (e);
+      return 0;
     }
 
-  return dbf;
+  auth_cache_unlink (e);
+  auth_cache_push_front (e);
+  *userid = e->userid;
+  return 1;
 }
 
-struct recover_dbh_args
+static void
+auth_cache_put (ml_dbh_factory dbf, const struct session_key *key,
+		int userid, int ttl)
 {
-  ml_session session;
-  ml_dbh_factory dbf;
-  db_handle dbh;
-};
-
-static void recover_dbh (void *vargs);
+  struct auth_cache_entry *e;
 
-db_handle
-ml_get_dbh (ml_session session, ml_dbh_factory dbf)
-{
-  db_handle dbh;
-  pool pool;
-  struct recover_dbh_args *args;
+  if (auth_cache_max <= 0 || ttl <= 0) return;
 
-  /* If a free handle is available in the factory, grab it and return it. */
-  if (vector_size (dbf->free_handles) > 0)
+  if ((e = session_table_get (auth_cache, key)) != 0)
+    auth_cache_unlink (e);
+  else
     {
-      vector_pop_back (dbf->free_handles, dbh);
+      while (session_table_size (auth_cache) >= auth_cache_max)
+	auth_cache_remove (auth_cache_tail);
 
-    finish:
-      /* Allocate a pool to this handle, as a subpool of the thread pool, so
-       * if the thread finishes without giving up the handle, we get it back.
-       */
-      pool = new_subpool (pth_get_pool (current_pth));
-      args = pmalloc (pool, sizeof *args);
-      args->session = session;
-      args->dbf = dbf;
-      args->dbh = dbh;
-      pool_register_cleanup_fn (pool, recover_dbh, args);
-      hash_insert (session->dbhs, dbh, pool);
+      if (auth_cache_free)
+	{
+	  e = auth_cache_free;
+	  auth_cache_free = e->next;
+	}
+      else
+	e = pmalloc (ml_pool, sizeof *e);
 
-      return dbh;
+      e->key = *key;
+      session_table_insert (auth_cache, key, e);
     }
 
-  /* Allocate one.
-   *
-   * Note here that dbf->pool is a subpool of ml_pool, so when we
-   * free up ml_pool, we will close the connections.
-   */
-  dbh = new_db_handle (dbf->pool,
-		       dbf->conninfo, DBI_THROW_ERRORS);
-  if (!dbh) pth_die (dbf->conninfo);
-  dbf->allocated++;
-  goto finish;
+  e->dbf = dbf;
+  e->userid = userid;
+  e->expires = reactor_time + ttl * 1000LL;
+  auth_cache_push_front (e);
 }
 
 void
-ml_put_dbh (ml_session session, db_handle dbh)
+ml_auth_cache_invalidate (int userid)
 {
-  pool pool;
+  struct auth_cache_entry *e, *next;
 
-  /* If this fails, then it's likely that they're trying to 'put' a
-   * database handle which they don't own, or 'put'ting a handle twice.
-   */
-  assert (hash_get (session->dbhs, dbh, pool));
+  auth_cache_generation++;
 
-  /* This calls recover_dbh. */
-  delete_pool (pool);
+  for (e = auth_cache_head; e; e = next)
+    {
+      next = e->next;
+      if (userid == 0 || e->userid == userid)
+	auth_cache_remove (e);
+    }
 }
 
-static void
-recover_dbh (void *vargs)
+/* Cookies are made by ml_random_token, so anything which isn't 32
+ * lower case hex digits can't be one of ours.
+ */
+static int
+parse_auth_cookie (const char *auth, struct session_key *key)
 {
-  struct recover_dbh_args *args = (struct recover_dbh_args *) vargs;
+  int i;
 
-  /* Roll back the handle. */
-  db_rollback (args->dbh);
+  if (strlen (auth) != 32)
+    return 0;
+
+  for (i = 0; i < 32; ++i)
+    if (isupper ((unsigned char) auth[i]))
+      return 0;
 
-  /* Push it onto the list of free handles. */
-  vector_push_back (args->dbf->free_handles, args->dbh);
-  assert (hash_erase (args->session->dbhs, args->dbh));
+  return session_key_parse (auth, key);
 }
 
-static void get_auth_dbf (ml_session);
-static const char *parse_expires_header (pool pool, const char *expires);
+int
+_ml_get_auth_cache_size ()
+{
+  return session_table_size (auth_cache);
+}
+
+int
+_ml_get_nr_auth_cache_hits ()
+{
+  return nr_auth_cache_hits;
+}
+
+int
+_ml_get_nr_auth_cache_misses ()
+{
+  return nr_auth_cache_misses;
+}
 
 void
 ml_session_login (ml_session session, int userid,
 		  const char *path, const char *expires)
 {
   pool thread_pool = pth_get_pool (current_pth);
-  db_handle dbh;
-  st_handle sth;
   const char *cookie;
+  struct ml_request *req;
 
   /* Parse the expires header. */
   expires = parse_expires_header (thread_pool, expires);
 
   get_auth_dbf (session);
-  dbh = ml_get_dbh (session, session->auth_dbf);
 
-  /* Generate a suitable cookie and insert it into the database. */
-  cookie = generate_sessionid (thread_pool);
-  sth = st_prepare_cached
-    (dbh,
-     "delete from ml_user_cookie where userid = ?",
-     DBI_INT);
-  st_execute (sth, userid);
-  sth = st_prepare_cached
-    (dbh,
-     "insert into ml_user_cookie (userid, cookie) values (?, ?)",
-     DBI_INT, DBI_STRING);
-  st_execute (sth, userid, cookie);
-  db_commit (dbh);
-  ml_put_dbh (session, dbh);
+  /* Generate a suitable cookie, and queue it to be written to the
+   * database.
+   */
+  cookie = ml_random_token (thread_pool);
+  queue_auth_cookie (session->auth_queue, userid, cookie);
+
+  /* Logging in replaces any other cookie the user had. */
+  ml_auth_cache_invalidate (userid);
 
   /* User is logged in. */
   session->userid = userid;
 
   /* Remember to send back a cookie. */
-  session->auth_cookie = cookie;
-  session->auth_cookie_path = path;
-  session->auth_cookie_expires = expires;
+  req = current_request (session);
+  req->auth_cookie = cookie;
+  req->auth_cookie_path = path;
+  req->auth_cookie_expires = expires;
 }
 
 void
 ml_session_logout (ml_session session, const char *path)
 {
   pool thread_pool = pth_get_pool (current_pth);
-  db_handle dbh;
-  st_handle sth;
   int old_userid = session->userid;
   const char *expires;
+  struct ml_request *req;
 
   /* Set the expires header. */
   expires = parse_expires_header (thread_pool, "+1y");
@@ -976,23 +4106,30 @@ ml_session_logout (ml_session session, const char *path)
   if (!old_userid) return;
 
   get_auth_dbf (session);
-  dbh = ml_get_dbh (session, session->auth_dbf);
-
-  sth = st_prepare_cached
-    (dbh,
-     "delete from ml_user_cookie where userid = ?",
-     DBI_INT);
-  st_execute (sth, old_userid);
-  db_commit (dbh);
-  ml_put_dbh (session, dbh);
+  queue_auth_cookie (session->auth_queue, old_userid, 0);
+  ml_auth_cache_invalidate (old_userid);
 
   /* User is logged out. */
   session->userid = 0;
 
   /* Remember to send back the poison cookie. */
-  session->auth_cookie = "poison";
-  session->auth_cookie_path = path;
-  session->auth_cookie_expires = expires;
+  req = current_request (session);
+  req->auth_cookie = "poison";
+  req->auth_cookie_path = path;
+  req->auth_cookie_expires = expires;
+}
+
+/* Has the user logged out or in again, but not yet been written to
+ * the database? If so, the cookie in the database is about to be
+ * deleted.
+ */
+static int
+cookie_pending (ml_session session, int userid)
+{
+  struct auth_write *w;
+
+  return hash_get (session->auth_queue->writes, userid, w) &&
+    w->cookie_op != AUTH_NONE;
 }
 
 /* Convert auth cookie to userid, if possible. If not valid, returns 0. */
@@ -1001,27 +4138,81 @@ auth_to_userid (ml_session session, const char *auth)
 {
   db_handle dbh;
   st_handle sth;
-  int userid, fetched;
+  int userid, fetched, generation, ttl;
+  struct session_key key;
 
   get_auth_dbf (session);
-  dbh = ml_get_dbh (session, session->auth_dbf);
-
-  sth = st_prepare_cached
-    (dbh,
-     "select userid from ml_user_cookie where cookie = ?",
-     DBI_STRING);
-  st_execute (sth, auth);
 
-  st_bind (sth, 0, userid, DBI_INT);
+  /* A login which hasn't been written to the database yet? */
+  if (shash_get (session->auth_queue->cookies, auth, userid))
+    return userid;
 
-  fetched = st_fetch (sth);
+  if (!parse_auth_cookie (auth, &key))
+    return 0;
 
-  ml_put_dbh (session, dbh);
+  auth_cache_max = ml_cfg_get_int (session, "monolith auth cache size",
+				   AUTH_CACHE_SIZE);
 
-  if (fetched)
-    return userid;
+  if (auth_cache_get (session->auth_dbf, &key, &userid))
+    nr_auth_cache_hits++;
   else
+    {
+      nr_auth_cache_misses++;
+      generation = auth_cache_generation;
+
+      /* Always check cookies on the primary, since a replica might not
+       * have seen a login or logout which has only just happened.
+       */
+      dbh = get_dbh (session, session->auth_dbf, 1);
+
+      sth = ml_prepare (dbh, session->auth_select_cookie);
+      st_execute (sth, auth);
+
+      st_bind (sth, 0, userid, DBI_INT);
+
+      fetched = st_fetch (sth);
+
+      ml_put_dbh (session, dbh);
+
+      if (!fetched) userid = 0;
+
+      /* Remember the answer. Cookies which aren't valid are only
+       * remembered for a short time, in case they become valid (the
+       * user logs in through another server). Don't remember it at all
+       * if someone logged in or out while we were looking, or if the
+       * database is about to change, otherwise we might go on
+       * accepting the cookie after the user has logged out.
+       */
+      if (userid)
+	ttl = ml_cfg_get_int (session, "monolith auth cache ttl",
+			      AUTH_CACHE_TTL);
+      else
+	ttl = ml_cfg_get_int (session, "monolith auth cache negative ttl",
+			      AUTH_CACHE_NEGATIVE_TTL);
+
+      if (generation == auth_cache_generation &&
+	  !(userid && cookie_pending (session, userid)))
+	auth_cache_put (session->auth_dbf, &key, userid, ttl);
+    }
+
+  if (!userid)
+    return 0;
+
+  if (cookie_pending (session, userid))
     return 0;
+
+  return userid;
+}
+
+void
+ml_session_bad_login (ml_session session, int userid)
+{
+  struct auth_write *w;
+
+  get_auth_dbf (session);
+  w = get_auth_write (session->auth_queue, userid);
+  w->bad_logins++;
+  schedule_auth_writer (session->auth_queue);
 }
 
 static void
@@ -1038,6 +4229,13 @@ get_auth_dbf (ml_session session)
 		 "in the rws configuration file");
 
       session->auth_dbf = new_ml_dbh_factory (session, conninfo);
+
+      session->auth_select_cookie =
+	ml_register_statement
+	(session->auth_dbf,
+	 "select userid from ml_user_cookie where cookie = ?",
+	 DBI_STRING);
+      session->auth_queue = get_auth_queue (session, session->auth_dbf);
     }
 }
 
@@ -1106,19 +4304,78 @@ const char *
 ml_cfg_get_string (ml_session session,
 		   const char *key, const char *default_value)
 {
-  return rws_request_cfg_get_string (session->rws_rq, key, default_value);
+  return rws_request_cfg_get_string (current_request (session)->rws_rq,
+				    key, default_value);
 }
 
 int
 ml_cfg_get_int (ml_session session, const char *key, int default_value)
 {
-  return rws_request_cfg_get_int (session->rws_rq, key, default_value);
+  return rws_request_cfg_get_int (current_request (session)->rws_rq,
+				 key, default_value);
 }
 
 int
 ml_cfg_get_bool (ml_session session, const char *key, int default_value)
 {
-  return rws_request_cfg_get_bool (session->rws_rq, key, default_value);
+  return rws_request_cfg_get_bool (current_request (session)->rws_rq,
+				  key, default_value);
+}
+
+void
+_ml_session_add_transient_window (ml_session session, ml_window window)
+{
+  vector_push_back (session->transient_windows, window);
+}
+
+/* Look through the transient windows and discard any which have not
+ * been requested for 'monolith window max idle' seconds. Deleting the
+ * window's pool frees the widgets allocated in it and (through pool
+ * cleanups) unregisters their actions. This is only done with the
+ * session lock held exclusively, and at most once a minute.
+ */
+static void
+retire_windows (ml_session session, struct ml_request *req)
+{
+  struct pool_stats pool_stats;
+  struct ml_request *r;
+  ml_window w;
+  int i, j, max_idle, in_use;
+
+  if (reactor_time < session->next_window_sweep) return;
+  session->next_window_sweep = reactor_time + 60000;
+
+  max_idle = ml_cfg_get_int (session, "monolith window max idle", 600);
+  if (max_idle <= 0) return;
+
+  for (i = 0; i < vector_size (session->transient_windows); )
+    {
+      vector_get (session->transient_windows, i, w);
+
+      /* Don't discard windows which are being displayed right now. */
+      in_use = w == session->main_window;
+      for (j = 0; !in_use && j < vector_size (session->requests); ++j)
+	{
+	  vector_get (session->requests, j, r);
+	  in_use = w == r->current_window;
+	}
+
+      if (in_use ||
+	  reactor_time - _ml_window_get_last_access (w) < max_idle * 1000LL)
+	{
+	  i++;
+	  continue;
+	}
+
+      shash_erase (session->windows, _ml_window_get_windowid (w));
+      vector_erase (session->transient_windows, i);
+
+      pool_get_stats (ml_window_pool (w), &pool_stats, sizeof (pool_stats));
+      nr_windows_retired++;
+      windows_retired_size += pool_stats.struct_size;
+
+      delete_pool (ml_window_pool (w));
+    }
 }
 
 void
@@ -1126,42 +4383,212 @@ _ml_session_set_current_window (ml_session session, ml_window window,
 				const char *windowid)
 {
   shash_insert (session->windows, windowid, window);
-  session->current_window = window;
+  current_request (session)->current_window = window;
+}
+
+/* Find the action slot for an action ID. Returns NULL if the ID is
+ * malformed, out of range, or stale.
+ */
+static struct action *
+get_action (ml_session session, const char *action_id)
+{
+  unsigned long i, generation;
+  char *end;
+
+  if (!isdigit ((unsigned char) *action_id)) return 0;
+  i = strtoul (action_id, &end, 10);
+  if (*end != '.' || !isdigit ((unsigned char) end[1])) return 0;
+  generation = strtoul (end+1, &end, 10);
+  if (*end != '\0') return 0;
+
+  if (i >= session->nr_actions ||
+      !session->actions[i]->callback_fn ||
+      session->actions[i]->generation != generation)
+    return 0;
+
+  return session->actions[i];
 }
 
 static void
 run_action (ml_session session, const char *action_id)
 {
-  struct action a;
+  struct action *a = get_action (session, action_id);
 
   /* Ignore unknown action IDs. */
-  if (shash_get (session->actions, action_id, a))
-    a.callback_fn (session, a.data);
+  if (a)
+    a->callback_fn (session, a->data);
+}
+
+static void
+unregister_owned_actions (void *vp)
+{
+  struct action_owner *owner = (struct action_owner *) vp, *o;
+  ml_session session = owner->session;
+  struct action *a;
+  int i;
+
+  /* No point unregistering actions if the whole session is going. */
+  if (session->dead)
+    return;
+
+  i = owner->first;
+  while (i >= 0)
+    {
+      a = session->actions[i];
+      i = a->next_owned;
+      a->owner = 0;
+      free_action (session, a);
+    }
+  owner->first = -1;
+
+  for (i = 0; i < vector_size (session->action_owners); ++i)
+    {
+      vector_get (session->action_owners, i, o);
+      if (o == owner)
+	{
+	  vector_erase (session->action_owners, i);
+	  break;
+	}
+    }
+}
+
+/* Find the owner structure for pool, creating it the first time an
+ * action is registered in that pool. Search from the end, where the
+ * pools of the most recently created widgets are.
+ */
+static struct action_owner *
+get_action_owner (ml_session session, pool pool)
+{
+  struct action_owner *owner;
+  int i;
+
+  for (i = vector_size (session->action_owners) - 1; i >= 0; --i)
+    {
+      vector_get (session->action_owners, i, owner);
+      if (owner->pool == pool)
+	return owner;
+    }
+
+  owner = pmalloc (pool, sizeof *owner);
+  owner->session = session;
+  owner->pool = pool;
+  owner->first = -1;
+  vector_push_back (session->action_owners, owner);
+  pool_register_cleanup_fn (pool, unregister_owned_actions, owner);
+  return owner;
+}
+
+const char *
+ml_register_action_in_pool (ml_session session, pool pool,
+			    void (*callback_fn) (ml_session, void *data),
+			    void *data)
+{
+  struct action *a = register_action (session, callback_fn, data);
+  struct action_owner *owner;
+
+  /* Everything in the session pool goes when the session does. */
+  if (pool != session->session_pool)
+    {
+      owner = get_action_owner (session, pool);
+      a->owner = owner;
+      a->next_owned = owner->first;
+      owner->first = a->index;
+    }
+
+  return a->id;
 }
 
 const char *
 ml_register_action (ml_session session,
 		    void (*callback_fn) (ml_session, void *data), void *data)
 {
-  static int action_id = 1;
-  const char *action_str;
-  struct action a;
+  return register_action (session, callback_fn, data)->id;
+}
+
+/* Register an action. The returned slot holds the action ID string. */
+static struct action *
+register_action (ml_session session,
+		 void (*callback_fn) (ml_session, void *data), void *data)
+{
+  struct action *a;
+  int i;
 
-  action_str = pitoa (session->session_pool, action_id);
-  action_id++;
+  /* Reuse a free slot if there is one, else add a new one. */
+  if (session->actions_free >= 0)
+    {
+      i = session->actions_free;
+      session->actions_free = session->actions[i]->next_free;
+    }
+  else
+    {
+      if (session->nr_actions == session->actions_alloc)
+	{
+	  if (session->actions_alloc == 0)
+	    {
+	      session->actions_alloc = 16;
+	      session->actions =
+		pmalloc (session->session_pool,
+			 session->actions_alloc * sizeof (struct action *));
+	    }
+	  else
+	    {
+	      session->actions_alloc *= 2;
+	      session->actions =
+		prealloc (session->session_pool, session->actions,
+			  session->actions_alloc * sizeof (struct action *));
+	    }
+	}
+      i = session->nr_actions++;
+      session->actions[i] = pmalloc (session->session_pool,
+				     sizeof (struct action));
+      session->actions[i]->index = i;
+      session->actions[i]->generation = 0;
+    }
 
-  a.callback_fn = callback_fn;
-  a.data = data;
+  a = session->actions[i];
+  a->callback_fn = callback_fn;
+  a->data = data;
+  a->next_free = -1;
+  a->owner = 0;
+  a->next_owned = -1;
+  snprintf (a->id, sizeof a->id, "%d.%u", i, a->generation);
 
-  shash_insert (session->actions, action_str, a);
+  return a;
+}
 
-  return action_str;
+/* Put a slot back on the free list. */
+static void
+free_action (ml_session session, struct action *a)
+{
+  a->callback_fn = 0;
+  a->data = 0;
+  a->generation++;
+  a->next_free = session->actions_free;
+  session->actions_free = a->index;
 }
 
 void
 ml_unregister_action (ml_session session, const char *action_id)
 {
-  shash_erase (session->actions, action_id);
+  struct action *a = get_action (session, action_id);
+  int *p;
+
+  if (a)
+    {
+      /* Take it off its owner's list, so the owner's cleanup function
+       * doesn't unregister whatever reuses the slot.
+       */
+      if (a->owner)
+	{
+	  p = &a->owner->first;
+	  while (*p != a->index)
+	    p = &session->actions[*p]->next_owned;
+	  *p = a->next_owned;
+	  a->owner = 0;
+	}
+
+      free_action (session, a);
+    }
 }
 
 #define CRLF "\015\012"
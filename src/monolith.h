@@ -60,7 +60,29 @@ typedef struct ml_session *ml_session;
  * See @code{examples/01_label_and_button.c} for a simple monolith
  * application.
  *
- * See also: @ref{ml_session_pool(3)},
+ * The memory used by sessions can be limited with these configuration
+ * file settings (both in kilobytes, and both default to 0 meaning no
+ * limit):
+ *
+ * @code{monolith session max size}: sessions which grow larger than
+ * this are killed.
+ *
+ * @code{monolith sessions memory budget}: when the total size of all
+ * sessions exceeds this, the least recently used and largest sessions
+ * are killed until the total is back under the budget.
+ *
+ * Requests can be given a time limit with the @code{monolith request
+ * deadline} setting (in seconds, default 0 meaning no limit). See
+ * @ref{ml_session_check_request(3)}.
+ *
+ * Pages are compressed with gzip (or deflate) for browsers which say
+ * they accept it in their @code{Accept-Encoding} header. The zlib
+ * compression level is set by @code{monolith compression level}
+ * (1-9, default 6, or 0 to turn compression off). Pages smaller than
+ * @code{monolith compression threshold} bytes (default 1024) are not
+ * worth compressing, and are sent as they are.
+ *
+ * See also: @ref{ml_session_check_request(3)}, @ref{ml_session_pool(3)},
  * @ref{rws_request_pool(3)}, @ref{new_ml_window(3)},
  * @ref{ml_cfg_get_string(3)}.
  */
@@ -139,8 +161,42 @@ extern ml_window ml_session_get_main_window (ml_session);
 extern int ml_session_get_peername (ml_session, struct sockaddr *name, socklen_t *namelen);
 extern const char *ml_session_get_peernamestr (ml_session);
 
+/* Function: ml_session_check_request - abandon requests nobody is waiting for
+ *
+ * If the browser gives up on a request (the user presses stop, or
+ * goes to another page), or the request has run for longer than the
+ * @code{monolith request deadline} configuration setting allows, then
+ * there is no point carrying on with it. Monolith checks for this
+ * whenever a widget is repainted and whenever a database handle is
+ * borrowed. If the request should be abandoned, the rest of the
+ * action or repaint is skipped, any database handles are given back
+ * (and rolled back), and the connection is closed. If the response
+ * has not been started, a browser which is still waiting gets an
+ * error page explaining that the request took too long.
+ *
+ * A request may be stuck waiting for a query when this happens, so
+ * while an action or repaint holds database handles, monolith also
+ * checks the request once a second. If it should be abandoned, the
+ * PostgreSQL server is asked to cancel whatever the request's handles
+ * are running (the dbi library has no way to cancel a query on the
+ * handle itself, so this is done with @code{pg_cancel_backend} over a
+ * separate connection). The query then fails, and the request is
+ * abandoned as above. As a backstop, when requests have a deadline,
+ * the handles have their @code{statement_timeout} set to the same
+ * length, so that the server cancels any query which runs for longer
+ * than a whole request is allowed to.
+ *
+ * @code{ml_session_check_request} performs the same check, and can be
+ * called by application code which does a lot of work between
+ * repaints or queries. If the request should be abandoned, it does
+ * not return.
+ */
+extern void ml_session_check_request (ml_session);
+
 /* Function: ml_session_release_lock
  * Function: ml_session_acquire_lock
+ * Function: ml_session_begin_update
+ * Function: ml_session_end_update
  *
  * These are advanced functions which you will probably never need to use.
  *
@@ -154,10 +210,15 @@ extern const char *ml_session_get_peernamestr (ml_session);
  * normal conditions, particularly in framesets (the browser fetches
  * each frame at the same time).
  *
- * To avoid this situation, monolith maintains a mutex lock on each
- * session structure, so that no two threads can try to access the
- * same session structure at the same time. (Different sessions can
- * execute concurrently, of course).
+ * To avoid this situation, monolith maintains a reader/writer lock on
+ * each session structure. Requests which run an action callback (and
+ * requests which start a new session) take the lock exclusively, so
+ * no other thread can access the session structure at the same time.
+ * Requests which only repaint a window (those without an action, and
+ * HEAD requests) share the lock, so for example the frames of a
+ * frameset which are already built can be repainted concurrently.
+ * Such requests must not change the session or its widgets. (Different
+ * sessions can execute concurrently, of course).
  *
  * Monolith's session locking is normally transparent to programmers
  * and users, but these functions allow you to bypass the session
@@ -169,19 +230,49 @@ extern const char *ml_session_get_peernamestr (ml_session);
  * potentially allows other threads to run, overwriting parts of the
  * session structure.
  *
- * @code{ml_session_acquire_lock} reacquires the session lock, possibly
- * sleeping to do so. This does not restore the session structure which
- * will still be in a semi-corrupted state.
- *
- * In future we will add functions to allow @code{ml_session_acquire_lock}
- * to restore the session structure to a non-corrupt state, perhaps by
- * having a stack of session structures (or some parts of the session
- * structure).
- *
- * See also: @ref{new_pseudothread(3)}, @ref{new_mutex(3)}.
+ * @code{ml_session_acquire_lock} reacquires the session lock
+ * exclusively, possibly sleeping to do so. This does not restore the
+ * session structure which will still be in a semi-corrupted state.
+ *
+ * A widget which needs to change state while it is being repainted
+ * (for example, to register an action the first time it is drawn)
+ * must bracket the change with @code{ml_session_begin_update} and
+ * @code{ml_session_end_update}. If the current request only has
+ * shared access, @code{ml_session_begin_update} waits for exclusive
+ * access, and @code{ml_session_end_update} goes back to shared access.
+ * Because the lock is dropped briefly while waiting, the widget should
+ * check its state again after @code{ml_session_begin_update} returns.
+ * These calls may be nested.
+ *
+ * See also: @ref{new_pseudothread(3)}, @ref{new_rwlock(3)}.
  */
 extern void ml_session_release_lock (ml_session);
 extern void ml_session_acquire_lock (ml_session);
+extern void ml_session_begin_update (ml_session);
+extern void ml_session_end_update (ml_session);
+
+/* Function: ml_scratch_alloc - per-request scratch memory
+ * Function: ml_scratch_sprintf
+ *
+ * These functions hand out memory which lasts until the end of the
+ * current HTTP request. They are intended for widgets which need
+ * temporary strings while repainting (for example, to format a link),
+ * and are much cheaper than creating a subpool or allocating in the
+ * session pool, which would keep the memory for the life of the
+ * session.
+ *
+ * @code{ml_scratch_alloc} allocates @code{n} bytes, suitably aligned
+ * for any type.
+ *
+ * @code{ml_scratch_sprintf} formats a string, like @code{psprintf}.
+ *
+ * Do not store pointers to scratch memory anywhere which outlives
+ * the request.
+ *
+ * See also: @ref{psprintf(3)}.
+ */
+extern void *ml_scratch_alloc (ml_session, int n);
+extern char *ml_scratch_sprintf (ml_session, const char *fs, ...) __attribute__ ((format (printf, 2, 3)));
 
 /* Database factory object. */
 struct ml_dbh_factory;
@@ -189,7 +280,9 @@ typedef struct ml_dbh_factory *ml_dbh_factory;
 
 /* Function: new_ml_dbh_factory - database handle factories, database connection functions
  * Function: ml_get_dbh
+ * Function: ml_get_dbh_readonly
  * Function: ml_put_dbh
+ * Function: ml_dbh_factory_add_replica
  *
  * Monolith supports database connection pooling through the use
  * of these functions, which are implemented on top of the
@@ -225,6 +318,11 @@ typedef struct ml_dbh_factory *ml_dbh_factory;
  * to the database (database handles themselves must NEVER be passed or
  * stashed in private session storage or global variables).
  *
+ * Versions of the standard monolith schemas for SQLite are installed
+ * in the @code{sqlite} subdirectory next to the PostgreSQL ones, for
+ * use by other tools. Factories themselves only support PostgreSQL,
+ * since the dbi library passes @code{conninfo} straight to libpq.
+ *
  * @code{ml_get_dbh} produces a database handle from the factory. This
  * handle is valid until one of the following points in time:
  * (a) the code voluntarily gives up the handle by calling
@@ -234,14 +332,35 @@ typedef struct ml_dbh_factory *ml_dbh_factory;
  * the database handle is automatically recovered at the end of the
  * current HTTP request).
  *
+ * @code{ml_get_dbh_readonly} is the same as @code{ml_get_dbh}, but
+ * the handle is put into read only mode, so that any attempt to modify
+ * the database through it fails. Read only transactions are cheaper
+ * for the database server, so code which only runs queries (such as
+ * most @code{repaint} functions) should use this.
+ *
+ * @code{ml_dbh_factory_add_replica} adds a read replica of the
+ * database to the factory. @code{conninfo} describes how to connect
+ * to the replica. Adding the same replica again does nothing, so this
+ * can be called in @code{app_main} straight after
+ * @code{new_ml_dbh_factory}. When a factory has replicas,
+ * @code{ml_get_dbh_readonly} takes handles from the replica with the
+ * fewest handles in use, unless a read write handle was given back
+ * to the factory within the last @code{monolith dbh replica lag}
+ * seconds (a configuration file setting, default 2), since the
+ * replicas might not yet have seen the changes. If a replica cannot
+ * be reached, it is left alone for a while and the handle comes from
+ * another replica or the primary instead. @code{ml_get_dbh} always
+ * returns a handle to the primary database. Replicas use the same
+ * settings as the primary, and share its registered statements.
+ *
  * @code{ml_put_dbh} voluntarily relinquishes the database handle.
  *
  * When the database handle is recovered - voluntarily or automatically -
- * monolith performs a rollback on the handle, and then puts the handle
- * back into its pool, ready to be taken by another session or
- * application. If you need to keep data which was modified in the
- * database transaction, then remember to do a @code{db_commit} on
- * the handle.
+ * monolith performs a rollback on the handle (if a transaction is
+ * open), and then puts the handle back into its pool, ready to be
+ * taken by another session or application. If you need to keep data
+ * which was modified in the database transaction, then remember to do
+ * a @code{db_commit} on the handle.
  *
  * Applications running in the same @code{rws} instance may share
  * database handles (provided, of course, they are both connected to
@@ -250,6 +369,44 @@ typedef struct ml_dbh_factory *ml_dbh_factory;
  * Calling @code{ml_get_dbh} twice in a row returns two different
  * and independent database handles.
  *
+ * The number of handles in each factory is controlled by the
+ * following configuration file settings:
+ *
+ * @code{monolith dbh max handles}: the maximum number of handles
+ * which may be open at once (default 0 meaning no limit). When all
+ * the handles are in use, @code{ml_get_dbh} waits until another
+ * thread gives one back. Waiting threads are served in the order
+ * in which they arrived. A request which is waiting gives up (and
+ * is abandoned, as described under @ref{ml_session_check_request(3)})
+ * when it reaches its deadline or the browser goes away. Note that a
+ * thread which borrows a second handle while holding on to the first
+ * can deadlock if this is set too low.
+ *
+ * @code{monolith dbh min handles}: the number of handles which are
+ * opened when the factory is created, and kept open even when they
+ * are not being used (default 0).
+ *
+ * @code{monolith dbh max idle}: free handles which have not been used
+ * for this many seconds are closed, down to the minimum (default 300,
+ * or 0 to never close handles).
+ *
+ * Because factories are shared, the settings are taken from the
+ * configuration of whichever application called
+ * @code{new_ml_dbh_factory} most recently. A free handle which has
+ * been idle for a while is checked before it is handed out, and if
+ * the connection has died it is quietly replaced.
+ *
+ * The dbi library talks to the database server asynchronously: while
+ * a query (or a new connection) is waiting for the server, the
+ * calling thread sleeps in the reactor and other requests carry on
+ * running. So a slow query holds up only the request which issued it
+ * (and the handle it is using), and there is no need to start
+ * threads of your own just to avoid stalling the server. The flip
+ * side is that any call which touches the database, including
+ * @code{ml_get_dbh} itself, can let other threads run, and shared
+ * state (for instance, a global cache or another session's data) may
+ * have changed by the time it returns.
+ *
  * Because of the way monolith connection pooling works, it is not
  * possible to ask monolith for a database handle which is valid
  * throughout an entire session. This is undesirable because this
@@ -268,11 +425,56 @@ typedef struct ml_dbh_factory *ml_dbh_factory;
  */
 extern ml_dbh_factory new_ml_dbh_factory (ml_session, const char *conninfo);
 extern db_handle ml_get_dbh (ml_session, ml_dbh_factory);
+extern db_handle ml_get_dbh_readonly (ml_session, ml_dbh_factory);
 extern void ml_put_dbh (ml_session, db_handle);
+extern void ml_dbh_factory_add_replica (ml_dbh_factory, const char *conninfo);
+
+/* Statement registered with a database handle factory. */
+struct ml_statement;
+typedef struct ml_statement *ml_statement;
+
+/* Maximum number of placeholders in a registered statement. */
+#define ML_STATEMENT_MAX_ARGS 12
+
+/* Function: ml_register_statement - registered database statements
+ * Function: new_ml_statement
+ * Function: ml_prepare
+ *
+ * Normally the statements used with a database handle are prepared
+ * (using @code{st_prepare_cached}) the first time that they are
+ * needed on that handle. When the factory opens a new connection,
+ * the first few requests to use it therefore pay for preparing every
+ * statement again. Registering the statements with the factory avoids
+ * this, since registered statements are prepared on each connection
+ * as soon as it is opened.
+ *
+ * @code{ml_register_statement} registers @code{query} with the
+ * factory @code{dbf}, and returns a @code{ml_statement} object. The
+ * placeholder types are given in the same way as for
+ * @code{st_prepare} (but at most @code{ML_STATEMENT_MAX_ARGS} of
+ * them). Registering the same query string again just returns the
+ * existing statement, so it is fine (and usual) for a widget to
+ * register its statements each time it is created. Statements are
+ * never unregistered.
+ *
+ * @code{ml_prepare} returns the statement prepared on the handle
+ * @code{dbh}, which must have come from the same factory. Use this
+ * in place of @code{st_prepare_cached}, and then execute the statement
+ * as normal.
+ *
+ * The stats application shows how many times each registered
+ * statement has been prepared and used.
+ *
+ * See also: @ref{ml_get_dbh(3)}, @ref{st_prepare(3)}.
+ */
+#define ml_register_statement(dbf,query,types...) new_ml_statement ((dbf), (query) , ## types, 0)
+extern ml_statement new_ml_statement (ml_dbh_factory dbf, const char *query, ...);
+extern st_handle ml_prepare (db_handle dbh, ml_statement);
 
 /* Function: ml_session_login - user authentication, log in, log out
  * Function: ml_session_logout
  * Function: ml_session_userid
+ * Function: ml_session_bad_login
  *
  * These functions provide a low-level, database-independent,
  * authentication-method-agnostic way to handle the problem
@@ -352,10 +554,57 @@ extern void ml_put_dbh (ml_session, db_handle);
  * become logged out (@code{ml_session_userid} will start to return
  * @code{0}). This is because monolith overwrites the @code{ml_auth}
  * cookie with a "poisoned" cookie which other applications may notice.
+ *
+ * @code{ml_session_bad_login} records a failed attempt to log in as
+ * @code{userid} (for example, a wrong password). Login methods which
+ * can fail should call this.
+ *
+ * To keep logging in fast, these functions don't wait for the
+ * database. The changes to @code{ml_user_cookie}, and the login
+ * counts in @code{ml_users} (@code{nr_logins}, @code{lastlogin_date}
+ * and @code{bad_logins}), are queued and written together in one
+ * transaction by a background thread, after the delay given by the
+ * @code{monolith user writes delay} configuration setting (in
+ * milliseconds, default 1000). Within the server, the new cookie
+ * works straight away. Other servers sharing the same database see
+ * it once it has been written. If the database can't be reached,
+ * the writes stay queued and are retried. When the server is stopped
+ * with @code{SIGTERM} or @code{SIGINT}, whatever is still queued is
+ * written (waiting for up to 10 seconds) before it exits. If it is
+ * killed in any other way, or crashes, the writes queued within the
+ * last @code{monolith user writes delay} milliseconds are lost, so
+ * set this lower if that matters more than the extra transactions. If
+ * your users table doesn't have the login count columns, set
+ * @code{monolith user accounting} to false.
  */
 extern void ml_session_login (ml_session, int userid, const char *path, const char *expires);
 extern void ml_session_logout (ml_session, const char *path);
 extern int ml_session_userid (ml_session);
+extern void ml_session_bad_login (ml_session, int userid);
+
+/* Function: ml_auth_cache_invalidate - forget cached login cookies
+ *
+ * When a new session arrives with an @code{ml_auth} cookie, the
+ * cookie has to be looked up in @code{ml_user_cookie} to find out
+ * who the user is. The answers are remembered in a small cache in
+ * the server, so that most returning users don't have to wait for
+ * the database. Cookies which are found are remembered for
+ * @code{monolith auth cache ttl} seconds (default 300). Cookies which
+ * aren't found are remembered for @code{monolith auth cache negative
+ * ttl} seconds (default 10). At most @code{monolith auth cache size}
+ * cookies (default 1024) are remembered, and the least recently used
+ * are forgotten first. Set the size to 0 to turn the cache off.
+ *
+ * Logging in or out through this server updates the cache straight
+ * away. If users can be logged out some other way (by another server
+ * or program sharing the same database), the cache may go on
+ * accepting their old cookie until it expires. Such programs can tell
+ * the server by arranging for @code{ml_auth_cache_invalidate} to be
+ * called (for example, from an application which they request), which
+ * forgets all cached cookies belonging to @code{userid}, or every
+ * cached cookie if @code{userid} is @code{0}.
+ */
+extern void ml_auth_cache_invalidate (int userid);
 
 /* Function: ml_cfg_get_string - get values from the configuration file
  * Function: ml_cfg_get_int
@@ -379,6 +628,7 @@ extern int ml_cfg_get_int (ml_session, const char *key, int default_value);
 extern int ml_cfg_get_bool (ml_session, const char *key, int default_value);
 
 /* Function: ml_register_action - register callbacks
+ * Function: ml_register_action_in_pool
  * Function: ml_unregister_action
  *
  * Widgets such as buttons may register actions (callback functions)
@@ -389,13 +639,22 @@ extern int ml_cfg_get_bool (ml_session, const char *key, int default_value);
  * session, void *data)}.
  *
  * @code{ml_register_action} registers an action within a given
- * session and returns the action ID string.
+ * session and returns the action ID string. The string belongs to the
+ * session and is reused once the action is unregistered, so copy it if
+ * you need it after that.
+ *
+ * @code{ml_register_action_in_pool} is the same, but the action is
+ * also unregistered automatically when @code{pool} is deleted. Widgets
+ * should use this, passing the pool they were allocated in, so that
+ * actions do not outlive their widgets (see
+ * @ref{new_ml_transient_window(3)}).
  *
  * @code{ml_unregister_action} unregisters an action.
  *
  * See also: @ref{new_ml_button(3)}.
  */
 extern const char *ml_register_action (ml_session session, void (*callback_fn) (ml_session, void *), void *data);
+extern const char *ml_register_action_in_pool (ml_session session, pool pool, void (*callback_fn) (ml_session, void *), void *data);
 extern void ml_unregister_action (ml_session session, const char *action_id);
 
 /* Private function used by forms to get the arguments passed just to
@@ -407,13 +666,39 @@ extern cgi _ml_session_submitted_args (ml_session);
 /* Private function used by ml_window to register the current window. */
 extern void _ml_session_set_current_window (ml_session, ml_window, const char *windowid);
 
+/* Private function used by ml_window to register a transient window. */
+extern void _ml_session_add_transient_window (ml_session, ml_window);
+
 /* Some private functions used by the stats package to inspect the internals
  * of monolith. These functions are subject to change and should not be used
  * in ordinary applications.
  */
 extern const vector _ml_get_sessions (pool);
 extern ml_session _ml_get_session (const char *sessionid);
+extern long long _ml_get_sessions_total_size (void);
+extern long long _ml_get_sessions_memory_budget (void);
+extern int _ml_get_session_max_size (void);
+extern int _ml_get_nr_sessions_evicted (void);
+extern int _ml_get_nr_sessions_over_quota (void);
+extern int _ml_get_nr_requests_coalesced (void);
+extern int _ml_get_nr_pages_shared (void);
+extern int _ml_get_nr_duplicate_submits (void);
+extern int _ml_get_nr_deadline_cancels (void);
+extern int _ml_get_nr_disconnect_cancels (void);
+extern int _ml_get_nr_queries_cancelled (void);
+extern int _ml_get_nr_not_modified (void);
+extern long long _ml_get_bytes_not_modified (void);
+extern int _ml_get_nr_auth_writes_queued (void);
+extern int _ml_get_nr_auth_writes (void);
+extern int _ml_get_nr_auth_write_failures (void);
+extern int _ml_get_nr_auth_accounting_failures (void);
+extern int _ml_get_auth_cache_size (void);
+extern int _ml_get_nr_auth_cache_hits (void);
+extern int _ml_get_nr_auth_cache_misses (void);
+extern int _ml_get_nr_windows_retired (void);
+extern long long _ml_get_windows_retired_size (void);
 extern int _ml_session_get_hits (ml_session);
+extern int _ml_session_get_size (ml_session);
 extern reactor_time_t _ml_session_get_last_access (ml_session);
 extern reactor_time_t _ml_session_get_created (ml_session);
 extern struct sockaddr_in _ml_session_get_original_ip (ml_session);
@@ -428,5 +713,24 @@ extern const vector _ml_get_dbh_factories (pool);
 extern ml_dbh_factory _ml_get_dbh_factory (const char *conninfo);
 extern int _ml_dbh_factory_get_nr_allocated_handles (ml_dbh_factory);
 extern int _ml_dbh_factory_get_nr_free_handles (ml_dbh_factory);
+extern int _ml_dbh_factory_get_max_handles (ml_dbh_factory);
+extern int _ml_dbh_factory_get_min_handles (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_waiters (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_reaped (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_dead (ml_dbh_factory);
+extern const vector _ml_dbh_factory_get_replicas (ml_dbh_factory, pool);
+extern const char *_ml_dbh_factory_get_conninfo (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_replica_reads (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_replica_failures (ml_dbh_factory);
+extern int _ml_dbh_factory_is_down (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_rollbacks (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_rollbacks_skipped (ml_dbh_factory);
+extern int _ml_dbh_factory_get_nr_waits (ml_dbh_factory, int bucket);
+extern int _ml_dbh_factory_is_busy (ml_dbh_factory);
+extern const vector _ml_dbh_factory_get_statements (ml_dbh_factory, pool);
+extern ml_dbh_factory _ml_statement_get_factory (ml_statement);
+extern const char *_ml_statement_get_query (ml_statement);
+extern int _ml_statement_get_nr_prepares (ml_statement);
+extern int _ml_statement_get_nr_executes (ml_statement);
 
 #endif /* MONOLITH_H */
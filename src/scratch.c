@@ -0,0 +1,190 @@
+/* Monolith per-request scratch memory.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include <pool.h>
+
+#include "scratch.h"
+
+/* Widgets often need a few bytes of memory while they are repainting,
+ * for example to format a link. Creating a subpool for this, or
+ * allocating in a longer-lived pool, costs a malloc (or several) for
+ * every widget on every page.
+ *
+ * Instead, each request gets an arena which hands out memory by bumping
+ * a pointer through fixed-size chunks. When the request finishes, its
+ * chunks go back on a global free list and are reused by the next
+ * request, so once the server has warmed up, rendering a page does not
+ * call malloc at all.
+ *
+ * (Pseudothreads are cooperative and nothing here blocks, so the free
+ * list doesn't need a lock).
+ */
+#define CHUNK_SIZE 16384	/* Usable bytes in each chunk. */
+#define MAX_FREE_CHUNKS 64	/* Chunks kept on the free list. */
+#define ALIGNMENT 8
+
+struct chunk
+{
+  struct chunk *next;		/* Next chunk in list. */
+  int size;			/* Usable bytes in this chunk. */
+  double data[1];		/* Data (double forces alignment). */
+};
+
+#define CHUNK_HEADER_SIZE ((int) (long) &((struct chunk *) 0)->data)
+
+struct scratch
+{
+  struct chunk *chunks;		/* Chunks in use (current one first). */
+  int used;			/* Bytes used in the current chunk. */
+};
+
+static struct chunk *free_chunks = 0;
+static int nr_free_chunks = 0;
+
+static struct chunk *
+get_chunk (int size)
+{
+  struct chunk *c;
+
+  if (size == CHUNK_SIZE && free_chunks)
+    {
+      c = free_chunks;
+      free_chunks = c->next;
+      nr_free_chunks--;
+      return c;
+    }
+
+  c = malloc (CHUNK_HEADER_SIZE + size);
+  if (c == 0) abort ();
+  c->size = size;
+  return c;
+}
+
+static void
+release_scratch (void *vp)
+{
+  scratch s = (scratch) vp;
+  struct chunk *c, *next;
+
+  for (c = s->chunks; c; c = next)
+    {
+      next = c->next;
+
+      if (c->size == CHUNK_SIZE && nr_free_chunks < MAX_FREE_CHUNKS)
+	{
+	  c->next = free_chunks;
+	  free_chunks = c;
+	  nr_free_chunks++;
+	}
+      else
+	free (c);
+    }
+
+  s->chunks = 0;
+}
+
+scratch
+new_scratch (pool pool)
+{
+  scratch s = pmalloc (pool, sizeof *s);
+
+  s->chunks = 0;
+  s->used = 0;
+  pool_register_cleanup_fn (pool, release_scratch, s);
+
+  return s;
+}
+
+void *
+scratch_alloc (scratch s, int n)
+{
+  struct chunk *c;
+  void *p;
+
+  n = (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+  if (n > CHUNK_SIZE)
+    {
+      /* Big allocations get a chunk of their own, which goes behind the
+       * current chunk so we can carry on using the current chunk.
+       */
+      c = get_chunk (n);
+      if (s->chunks)
+	{
+	  c->next = s->chunks->next;
+	  s->chunks->next = c;
+	}
+      else
+	{
+	  c->next = 0;
+	  s->chunks = c;
+	  s->used = n;
+	}
+      return c->data;
+    }
+
+  if (!s->chunks || s->used + n > s->chunks->size)
+    {
+      c = get_chunk (CHUNK_SIZE);
+      c->next = s->chunks;
+      s->chunks = c;
+      s->used = 0;
+    }
+
+  p = (char *) s->chunks->data + s->used;
+  s->used += n;
+  return p;
+}
+
+char *
+scratch_vsprintf (scratch s, const char *fs, va_list args)
+{
+  va_list args_copy;
+  char *str;
+  int n, avail;
+
+  /* Usually the string fits in the rest of the current chunk, so try
+   * formatting it there first.
+   */
+  avail = s->chunks ? s->chunks->size - s->used : 0;
+  str = s->chunks ? (char *) s->chunks->data + s->used : 0;
+
+  va_copy (args_copy, args);
+  n = vsnprintf (str, avail, fs, args_copy);
+  va_end (args_copy);
+
+  if (n < avail)
+    {
+      s->used += (n + 1 + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+      if (s->used > s->chunks->size) s->used = s->chunks->size;
+      return str;
+    }
+
+  str = scratch_alloc (s, n + 1);
+  vsnprintf (str, n + 1, fs, args);
+
+  return str;
+}
@@ -0,0 +1,47 @@
+/* Monolith per-request scratch memory.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#ifndef SCRATCH_H
+#define SCRATCH_H
+
+#include <stdarg.h>
+
+#include <pool.h>
+
+/* This is a private header file used only inside the monolith core
+ * library. It is not installed.
+ */
+
+struct scratch;
+typedef struct scratch *scratch;
+
+/* Create a new scratch arena. The small arena structure is allocated
+ * in pool, and when pool is deleted all the memory handed out by the
+ * arena is released in one go.
+ */
+extern scratch new_scratch (pool);
+
+/* Allocate n bytes (aligned for any type) from the arena. */
+extern void *scratch_alloc (scratch, int n);
+
+/* Format a string into the arena. */
+extern char *scratch_vsprintf (scratch, const char *fs, va_list args);
+
+#endif /* SCRATCH_H */
@@ -0,0 +1,304 @@
+/* Monolith session directory.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#endif
+
+#include <pool.h>
+#include <vector.h>
+
+#include "session_table.h"
+
+/* The directory is split into a fixed number of shards, chosen by the
+ * top bits of the hashed key. Each shard is an open-addressing table
+ * with linear probing. Splitting the table means that when a shard
+ * fills up we only have to rehash 1/NR_SHARDS of the sessions, so the
+ * unlucky request which triggers a resize doesn't stall for long.
+ *
+ * (Pseudothreads are cooperative and nothing here blocks, so the shards
+ * don't need locks).
+ */
+#define NR_SHARDS_BITS 4
+#define NR_SHARDS (1 << NR_SHARDS_BITS)
+#define INITIAL_SHARD_SIZE 64	/* Must be a power of 2. */
+
+struct entry
+{
+  struct session_key key;
+  void *value;			/* NULL = empty slot. */
+};
+
+struct shard
+{
+  pool pool;			/* Pool holding the current slots array. */
+  struct entry *slots;		/* Array of slots. */
+  int size;			/* Number of slots (power of 2). */
+  int used;			/* Number of slots in use. */
+};
+
+struct session_table
+{
+  pool pool;			/* Pool for allocations. */
+  int nr_entries;		/* Total entries in all shards. */
+  struct shard shards[NR_SHARDS];
+};
+
+static inline int
+hexval (char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+int
+session_key_parse (const char *sessionid, struct session_key *key)
+{
+  unsigned long long hi = 0, lo = 0;
+  int i, v;
+
+  for (i = 0; i < 16; ++i)
+    {
+      if ((v = hexval (sessionid[i])) == -1) return 0;
+      hi = (hi << 4) | v;
+    }
+  for (i = 16; i < 32; ++i)
+    {
+      if ((v = hexval (sessionid[i])) == -1) return 0;
+      lo = (lo << 4) | v;
+    }
+  if (sessionid[32] != '\0') return 0;
+
+  key->hi = hi;
+  key->lo = lo;
+  return 1;
+}
+
+/* Session IDs are random, but the keys we are asked to look up come
+ * from cookies which anyone can forge, so mix the bits anyway.
+ */
+static inline unsigned long long
+hash_key (const struct session_key *key)
+{
+  unsigned long long h = key->lo ^ (key->hi * 0x9e3779b97f4a7c15ULL);
+
+  h ^= h >> 29;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+static inline int
+key_equal (const struct session_key *a, const struct session_key *b)
+{
+  return a->lo == b->lo && a->hi == b->hi;
+}
+
+static inline struct shard *
+get_shard (session_table t, unsigned long long h)
+{
+  return &t->shards[h >> (64 - NR_SHARDS_BITS)];
+}
+
+static void
+init_shard (pool parent, struct shard *s, int size)
+{
+  s->pool = new_subpool (parent);
+  s->slots = pcalloc (s->pool, size, sizeof (struct entry));
+  s->size = size;
+  s->used = 0;
+}
+
+session_table
+new_session_table (pool pool)
+{
+  session_table t = pmalloc (pool, sizeof *t);
+  int i;
+
+  t->pool = pool;
+  t->nr_entries = 0;
+  for (i = 0; i < NR_SHARDS; ++i)
+    init_shard (pool, &t->shards[i], INITIAL_SHARD_SIZE);
+
+  return t;
+}
+
+/* Find the slot for key in the shard. Returns the index of the matching
+ * slot, or of the empty slot where the key would go.
+ */
+static inline int
+find_slot (const struct shard *s, const struct session_key *key,
+	   unsigned long long h)
+{
+  int mask = s->size - 1;
+  int i = h & mask;
+
+  while (s->slots[i].value && !key_equal (&s->slots[i].key, key))
+    i = (i + 1) & mask;
+
+  return i;
+}
+
+static void
+grow_shard (session_table t, struct shard *s)
+{
+  struct shard new_s;
+  int i, j;
+
+  init_shard (t->pool, &new_s, s->size * 2);
+
+  for (i = 0; i < s->size; ++i)
+    if (s->slots[i].value)
+      {
+	j = find_slot (&new_s, &s->slots[i].key, hash_key (&s->slots[i].key));
+	new_s.slots[j] = s->slots[i];
+	new_s.used++;
+      }
+
+  assert (new_s.used == s->used);
+
+  delete_pool (s->pool);
+  *s = new_s;
+}
+
+void *
+session_table_get (session_table t, const struct session_key *key)
+{
+  unsigned long long h = hash_key (key);
+  struct shard *s = get_shard (t, h);
+
+  return s->slots[find_slot (s, key, h)].value;
+}
+
+void
+session_table_insert (session_table t, const struct session_key *key,
+		      void *value)
+{
+  unsigned long long h = hash_key (key);
+  struct shard *s = get_shard (t, h);
+  int i;
+
+  assert (value != 0);
+
+  /* Keep the load factor below 3/4. */
+  if ((s->used + 1) * 4 > s->size * 3)
+    grow_shard (t, s);
+
+  i = find_slot (s, key, h);
+  if (!s->slots[i].value)
+    {
+      s->used++;
+      t->nr_entries++;
+    }
+  s->slots[i].key = *key;
+  s->slots[i].value = value;
+}
+
+int
+session_table_erase (session_table t, const struct session_key *key)
+{
+  unsigned long long h = hash_key (key);
+  struct shard *s = get_shard (t, h);
+  int mask = s->size - 1;
+  int i, j, k;
+
+  i = find_slot (s, key, h);
+  if (!s->slots[i].value) return 0;
+
+  /* Backward-shift deletion: move any following entries in the same
+   * probe run down into the hole, so we never need tombstones.
+   */
+  j = i;
+  for (;;)
+    {
+      s->slots[i].value = 0;
+
+      for (;;)
+	{
+	  j = (j + 1) & mask;
+	  if (!s->slots[j].value) goto done;
+
+	  /* The entry at j can be moved into the hole at i only if its
+	   * home slot k does not lie cyclically in (i, j].
+	   */
+	  k = hash_key (&s->slots[j].key) & mask;
+	  if (i <= j ? (k <= i || j < k) : (k <= i && j < k))
+	    break;
+	}
+
+      s->slots[i] = s->slots[j];
+      i = j;
+    }
+
+ done:
+  s->used--;
+  t->nr_entries--;
+  return 1;
+}
+
+int
+session_table_size (session_table t)
+{
+  return t->nr_entries;
+}
+
+static int
+compare_entries (const void *av, const void *bv)
+{
+  const struct entry *a = (const struct entry *) av;
+  const struct entry *b = (const struct entry *) bv;
+
+  if (a->key.hi != b->key.hi) return a->key.hi < b->key.hi ? -1 : 1;
+  if (a->key.lo != b->key.lo) return a->key.lo < b->key.lo ? -1 : 1;
+  return 0;
+}
+
+vector
+session_table_values (session_table t, pool pool)
+{
+  struct pool *tmp = new_subpool (pool);
+  vector entries = new_vector (tmp, struct entry);
+  vector values = new_vector (pool, void *);
+  struct entry e;
+  int i, j;
+
+  for (i = 0; i < NR_SHARDS; ++i)
+    for (j = 0; j < t->shards[i].size; ++j)
+      if (t->shards[i].slots[j].value)
+	vector_push_back (entries, t->shards[i].slots[j]);
+
+  vector_sort (entries, compare_entries);
+
+  for (i = 0; i < vector_size (entries); ++i)
+    {
+      vector_get (entries, i, e);
+      vector_push_back (values, e.value);
+    }
+
+  delete_pool (tmp);
+  return values;
+}
@@ -0,0 +1,73 @@
+/* Monolith session directory.
+ * - by Richard W.M. Jones <rich@annexia.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * $Id$
+ */
+
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include <pool.h>
+#include <vector.h>
+
+/* This is a private header file used only inside the monolith core
+ * library. It is not installed.
+ */
+
+/* A session ID is a string of 32 hex digits, which is just a 128 bit
+ * random number. We decode it once when the request comes in and from
+ * then on only deal with the binary form.
+ */
+struct session_key
+{
+  unsigned long long hi, lo;
+};
+
+struct session_table;
+typedef struct session_table *session_table;
+
+/* Decode a session ID string into a key. Returns 0 if the string is
+ * not exactly 32 hex digits, else 1.
+ */
+extern int session_key_parse (const char *sessionid, struct session_key *key);
+
+/* Create a new, empty session directory in the pool. */
+extern session_table new_session_table (pool);
+
+/* Look up a key. Returns the value, or NULL if not found. */
+extern void *session_table_get (session_table, const struct session_key *);
+
+/* Insert a key. The value must not be NULL. If the key is already
+ * present, its value is replaced.
+ */
+extern void session_table_insert (session_table, const struct session_key *, void *value);
+
+/* Erase a key. Returns 1 if the key was found, else 0. */
+extern int session_table_erase (session_table, const struct session_key *);
+
+/* Number of entries in the table. */
+extern int session_table_size (session_table);
+
+/* Return the values in the table as a vector (allocated in pool).
+ * The values are returned sorted by key, so the order is stable across
+ * calls regardless of how the table has been resized or rearranged in
+ * between, and callers may insert or erase keys while walking the
+ * returned vector.
+ */
+extern vector session_table_values (session_table, pool);
+
+#endif /* SESSION_TABLE_H */
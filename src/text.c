@@ -34,18 +34,28 @@
 #include "ml_smarttext.h"
 
 void
-ml_plaintext_print (io_handle io, const char *text)
+ml_plaintext_print (ml_output io, const char *text)
 {
+  int n;
+
   while (*text)
     {
+      /* Copy runs of characters which don't need escaping in one go. */
+      n = strcspn (text, "<>\n&\"");
+      if (n > 0)
+	{
+	  ml_output_write (io, text, n);
+	  text += n;
+	  continue;
+	}
+
       switch (*text)
 	{
-	default: io_fputc (*text, io); break;
-	case '<': io_fputs ("&lt;", io); break;
-	case '>': io_fputs ("&gt;", io); break;
-	case '\n': io_fputs ("<br>", io); break;
-	case '&': io_fputs ("&amp;", io); break;
-	case '"': io_fputs ("&quot;", io); break;
+	case '<': ml_output_puts_static (io, "&lt;"); break;
+	case '>': ml_output_puts_static (io, "&gt;"); break;
+	case '\n': ml_output_puts_static (io, "<br>"); break;
+	case '&': ml_output_puts_static (io, "&amp;"); break;
+	case '"': ml_output_puts_static (io, "&quot;"); break;
 	}
       text++;
     }
@@ -122,21 +132,10 @@ ml_plaintext_to_html (pool pool, const char *text)
 }
 
 void
-ml_smarttext_print (io_handle io, const char *text)
-{
-  pool tmp = new_subpool (global_pool);
-  const char *s;
-
-  s = ml_smarttext_to_html (tmp, text);
-  io_fputs (s, io);
-  delete_pool (tmp);
-}
-
-void
-ml_filterhtml_print (io_handle io, const char *text)
+ml_filterhtml_print (ml_output io, const char *text)
 {
   /* XXX NOT IMPLEMENTED XXX */
-  io_fputs (text, io);
+  ml_output_puts (io, text);
 }
 
 const char *
@@ -147,7 +146,7 @@ ml_filterhtml_to_html (pool pool, const char *text)
 }
 
 void
-ml_anytext_print (io_handle io, const char *text, char type)
+ml_anytext_print (ml_output io, const char *text, char type)
 {
   switch (type)
     {
@@ -31,8 +31,10 @@
 #include <pstring.h>
 #include <pre.h>
 #include <pthr_iolib.h>
+#include <pthr_pseudothread.h>
 
 #include "monolith.h"
+#include "ml_query_cache.h"
 #include "ml_widget.h"
 #include "ml_button.h"
 #include "ml_window.h"
@@ -48,7 +50,7 @@
 #include "ml_form_submit.h"
 #include "ml_bulletins.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations bulletins_ops =
   {
@@ -61,10 +63,14 @@ struct ml_bulletins
   pool pool;			/* Pool for allocations. */
   ml_session session;		/* Current session. */
   ml_dbh_factory dbf;		/* Database factory. */
+  const char *section_name;	/* Name of the section. */
+  ml_statement get_sectionid, count_items, get_items, check_poster,
+    insert_item;		/* Statements used by the widget. */
   int sectionid;		/* Which section? */
   int first_item;		/* First item to display. */
   int nr_items;			/* Number of items to display on each page. */
   ml_button post, home, prev, next; /* Buttons along the bottom. */
+  int home_on, prev_on, next_on; /* Which buttons are enabled. */
 
   /* These are used during posting. */
   ml_form_textarea post_item;
@@ -73,7 +79,7 @@ struct ml_bulletins
   ml_form_text post_link_text;
 };
 
-static int can_post (db_handle dbh, int sectionid, int userid);
+static int can_post (ml_bulletins w, db_handle dbh, int userid);
 static void post (ml_session, void *vw);
 static void update_buttons (ml_bulletins w);
 static void home_button (ml_session, void *vw);
@@ -81,13 +87,113 @@ static void prev_button (ml_session, void *vw);
 static void next_button (ml_session, void *vw);
 static void post_button (ml_session, void *vw);
 
+/* The functions below fetch query results into the shared query cache
+ * (see ml_query_cache_get). Everything they return must be allocated
+ * in the pool passed to them.
+ */
+static void *
+fetch_sectionid (pool pool, db_handle dbh, void *vw)
+{
+  ml_bulletins w = (ml_bulletins) vw;
+  st_handle sth;
+  int *sectionid = pmalloc (pool, sizeof *sectionid);
+
+  sth = ml_prepare (dbh, w->get_sectionid);
+  st_execute (sth, w->section_name);
+
+  st_bind (sth, 0, *sectionid, DBI_INT);
+
+  if (!st_fetch (sth)) return 0;
+  return sectionid;
+}
+
+static void *
+fetch_count (pool pool, db_handle dbh, void *vw)
+{
+  ml_bulletins w = (ml_bulletins) vw;
+  st_handle sth;
+  int *count = pmalloc (pool, sizeof *count);
+
+  sth = ml_prepare (dbh, w->count_items);
+  st_execute (sth);
+
+  st_bind (sth, 0, *count, DBI_INT);
+  if (!st_fetch (sth))
+    pth_die ("select count(*) returned no rows!");
+
+  return count;
+}
+
+struct is_poster_args
+{
+  ml_bulletins w;
+  int userid;
+};
+
+static void *
+fetch_is_poster (pool pool, db_handle dbh, void *vargs)
+{
+  struct is_poster_args *args = (struct is_poster_args *) vargs;
+  int *is_poster = pmalloc (pool, sizeof *is_poster);
+
+  *is_poster = can_post (args->w, dbh, args->userid);
+  return is_poster;
+}
+
+struct item
+{
+  char *item, *item_type, *username, *posted_date, *timediff,
+    *link, *link_text;
+};
+
+/* Strings fetched from the database may be NULL. */
+static inline char *
+copy_str (pool pool, const char *str)
+{
+  return str ? pstrdup (pool, str) : 0;
+}
+
+/* Returns a vector of struct item. */
+static void *
+fetch_items (pool pool, db_handle dbh, void *vw)
+{
+  ml_bulletins w = (ml_bulletins) vw;
+  st_handle sth;
+  vector items = new_vector (pool, struct item);
+  struct item row, copy;
+
+  sth = ml_prepare (dbh, w->get_items);
+  st_execute (sth, w->sectionid, w->nr_items, w->first_item);
+
+  st_bind (sth, 0, row.item, DBI_STRING);
+  st_bind (sth, 1, row.item_type, DBI_STRING);
+  st_bind (sth, 2, row.username, DBI_STRING);
+  st_bind (sth, 3, row.posted_date, DBI_STRING);
+  st_bind (sth, 4, row.timediff, DBI_STRING);
+  st_bind (sth, 5, row.link, DBI_STRING);
+  st_bind (sth, 6, row.link_text, DBI_STRING);
+
+  while (st_fetch (sth))
+    {
+      copy.item = copy_str (pool, row.item);
+      copy.item_type = copy_str (pool, row.item_type);
+      copy.username = copy_str (pool, row.username);
+      copy.posted_date = copy_str (pool, row.posted_date);
+      copy.timediff = copy_str (pool, row.timediff);
+      copy.link = copy_str (pool, row.link);
+      copy.link_text = copy_str (pool, row.link_text);
+      vector_push_back (items, copy);
+    }
+
+  return items;
+}
+
 ml_bulletins
 new_ml_bulletins (pool pool, ml_session session, ml_dbh_factory dbf,
 		  const char *section_name)
 {
   ml_bulletins w = pmalloc (pool, sizeof *w);
-  db_handle dbh;
-  st_handle sth;
+  const int *sectionid;
 
   w->ops = &bulletins_ops;
   w->pool = pool;
@@ -96,19 +202,47 @@ new_ml_bulletins (pool pool, ml_session session, ml_dbh_factory dbf,
   w->first_item = 0;
   w->nr_items = 10;
 
-  /* Get the sectionid. */
-  dbh = ml_get_dbh (session, dbf);
-
-  sth = st_prepare_cached
-    (dbh,
+  /* Register the statements with the factory, so they are already
+   * prepared on new database connections.
+   */
+  w->get_sectionid =
+    ml_register_statement
+    (dbf,
      "select resid from ml_resources where name = ?", DBI_STRING);
-  st_execute (sth, section_name);
-
-  st_bind (sth, 0, w->sectionid, DBI_INT);
-
-  if (!st_fetch (sth)) return 0;
+  w->count_items =
+    ml_register_statement
+    (dbf, "select count (*) from ml_bulletins");
+  w->get_items =
+    ml_register_statement
+    (dbf,
+     "select b.item, b.item_type, u.username, b.posted_date, "
+     "       current_timestamp - b.posted_date, "
+     "       b.link, b.link_text "
+     "from ml_bulletins b, ml_users u "
+     "where b.sectionid = ? and b.authorid = u.userid "
+     "order by 4 desc "
+     "limit ? "
+     "offset ?",
+     DBI_INT, DBI_INT, DBI_INT);
+  w->check_poster =
+    ml_register_statement
+    (dbf,
+     "select 1 from ml_bulletins_posters "
+     "where sectionid = ? and userid = ?", DBI_INT, DBI_INT);
+  w->insert_item =
+    ml_register_statement
+    (dbf,
+     "insert into ml_bulletins "
+     "(sectionid, authorid, item, item_type, link, link_text) "
+     "values (?, ?, ?, ?, ?, ?)",
+     DBI_INT, DBI_INT, DBI_STRING, DBI_STRING, DBI_STRING, DBI_STRING);
 
-  ml_put_dbh (session, dbh);
+  /* Get the sectionid. */
+  w->section_name = pstrdup (pool, section_name);
+  sectionid = ml_query_cache_get (session, w->get_sectionid, section_name,
+				  600, "ml_resources", fetch_sectionid, w);
+  if (!sectionid) return 0;
+  w->sectionid = *sectionid;
 
   /* Create the buttons for the bottom of the page. The home/prev/next
    * buttons get enabled (possibly) in update_buttons. The post button
@@ -122,6 +256,7 @@ new_ml_bulletins (pool pool, ml_session session, ml_dbh_factory dbf,
   w->home = new_ml_button (pool, "Most recent");
   w->prev = new_ml_button (pool, "&lt;&lt;");
   w->next = new_ml_button (pool, "&gt;&gt;");
+  w->home_on = w->prev_on = w->next_on = 0;
   update_buttons (w);
 
   return w;
@@ -158,63 +293,72 @@ next_button (ml_session session, void *vw)
   update_buttons (w);
 }
 
+/* Changing a button's callback gives it a new action ID, which breaks
+ * the links on pages already sent to the browser, so only do it when
+ * the button is actually switched on or off.
+ */
 static inline void
 enable_home (ml_bulletins w)
 {
+  if (w->home_on) return;
   ml_button_set_callback (w->home, home_button, w->session, w);
+  w->home_on = 1;
 }
 
 static inline void
 disable_home (ml_bulletins w)
 {
+  if (!w->home_on) return;
   ml_button_set_callback (w->home, 0, w->session, 0);
+  w->home_on = 0;
 }
 
 static inline void
 enable_prev (ml_bulletins w)
 {
+  if (w->prev_on) return;
   ml_button_set_callback (w->prev, prev_button, w->session, w);
+  w->prev_on = 1;
 }
 
 static inline void
 disable_prev (ml_bulletins w)
 {
+  if (!w->prev_on) return;
   ml_button_set_callback (w->prev, 0, w->session, 0);
+  w->prev_on = 0;
 }
 
 static inline void
 enable_next (ml_bulletins w)
 {
+  if (w->next_on) return;
   ml_button_set_callback (w->next, next_button, w->session, w);
+  w->next_on = 1;
 }
 
 static inline void
 disable_next (ml_bulletins w)
 {
+  if (!w->next_on) return;
   ml_button_set_callback (w->next, 0, w->session, 0);
+  w->next_on = 0;
 }
 
-/* This function updates the state of each button. It consults the
- * database to find out how many articles are present.
+/* This function updates the state of each button. It finds out how
+ * many articles are present from the query cache. It changes the
+ * session's actions, so it must only be called from a callback (or
+ * when the widget is created), never from repaint.
  */
 static void
 update_buttons (ml_bulletins w)
 {
-  db_handle dbh;
-  st_handle sth;
   int count;
 
-  /* Get a database handle. */
-  dbh = ml_get_dbh (w->session, w->dbf);
-
   /* Find out how many articles are present. */
-  sth = st_prepare_cached
-    (dbh, "select count (*) from ml_bulletins");
-  st_execute (sth);
-
-  st_bind (sth, 0, count, DBI_INT);
-  if (!st_fetch (sth))
-    pth_die ("select count(*) returned no rows!");
+  count = *(const int *)
+    ml_query_cache_get (w->session, w->count_items, 0,
+			60, "ml_bulletins", fetch_count, w);
 
   /* Make sure first_item is sensible. */
   if (w->first_item >= count)
@@ -244,13 +388,14 @@ post_button (ml_session session, void *vw)
 {
   ml_bulletins w = (ml_bulletins) vw;
   db_handle dbh;
+  pool pool;
   ml_window win;
   ml_form_layout tbl;
   ml_form form;
   ml_form_submit sub;
 
   /* Get a database handle. */
-  dbh = ml_get_dbh (session, w->dbf);
+  dbh = ml_get_dbh_readonly (session, w->dbf);
 
   /* Is the current user allowed to post? It can happen that this
    * function is called even if the user is not a legitimate poster.
@@ -262,7 +407,7 @@ post_button (ml_session session, void *vw)
    * It's always a good idea to check permissions inside callback
    * functions.
    */
-  if (!can_post (dbh, w->sectionid, ml_session_userid (session)))
+  if (!can_post (w, dbh, ml_session_userid (session)))
     {
       ml_error_window
 	(w->pool, session,
@@ -271,30 +416,33 @@ post_button (ml_session session, void *vw)
       return;
     }
 
-  /* Display the posting form. */
-  win = new_ml_window (session, w->pool);
-  form = new_ml_form (w->pool);
+  /* Display the posting form. This is a new popup window each time,
+   * so let the session discard it (and the form) once it is idle.
+   */
+  win = new_ml_transient_window (session, w->pool);
+  pool = ml_window_pool (win);
+  form = new_ml_form (pool);
   ml_form_set_callback (form, post, session, w);
   ml_widget_set_property (form, "method", "GET");
-  tbl = new_ml_form_layout (w->pool);
+  tbl = new_ml_form_layout (pool);
 
-  w->post_item = new_ml_form_textarea (w->pool, form, 3, 40);
+  w->post_item = new_ml_form_textarea (pool, form, 3, 40);
   ml_form_layout_pack (tbl, "Message:", w->post_item);
 
-  w->post_type = new_ml_form_select (w->pool, form);
+  w->post_type = new_ml_form_select (pool, form);
   ml_form_select_push_back (w->post_type, "Plain text");
   ml_form_select_push_back (w->post_type, "*Smart* text");
   ml_form_select_push_back (w->post_type, "HTML");
   ml_form_select_set_selection (w->post_type, 1); /* XXX From preferences. */
   ml_form_layout_pack (tbl, 0, w->post_type);
 
-  w->post_link = new_ml_form_text (w->pool, form);
+  w->post_link = new_ml_form_text (pool, form);
   ml_form_layout_pack (tbl, "URL:", w->post_link);
 
-  w->post_link_text = new_ml_form_text (w->pool, form);
+  w->post_link_text = new_ml_form_text (pool, form);
   ml_form_layout_pack (tbl, "Link text:", w->post_link_text);
 
-  sub = new_ml_form_submit (w->pool, form, "Post");
+  sub = new_ml_form_submit (pool, form, "Post");
   ml_form_layout_pack (tbl, 0, sub);
 
   /* Pack everything up. */
@@ -339,7 +487,7 @@ post (ml_session session, void *vw)
 
   /* Verify the user can post. See notes above. */
   userid = ml_session_userid (session);
-  if (!can_post (dbh, w->sectionid, userid))
+  if (!can_post (w, dbh, userid))
     {
       ml_error_window
 	(w->pool, session,
@@ -349,18 +497,17 @@ post (ml_session session, void *vw)
     }
 
   /* Insert the posting. */
-  sth = st_prepare_cached
-    (dbh,
-     "insert into ml_bulletins "
-     "(sectionid, authorid, item, item_type, link, link_text) "
-     "values (?, ?, ?, ?, ?, ?)",
-     DBI_INT, DBI_INT, DBI_STRING, DBI_STRING, DBI_STRING, DBI_STRING);
+  sth = ml_prepare (dbh, w->insert_item);
   st_execute (sth, w->sectionid, userid, item, item_type, link, link_text);
 
   /* Commit to the database. */
   db_commit (dbh);
   ml_put_dbh (session, dbh);
 
+  /* Other sessions should see the new posting straight away. */
+  ml_query_cache_invalidate ("ml_bulletins");
+  update_buttons (w);
+
   /* Present a confirmation page. */
   ml_ok_window (w->pool, session,
 		"Item was successfully posted.",
@@ -368,7 +515,7 @@ post (ml_session session, void *vw)
 }
 
 static inline void
-show_item (io_handle io, int n, char *item, char *item_type, char *username,
+show_item (ml_output io, int n, char *item, char *item_type, char *username,
 	   char *posted_date, char *timediff, char *link, char *link_text)
 {
   /* XXX Lots of issues in this block:
@@ -377,106 +524,108 @@ show_item (io_handle io, int n, char *item, char *item_type, char *username,
    * (4) escaping of link text
    * (5) styling of the whole thing
    */
-  io_fprintf (io, "<table width=\"100%%\"><tr>"
-	      "<td rowspan=\"3\" valign=\"top\">%d.</td>",
-	      n);
-  io_fprintf (io, "<td>Posted by <strong>%s</strong> on "
-	      "<strong>%s</strong></td></tr>",
-	      username, posted_date);
-  io_fprintf (io, "<tr><td>%s</td></tr>", item);
+  ml_output_printf (io, "<table width=\"100%%\"><tr>"
+		    "<td rowspan=\"3\" valign=\"top\">%d.</td>",
+		    n);
+  ml_output_printf (io, "<td>Posted by <strong>%s</strong> on "
+		    "<strong>%s</strong></td></tr>",
+		    username, posted_date);
+  ml_output_printf (io, "<tr><td>%s</td></tr>", item);
   if (link && link_text)
-    io_fprintf (io, "<tr><td align=\"right\">"
-		"<a href=\"%s\">%s</a></td></tr>",
-		link, link_text);
+    ml_output_printf (io, "<tr><td align=\"right\">"
+		      "<a href=\"%s\">%s</a></td></tr>",
+		      link, link_text);
   else if (link)
-    io_fprintf (io, "<tr><td align=\"right\">"
-		"<a href=\"%s\">%s</a></td></tr>",
-		link, link);
+    ml_output_printf (io, "<tr><td align=\"right\">"
+		      "<a href=\"%s\">%s</a></td></tr>",
+		      link, link);
   else
-    io_fprintf (io, "<tr><td></td></tr>");
-  io_fprintf (io, "</table>");
+    ml_output_puts_static (io, "<tr><td></td></tr>");
+  ml_output_puts_static (io, "</table>");
+}
+
+static inline const char *
+items_params (ml_bulletins w)
+{
+  return ml_scratch_sprintf (w->session, "%d %d %d",
+			     w->sectionid, w->nr_items, w->first_item);
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_bulletins w = (ml_bulletins) vw;
-  db_handle dbh;
-  st_handle sth;
-  char *item, *item_type, *username, *posted_date, *timediff,
-    *link, *link_text;
-  int n, is_poster;
+  ml_query_batch batch;
+  struct is_poster_args args;
+  vector items;
+  struct item row;
+  int i, n, is_poster, items_q, is_poster_q = -1;
+
+  /* Fetch the headlines, and whether the current user is allowed to
+   * post/remove articles, together on one database handle. These results may come
+   * from the query cache, so they can be slightly out of date (the
+   * headlines are shared by every session looking at the same page of
+   * the same section). That's fine for deciding what to display, but
+   * the callbacks check permissions again.
+   */
+  batch = new_ml_query_batch (pth_get_pool (current_pth), session);
 
-  /* Get a database handle. */
-  dbh = ml_get_dbh (session, w->dbf);
+  items_q = ml_query_batch_add (batch, w->get_items, items_params (w),
+				60, "ml_bulletins ml_users", fetch_items, w);
 
-  /* Is the current user allowed to post/remove articles? */
-  is_poster = can_post (dbh, w->sectionid, ml_session_userid (session));
+  args.w = w;
+  args.userid = ml_session_userid (session);
+  if (args.userid)
+    is_poster_q =
+      ml_query_batch_add (batch, w->check_poster,
+			  ml_scratch_sprintf (session, "%d %d",
+					      w->sectionid, args.userid),
+			  60, "ml_bulletins_posters", fetch_is_poster, &args);
 
-  /* Pull out the headlines. */
-  sth = st_prepare_cached
-    (dbh,
-     "select b.item, b.item_type, u.username, b.posted_date, "
-     "       current_timestamp - b.posted_date, "
-     "       b.link, b.link_text "
-     "from ml_bulletins b, ml_users u "
-     "where b.sectionid = ? and b.authorid = u.userid "
-     "order by 4 desc "
-     "limit ? "
-     "offset ?",
-     DBI_INT, DBI_INT, DBI_INT);
-  st_execute (sth, w->sectionid, w->nr_items, w->first_item);
+  ml_query_batch_run (batch);
 
-  st_bind (sth, 0, item, DBI_STRING);
-  st_bind (sth, 1, item_type, DBI_STRING);
-  st_bind (sth, 2, username, DBI_STRING);
-  st_bind (sth, 3, posted_date, DBI_STRING);
-  st_bind (sth, 4, timediff, DBI_STRING);
-  st_bind (sth, 5, link, DBI_STRING);
-  st_bind (sth, 6, link_text, DBI_STRING);
+  is_poster = is_poster_q >= 0 ?
+    *(const int *) ml_query_batch_get (batch, is_poster_q) : 0;
+  items = (vector) ml_query_batch_get (batch, items_q);
 
   /* Display them. */
-  io_fprintf (io, "<table><tr><td><table>");
+  ml_output_puts_static (io, "<table><tr><td><table>");
 
   n = w->first_item + 1;
 
-  while (st_fetch (sth))
+  for (i = 0; i < vector_size (items); ++i)
     {
-      io_fprintf (io, "<tr><td>");
+      vector_get (items, i, row);
 
-      show_item (io, n, item, item_type, username, posted_date, timediff,
-		 link, link_text);
+      ml_output_puts_static (io, "<tr><td>");
 
-      io_fprintf (io, "</td></tr>");
+      show_item (io, n, row.item, row.item_type, row.username,
+		 row.posted_date, row.timediff, row.link, row.link_text);
+
+      ml_output_puts_static (io, "</td></tr>");
 
       n++;
     }
 
   /* Finish off the page with the buttons at the bottom. */
-  io_fprintf (io, "</table></td></tr><tr><td align=\"right\">");
+  ml_output_puts_static (io, "</table></td></tr><tr><td align=\"right\">");
   if (is_poster)
     ml_widget_repaint (w->post, session, windowid, io);
   ml_widget_repaint (w->home, session, windowid, io);
   ml_widget_repaint (w->prev, session, windowid, io);
   ml_widget_repaint (w->next, session, windowid, io);
-  io_fprintf (io, "</td></tr></table>");
-
-  /* Be polite: give back the database handle. */
-  ml_put_dbh (session, dbh);
+  ml_output_puts_static (io, "</td></tr></table>");
 }
 
 static int
-can_post (db_handle dbh, int sectionid, int userid)
+can_post (ml_bulletins w, db_handle dbh, int userid)
 {
   st_handle sth;
 
   if (userid)
     {
-      sth = st_prepare_cached
-	(dbh,
-	 "select 1 from ml_bulletins_posters "
-	 "where sectionid = ? and userid = ?", DBI_INT, DBI_INT);
-      st_execute (sth, sectionid, userid);
+      sth = ml_prepare (dbh, w->check_poster);
+      st_execute (sth, w->sectionid, userid);
 
       return st_fetch (sth);
     }
@@ -42,6 +42,7 @@
 #include <pthr_cgi.h>
 
 #include "monolith.h"
+#include "ml_query_cache.h"
 #include "ml_widget.h"
 #include "ml_flow_layout.h"
 #include "ml_table_layout.h"
@@ -52,9 +53,10 @@
 #include "ml_form_text.h"
 #include "ml_form_submit.h"
 #include "ml_dialog.h"
+#include "ml_random.h"
 #include "ml_login_nopw.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations login_nopw_ops =
   {
@@ -67,6 +69,7 @@ struct ml_login_nopw
   pool pool;			/* Pool for allocations. */
   ml_session session;		/* Current session. */
   ml_dbh_factory dbf;		/* Database factory. */
+  ml_statement get_userid, update_user, insert_user, get_email;
 
   /* The following is displayed when no user is logged in: */
   ml_button out;
@@ -110,6 +113,28 @@ new_ml_login_nopw (pool pool, ml_session session, ml_dbh_factory dbf)
   w->email = 0;
   w->secret = 0;
 
+  /* Register the statements with the factory. */
+  w->get_userid =
+    ml_register_statement
+    (dbf,
+     "select userid from ml_users where email = ?", DBI_STRING);
+  w->update_user =
+    ml_register_statement
+    (dbf,
+     "update ml_users set lastlogin_date = current_date, "
+     "nr_logins = nr_logins + 1 where userid = ?", DBI_INT);
+  w->insert_user =
+    ml_register_statement
+    (dbf,
+     "insert into ml_users (email, username, lastlogin_date, nr_logins) "
+     "values (?, ?, current_date, 1)",
+     DBI_STRING, DBI_STRING);
+  w->get_email =
+    ml_register_statement
+    (dbf,
+     "select email from ml_users where userid = ?",
+     DBI_INT);
+
   /* Generate the widget which is displayed when no user is logged in: */
   w->out = new_ml_button (pool, "Login ...");
   ml_button_set_callback (w->out, login_button, session, w);
@@ -134,6 +159,7 @@ static void
 login_button (ml_session session, void *vw)
 {
   ml_login_nopw w = (ml_login_nopw) vw;
+  pool pool;
   ml_window win;
   ml_form form;
   ml_table_layout tbl;
@@ -141,15 +167,16 @@ login_button (ml_session session, void *vw)
   ml_form_submit submit;
 
   /* Create the login window. */
-  win = new_ml_window (session, w->pool);
-  form = new_ml_form (w->pool);
-  tbl = new_ml_table_layout (w->pool, 2, 2);
+  win = new_ml_transient_window (session, w->pool);
+  pool = ml_window_pool (win);
+  form = new_ml_form (pool);
+  tbl = new_ml_table_layout (pool, 2, 2);
 
   ml_form_set_callback (form, login_send_email, session, w);
   ml_widget_set_property (form, "method", "GET");
 
   text = new_ml_text_label
-    (w->pool,
+    (pool,
      "To log in to this site, or to create a user account, please type "
      "your email address in the box below.\n\n"
      "You will be sent a single confirmation email which contains a "
@@ -161,34 +188,16 @@ login_button (ml_session session, void *vw)
   ml_table_layout_pack (tbl, text, 0, 0);
   ml_table_layout_set_colspan (tbl, 0, 0, 2);
 
-  w->email_input = new_ml_form_text (w->pool, form);
+  w->email_input = new_ml_form_text (pool, form);
   ml_table_layout_pack (tbl, w->email_input, 1, 0);
 
-  submit = new_ml_form_submit (w->pool, form, "Submit");
+  submit = new_ml_form_submit (pool, form, "Submit");
   ml_table_layout_pack (tbl, submit, 1, 1);
 
   ml_form_pack (form, tbl);
   ml_window_pack (win, form);
 }
 
-static inline const char *
-generate_secret (pool pool)
-{
-  int fd, i;
-  unsigned char buffer[16];
-  char *secret = pmalloc (pool, 33 * sizeof (char));
-
-  fd = open ("/dev/urandom", O_RDONLY);
-  if (fd == -1) abort ();
-  if (read (fd, buffer, 16) != 16) abort ();
-  close (fd);
-
-  for (i = 0; i < 16; ++i)
-    sprintf (secret + i*2, "%02x", buffer[i]);
-
-  return secret;
-}
-
 static const char *clean_up_string (pool pool, const char *text);
 
 static void
@@ -229,7 +238,7 @@ login_send_email (ml_session session, void *vw)
    * was passed back to us, proving that the user really received
    * the email.
    */
-  w->secret = generate_secret (w->pool);
+  w->secret = ml_random_token (w->pool);
 
   /* Unregister old actionid, if there was one. For security reasons, since
    * otherwise a user would be able to register as anyone in the following
@@ -333,8 +342,8 @@ login (ml_session session, void *vw)
     {
       /* Failed. */
       /* XXX Eventually ml_dialog will have a close window button. */
-      win = new_ml_window (session, w->pool);
-      dlg = new_ml_dialog (w->pool);
+      win = new_ml_transient_window (session, w->pool);
+      dlg = new_ml_dialog (ml_window_pool (win));
       ml_dialog_set_text
 	(dlg,
 	 "Email validation failed.\n\n"
@@ -348,19 +357,14 @@ login (ml_session session, void *vw)
   /* Secret is OK. Email address is valid. Log in or create a user account. */
   dbh = ml_get_dbh (session, w->dbf);
 
-  sth = st_prepare_cached
-    (dbh,
-     "select userid from ml_users where email = ?", DBI_STRING);
+  sth = ml_prepare (dbh, w->get_userid);
   st_execute (sth, w->email);
 
   st_bind (sth, 0, userid, DBI_INT);
 
   if (st_fetch (sth))		/* Existing account. */
     {
-      sth = st_prepare_cached
-	(dbh,
-	 "update ml_users set lastlogin_date = current_date, "
-	 "nr_logins = nr_logins + 1 where userid = ?", DBI_INT);
+      sth = ml_prepare (dbh, w->update_user);
       st_execute (sth, userid);
     }
   else				/* New account. */
@@ -375,11 +379,7 @@ login (ml_session session, void *vw)
       if (!(t = strchr (username, '@'))) abort ();
       *t = '\0';
 
-      sth = st_prepare_cached
-	(dbh,
-	 "insert into ml_users (email, username, lastlogin_date, nr_logins) "
-	 "values (?, ?, current_date, 1)",
-	 DBI_STRING, DBI_STRING);
+      sth = ml_prepare (dbh, w->insert_user);
       st_execute (sth, w->email, username);
 
       /* Get the userid. */
@@ -388,13 +388,14 @@ login (ml_session session, void *vw)
 
   /* Commit changes to the database. */
   db_commit (dbh);
+  ml_query_cache_invalidate ("ml_users");
 
   ml_session_login (session, userid, "/", "+1y");
 
   /* Success. */
   /* XXX Eventually ml_dialog will have a close window button. */
-  win = new_ml_window (session, w->pool);
-  dlg = new_ml_dialog (w->pool);
+  win = new_ml_transient_window (session, w->pool);
+  dlg = new_ml_dialog (ml_window_pool (win));
   ml_dialog_set_text
     (dlg,
      "You are now logged into this site.");
@@ -409,10 +410,35 @@ logout_button (ml_session session, void *vw)
   ml_session_logout (session, "/");
 }
 
+struct fetch_email_args
+{
+  ml_login_nopw w;
+  int userid;
+};
+
+/* Fetch a user's email address into the query cache. */
+static void *
+fetch_email (pool pool, db_handle dbh, void *vargs)
+{
+  struct fetch_email_args *args = (struct fetch_email_args *) vargs;
+  st_handle sth;
+  const char *email = 0;
+
+  sth = ml_prepare (dbh, args->w->get_email);
+  st_execute (sth, args->userid);
+
+  st_bind (sth, 0, email, DBI_STRING);
+
+  st_fetch (sth);		/* XXX or die ... */
+
+  return email ? pstrdup (pool, email) : 0;
+}
+
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_login_nopw w = (ml_login_nopw) vw;
+  struct fetch_email_args args;
   int userid;
 
   /* Depending on whether a user is currently logged in or not, we display
@@ -428,22 +454,14 @@ repaint (void *vw, ml_session session, const char *windowid, io_handle io)
     }
   else				/* Logged in. */
     {
-      db_handle dbh;
-      st_handle sth;
-      const char *email = 0;
+      const char *email;
 
       /* Update the current user information string. */
-      dbh = ml_get_dbh (session, w->dbf);
-
-      sth = st_prepare_cached
-	(dbh,
-	 "select email from ml_users where userid = ?",
-	 DBI_INT);
-      st_execute (sth, userid);
-
-      st_bind (sth, 0, email, DBI_STRING);
-
-      st_fetch (sth);		/* XXX or die ... */
+      args.w = w;
+      args.userid = userid;
+      email = ml_query_cache_get (session, w->get_email,
+				  ml_scratch_sprintf (session, "%d", userid),
+				  300, "ml_users", fetch_email, &args);
 
       ml_widget_set_property (w->in_name, "text", email);
 
@@ -55,7 +55,7 @@
 #include "ml_label.h"
 #include "ml_msp.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations msp_ops =
   {
@@ -544,7 +544,7 @@ verify_filename (const char *s)
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_msp w = (ml_msp) vw;
 
@@ -33,6 +33,7 @@
 #include <pthr_iolib.h>
 
 #include "monolith.h"
+#include "ml_query_cache.h"
 #include "ml_widget.h"
 #include "ml_button.h"
 #include "ml_window.h"
@@ -42,7 +43,7 @@
 #include "ml_table_layout.h"
 #include "ml_user_directory.h"
 
-static void repaint (void *, ml_session, const char *, io_handle);
+static void repaint (void *, ml_session, const char *, ml_output);
 
 struct ml_widget_operations user_directory_ops =
   {
@@ -105,51 +106,83 @@ new_ml_user_directory (pool pool, ml_session session, ml_dbh_factory dbf,
   return w;
 }
 
+struct user
+{
+  int userid;
+  const char *name;		/* Name and email address. */
+};
+
+/* Fetch the list of users into the query cache. Returns a vector of
+ * struct user.
+ */
+static void *
+fetch_users (pool pool, db_handle dbh, void *vstmt)
+{
+  ml_statement stmt = (ml_statement) vstmt;
+  st_handle sth;
+  vector v = new_vector (pool, struct user);
+  struct user user;
+  int userid;
+  const char *email, *given_name, *family_name;
+
+  sth = ml_prepare (dbh, stmt);
+  st_execute (sth);
+
+  st_bind (sth, 0, userid, DBI_INT);
+  st_bind (sth, 1, email, DBI_STRING);
+  st_bind (sth, 2, given_name, DBI_STRING);
+  st_bind (sth, 3, family_name, DBI_STRING);
+
+  while (st_fetch (sth))
+    {
+      user.userid = userid;
+      user.name = psprintf (pool, "%s %s <%s>",
+			    given_name, family_name, email);
+      vector_push_back (v, user);
+    }
+
+  return v;
+}
+
 static void
 make_select (pool pool, ml_session session, ml_dbh_factory dbf,
 	     ml_form form, int selected_userid,
 	     ml_form_select *select, vector *users)
 {
-  db_handle dbh;
-  st_handle sth;
-  int userid;
-  const char *email, *given_name, *family_name;
+  ml_statement stmt;
+  vector v;
+  struct user user;
+  int i;
 
   *select = new_ml_form_select (pool, form);
   *users = new_vector (pool, int);
 
-  dbh = ml_get_dbh (session, dbf);
-
-  /* Pull out the list of users, and details. */
-  sth = st_prepare_cached
-    (dbh,
+  stmt = ml_register_statement
+    (dbf,
      "select p.userid, u.email, u.given_name, u.family_name "
      "from ml_userdir_prefs p, ml_users u "
      "order by u.given_name, u.family_name, u.email");
-  st_execute (sth);
 
-  st_bind (sth, 0, userid, DBI_INT);
-  st_bind (sth, 1, email, DBI_STRING);
-  st_bind (sth, 2, given_name, DBI_STRING);
-  st_bind (sth, 3, family_name, DBI_STRING);
+  /* Pull out the list of users, and details. */
+  v = (vector) ml_query_cache_get (session, stmt, 0,
+				   300, "ml_userdir_prefs ml_users",
+				   fetch_users, stmt);
 
-  while (st_fetch (sth))
+  for (i = 0; i < vector_size (v); ++i)
     {
-      vector_push_back (*users, userid);
-      ml_form_select_push_back
-	(*select,
-	 psprintf (pool, "%s %s <%s>", given_name, family_name, email));
+      vector_get (v, i, user);
 
-      if (userid == selected_userid)
+      vector_push_back (*users, user.userid);
+      ml_form_select_push_back (*select, pstrdup (pool, user.name));
+
+      if (user.userid == selected_userid)
 	ml_form_select_set_selection (*select,
 				      ml_form_select_size (*select) - 1);
     }
-
-  ml_put_dbh (session, dbh);
 }
 
 static void
-repaint (void *vw, ml_session session, const char *windowid, io_handle io)
+repaint (void *vw, ml_session session, const char *windowid, ml_output io)
 {
   ml_user_directory w = (ml_user_directory) vw;
 